@@ -10,7 +10,8 @@ using namespace Eigen;
 
 VM_BEGIN_NAMESPACE
 
-#define AUX_DATA_SIZE 2*sizeof(void*) /*support at least two pointer size*/
+/*support at least two pointer size and four ints. with 4 byte pointers two pointers are only two ints*/
+#define AUX_DATA_SIZE (2*sizeof(void*) > 4*sizeof(int) ? 2*sizeof(void*) : 4*sizeof(int))
 
 struct BMVert;
 struct BMEdge;
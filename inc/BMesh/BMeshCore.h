@@ -9,6 +9,8 @@
 #include "BMCustomData.h"
 #include <Eigen/Dense>
 #include "tbb/scalable_allocator.h"
+#include "tbb/enumerable_thread_specific.h"
+#include "tbb/spin_mutex.h"
 using namespace  Eigen;
 
 VM_BEGIN_NAMESPACE
@@ -69,6 +71,26 @@ public:
 		_total--;
 	}
 
+	/*move all elements of other to the end of this list*/
+	void splice(ElementList &other)
+	{
+		if (other._head == nullptr)
+			return;
+
+		if (_tail){
+			_tail->next_elm = other._head;
+			other._head->prev_elm = _tail;
+		}
+		else{
+			_head = other._head;
+		}
+		_tail = other._tail;
+		_total += other._total;
+
+		other._head = other._tail = nullptr;
+		other._total = 0;
+	}
+
 	T* head(){ return _head; }
 
 	T* tail(){ return _tail; }
@@ -78,6 +100,33 @@ private:
 	size_t	_total;
 };
 
+/*element storage of one thread between BM_mesh_local_begin and BM_mesh_local_end*/
+struct BMLocalData
+{
+	BMLocalData() : tot_vert(0), tot_edge(0), tot_loop(0), tot_face(0){}
+
+	/*created elements*/
+	ElementList<BMVert> vert_list;
+	ElementList<BMEdge> edge_list;
+	ElementList<BMLoop> loop_list;
+	ElementList<BMFace> face_list;
+
+	/*killed elements, unlinked and freed at the sync point. logged ones have BM_ELEM_REMOVED set*/
+	std::vector<BMVert*> vert_kill;
+	std::vector<BMEdge*> edge_kill;
+	std::vector<BMLoop*> loop_kill;
+	std::vector<BMFace*> face_kill;
+
+	/*elements and custom data blocks taken from the mesh pools a block at a time*/
+	std::vector<BMVert*> vert_reserve;
+	std::vector<BMEdge*> edge_reserve;
+	std::vector<BMLoop*> loop_reserve;
+	std::vector<BMFace*> face_reserve;
+	std::vector<void*>	 vdata_reserve, edata_reserve, ldata_reserve, fdata_reserve;
+
+	ptrdiff_t tot_vert, tot_edge, tot_loop, tot_face;
+};
+
 class BMesh
 {
 public:
@@ -171,6 +220,11 @@ public:
 	bool	BM_edge_splice(BMEdge *e_dst, BMEdge *e_src);
 	bool    BM_vert_splice(BMVert *v_dst, BMVert *v_src);
 
+	/*between begin and end, threads may create and kill elements of disjoint regions concurrently.
+	elements only go to per-thread lists, which are merged into the mesh at end*/
+	void	BM_mesh_local_begin();
+	void	BM_mesh_local_end();
+
 private:
 	/* helper function for 'BM_mesh_copy' */
 	BMLoop *bm_loop_create(BMVert *v, BMEdge *e, BMFace *f, const BMLoop *l_example, const eBMCreateFlag create_flag);
@@ -184,6 +238,11 @@ private:
 	void    bm_kill_only_face(BMFace *f, bool log);
 	void    bm_kill_only_loop(BMLoop *l);
 
+	template<typename T, typename Pool>
+	T*		bm_local_elem_alloc(Pool &pool, std::vector<T*> &reserve);
+	void*	bm_local_data_alloc(CustomData &data, std::vector<void*> &reserve);
+	void	bm_local_merge(BMLocalData &local);
+
 	BMVert *bmesh_semv(BMVert *tv, BMEdge *e, BMEdge **r_e);
 	BMFace *bmesh_sfme(BMFace *f, BMLoop *l_v1, BMLoop *l_v2, BMLoop **r_l, BMEdge *e_example, const bool no_double);
 	BMVert *bmesh_jvke(BMEdge *e_kill, BMVert *v_kill, const bool do_del, const bool check_edge_double, const bool kill_degenerate_faces);
@@ -257,6 +316,10 @@ private:
 	ElementList<BMVert> _removed_vert_list;
 	ElementList<BMFace> _removed_face_list;
 
+	bool _local_enabled;
+	tbb::enumerable_thread_specific<BMLocalData> _local;
+	tbb::spin_mutex _local_mutex; /*guards the pools while local reserves are refilled*/
+
 	std::vector<BMVert*> vtable;
 	std::vector<BMEdge*> etable;
 	std::vector<BMFace*> ftable;
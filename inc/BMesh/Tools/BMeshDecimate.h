@@ -3,40 +3,28 @@
 
 #include "BMesh/BMesh.h"
 #include "BaseLib/VQuadric.h"
-#include <boost/heap/heap_concepts.hpp>
-#include <boost/heap/fibonacci_heap.hpp>
-using namespace  boost::heap;
+#include "BaseLib/VDaryHeap.h"
 VM_BEGIN_NAMESPACE
 
 #define BOUNDARY_PRESERVE_WEIGHT 100.0f
 #define OPTIMIZE_EPS 0.01f  /* FLT_EPSILON is too small, see [#33106] */
 #define COST_INVALID FLT_MAX
 
+struct EdgeQueueStream;
+
 
 class BMeshDecimate
 {
 private:
-	struct EHeapNode
-	{
-
-		EHeapNode(BMEdge *e_, float cost_): e(e_), cost(cost_){};
-
-		bool operator<(EHeapNode const & rhs) const
-		{
-			return cost > rhs.cost;
-		}
-		BMEdge* e;
-		float cost;
-	};
-
-private:
-	typedef boost::heap::fibonacci_heap<EHeapNode> EHeap;
-	typedef boost::heap::fibonacci_heap<EHeapNode>::handle_type EHeapHanle;
+	/*edges are keyed by their index in the edge table*/
+	typedef VIndexedHeap<4> EHeap;
 public:
-	BMeshDecimate(BMesh *bm, float ratio = 0.5f): _bm(bm), _ratio(ratio){};
+	BMeshDecimate(BMesh *bm, float ratio = 0.5f): _bm(bm), _ratio(ratio), _stream(nullptr){};
 	~BMeshDecimate(){};
 	void run();
 	void setRatio(float rat);
+	/*record edge queue operations for BMeshEdgeQueueBench*/
+	void setRecorder(EdgeQueueStream *stream){ _stream = stream; }
 private:
 
 
@@ -53,8 +41,9 @@ private:
 	BMesh *_bm;
 	EHeap _eheap;
 	float _ratio;
-	std::vector<EHeapHanle>		_eheaphandles;
+	std::vector<BMEdge*>		_edges;
 	std::vector<Qdr::Quadric>	_vquadrics;
+	EdgeQueueStream				*_stream;
 };
 
 VM_END_NAMESPACE
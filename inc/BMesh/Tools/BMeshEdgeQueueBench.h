@@ -0,0 +1,73 @@
+#ifndef BMESH_EDGE_QUEUE_BENCH_H
+#define BMESH_EDGE_QUEUE_BENCH_H
+
+#include "BMesh/BMesh.h"
+#include <vector>
+#include <cstdio>
+
+VM_BEGIN_NAMESPACE
+
+/*edge queue operations captured from a real run. ids are edge indices*/
+struct EdgeQueueStream
+{
+	enum OpType
+	{
+		OP_PUSH,
+		OP_UPDATE,
+		OP_ERASE,
+		OP_POP
+	};
+
+	struct Op
+	{
+		int	  type;
+		int	  id;
+		float cost;
+	};
+
+	EdgeQueueStream() : totid(0){}
+
+	void record(int type, int id, float cost)
+	{
+		Op op = { type, id, cost };
+		ops.push_back(op);
+	}
+
+	size_t			totid;
+	std::vector<Op>	ops;
+};
+
+/*micro-benchmark of edge priority queues.
+the stream of a real decimation is replayed against the boost fibonacci heap and the flat d-ary heaps,
+both with decrease-key (indexed) and with lazy stale-entry skipping as dynamic topology does*/
+class BMeshEdgeQueueBench
+{
+public:
+	struct Result
+	{
+		size_t totop;
+		double fibonacci;		/*seconds, fibonacci heap with handles*/
+		double indexed;			/*VIndexedHeap*/
+		double lazy_fibonacci;	/*fibonacci heap, updates pushed again*/
+		double lazy_dary;		/*VDaryHeap, updates pushed again*/
+	};
+
+public:
+	/*decimate a copy of bm and record its queue operations*/
+	static void stream_record_decimate(BMesh *bm, float ratio, EdgeQueueStream &stream);
+	/*best of repeat runs for each queue*/
+	static Result run(const EdgeQueueStream &stream, int repeat = 5);
+	static void report(const Result &result, FILE *file = stderr);
+	/*replay the stream against the fibonacci heap with the handle semantics BMeshDecimate had before VIndexedHeap,
+	except that a changed cost goes through update: the old code called increase when the cost grew, which breaks the heap order.
+	true if every pop returns the edge and cost the recorded run popped, so both queues collapse the same edges*/
+	static bool replay_matches(const EdgeQueueStream &stream);
+private:
+	static double run_fibonacci(const EdgeQueueStream &stream);
+	static double run_indexed(const EdgeQueueStream &stream);
+	template<class LazyHeap>
+	static double run_lazy(const EdgeQueueStream &stream);
+};
+
+VM_END_NAMESPACE
+#endif
@@ -0,0 +1,213 @@
+#ifndef BASELIB_VDARY_HEAP_H
+#define BASELIB_VDARY_HEAP_H
+#include <vector>
+#include <cstddef>
+#include <cassert>
+
+/*flat d-ary priority queues. elements are stored in one contiguous array,
+a push does not allocate once the array has grown, and sift loops touch D adjacent children.
+D = 4 keeps the children of a node in one cache line for small elements*/
+
+/*drop-in for boost::heap priority queues without handles.
+same ordering convention: top() is the largest element according to operator<.
+stale elements are expected to be skipped by the caller when popped*/
+template<class T, size_t D = 4>
+class VDaryHeap
+{
+public:
+	typedef typename std::vector<T>::const_iterator const_iterator;
+
+public:
+	bool		empty()	const { return _elems.empty(); }
+	size_t		size()	const { return _elems.size(); }
+	void		clear()		  { _elems.clear(); }
+	void		reserve(size_t n) { _elems.reserve(n); }
+	const T&	top()	const { return _elems.front(); }
+
+	/*unordered*/
+	const_iterator begin() const { return _elems.begin(); }
+	const_iterator end()   const { return _elems.end(); }
+
+	void push(const T &val)
+	{
+		_elems.push_back(val);
+		sift_up(_elems.size() - 1);
+	}
+
+	void pop()
+	{
+		assert(!_elems.empty());
+		_elems.front() = _elems.back();
+		_elems.pop_back();
+		if (!_elems.empty())
+			sift_down(0);
+	}
+
+private:
+	void sift_up(size_t i)
+	{
+		T val = _elems[i];
+		while (i > 0){
+			size_t parent = (i - 1) / D;
+			if (!(_elems[parent] < val))
+				break;
+			_elems[i] = _elems[parent];
+			i = parent;
+		}
+		_elems[i] = val;
+	}
+
+	void sift_down(size_t i)
+	{
+		const size_t num = _elems.size();
+		T val = _elems[i];
+		for (;;){
+			size_t first = i * D + 1;
+			if (first >= num)
+				break;
+			size_t last = first + D < num ? first + D : num;
+			size_t best = first;
+			for (size_t c = first + 1; c < last; ++c){
+				if (_elems[best] < _elems[c])
+					best = c;
+			}
+			if (!(val < _elems[best]))
+				break;
+			_elems[i] = _elems[best];
+			i = best;
+		}
+		_elems[i] = val;
+	}
+
+private:
+	std::vector<T> _elems;
+};
+
+/*min-heap of float costs keyed by dense integer ids (element indices).
+a back-pointer from id to heap slot gives O(log n) update and erase without per-node handles*/
+template<size_t D = 4>
+class VIndexedHeap
+{
+	struct Entry
+	{
+		float cost;
+		int   id;
+	};
+
+public:
+	/*ids must be in [0, num)*/
+	void reset(size_t num)
+	{
+		_entries.clear();
+		_entries.reserve(num);
+		_slots.assign(num, -1);
+	}
+
+	bool	empty()			const { return _entries.empty(); }
+	size_t	size()			const { return _entries.size(); }
+	bool	contains(int id)const { return _slots[id] >= 0; }
+	int		top_id()		const { return _entries.front().id; }
+	float	top_cost()		const { return _entries.front().cost; }
+	float	cost(int id)	const { return _entries[_slots[id]].cost; }
+
+	void push(int id, float cost)
+	{
+		assert(!contains(id));
+		Entry entry = { cost, id };
+		_entries.push_back(entry);
+		sift_up(_entries.size() - 1);
+	}
+
+	/*insert or change the cost of id*/
+	void update(int id, float cost)
+	{
+		if (!contains(id)){
+			push(id, cost);
+			return;
+		}
+
+		const size_t i = static_cast<size_t>(_slots[id]);
+		const float old = _entries[i].cost;
+		_entries[i].cost = cost;
+		if (cost < old)
+			sift_up(i);
+		else
+			sift_down(i);
+	}
+
+	void pop()
+	{
+		assert(!_entries.empty());
+		remove_at(0);
+	}
+
+	void erase(int id)
+	{
+		if (contains(id))
+			remove_at(static_cast<size_t>(_slots[id]));
+	}
+
+private:
+	void remove_at(size_t i)
+	{
+		_slots[_entries[i].id] = -1;
+		const Entry last = _entries.back();
+		_entries.pop_back();
+		if (i == _entries.size())
+			return;
+
+		_entries[i] = last;
+		_slots[last.id] = static_cast<int>(i);
+		if (i > 0 && last.cost < _entries[(i - 1) / D].cost)
+			sift_up(i);
+		else
+			sift_down(i);
+	}
+
+	void place(size_t i, const Entry &entry)
+	{
+		_entries[i] = entry;
+		_slots[entry.id] = static_cast<int>(i);
+	}
+
+	void sift_up(size_t i)
+	{
+		const Entry entry = _entries[i];
+		while (i > 0){
+			size_t parent = (i - 1) / D;
+			if (!(entry.cost < _entries[parent].cost))
+				break;
+			place(i, _entries[parent]);
+			i = parent;
+		}
+		place(i, entry);
+	}
+
+	void sift_down(size_t i)
+	{
+		const size_t num = _entries.size();
+		const Entry entry = _entries[i];
+		for (;;){
+			size_t first = i * D + 1;
+			if (first >= num)
+				break;
+			size_t last = first + D < num ? first + D : num;
+			size_t best = first;
+			for (size_t c = first + 1; c < last; ++c){
+				if (_entries[c].cost < _entries[best].cost)
+					best = c;
+			}
+			if (!(_entries[best].cost < entry.cost))
+				break;
+			place(i, _entries[best]);
+			i = best;
+		}
+		place(i, entry);
+	}
+
+private:
+	std::vector<Entry> _entries;
+	std::vector<int>   _slots;	/*heap slot of each id, -1 if not queued*/
+};
+
+#endif
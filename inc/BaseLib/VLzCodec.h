@@ -0,0 +1,45 @@
+#ifndef BASELIB_VLZ_CODEC_H
+#define BASELIB_VLZ_CODEC_H
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+/*byte stream helpers and a small LZ77 compressor for in-memory logs.
+the format is close to LZ4: a token byte holds literal and match lengths,
+matches refer back at most 64KB. speed is favoured over ratio*/
+class VLzCodec
+{
+public:
+	/*dst is replaced by the compressed bytes*/
+	static void compress(const uint8_t *src, size_t size, std::vector<uint8_t> &dst);
+	/*returns false on a corrupted stream*/
+	static bool decompress(const uint8_t *src, size_t size, std::vector<uint8_t> &dst);
+
+	static void varint_put(std::vector<uint8_t> &out, uint64_t val)
+	{
+		while (val >= 0x80){
+			out.push_back(static_cast<uint8_t>(val | 0x80));
+			val >>= 7;
+		}
+		out.push_back(static_cast<uint8_t>(val));
+	}
+
+	static uint64_t varint_get(const uint8_t *&in)
+	{
+		uint64_t val = 0;
+		int shift = 0;
+		uint8_t byte;
+		do{
+			byte = *in++;
+			val |= static_cast<uint64_t>(byte & 0x7f) << shift;
+			shift += 7;
+		} while (byte & 0x80);
+		return val;
+	}
+
+	/*signed values as unsigned, small magnitudes stay small*/
+	static uint64_t zigzag(int64_t val)	 { return (static_cast<uint64_t>(val) << 1) ^ static_cast<uint64_t>(val >> 63); }
+	static int64_t	unzigzag(uint64_t val) { return static_cast<int64_t>(val >> 1) ^ -static_cast<int64_t>(val & 1); }
+};
+
+#endif
@@ -62,7 +62,8 @@ namespace bm_isct
 		bool checkIsct(Eptr e, Tptr t) const;
 		bool checkIsct(Tptr t0, Tptr t1, Tptr t2) const;
 
-		void bvh_edge_tri(std::function<bool(Eptr e, Tptr t)>);
+		/*intersecting edge-triangle pairs, in face order then bvh order. false on a degeneracy*/
+		bool bvh_edge_tri(std::vector<std::pair<Eptr, Tptr>> &hits);
 	private:
 		void resolveAllIntersections();
 		void findIntersections();
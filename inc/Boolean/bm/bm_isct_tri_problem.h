@@ -1,6 +1,7 @@
 #ifndef BM_ISECT_TRI_PROBLEM_H
 #define BM_ISECT_TRI_PROBLEM_H
 #include "bm/bm_isct.h"
+#include <vector>
 
 #define REAL double
 extern "C" {
@@ -30,9 +31,16 @@ namespace bm_isct
 		// run after we've accumulated all the elements
 		void consolidate(IsctProblem *iprob);
 		bool isValid() const;
+		// triangulate the points and edges into tri_verts.
+		// reads and writes only the elements of this problem, so problems can run in parallel
+		void triangulate();
+		// split the edges and create the triangles found by triangulate. allocates from iprob's pools
 		void subdivide(IsctProblem *iprob);
 	private:
-		void subdivideEdge(IsctProblem *iprob, GEptr ge, ShortVec<GEptr, 8> &edges);
+		// replace an edge with split edges through its interior points
+		void subdivideEdge(IsctProblem *iprob, GEptr ge);
+		// end points and sorted interior points of an edge
+		static void edgeChain(GEptr ge, std::vector<GVptr> &chain);
 	private:
 		friend class IsctProblem;
 
@@ -44,6 +52,10 @@ namespace bm_isct
 
 		ShortVec<GTptr, 8>      gtris;
 
+		// triangulation result: points indexed by tri_verts, 3 per triangle
+		ShortVec<GVptr, 7>      points;
+		std::vector<int>        tri_verts;
+
 		Tptr                    the_tri;
 	};
 }
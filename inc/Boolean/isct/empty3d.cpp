@@ -37,9 +37,9 @@
 namespace Empty3d {
 
 // externalized counters...
-int degeneracy_count = 0;
-int exact_count = 0;
-int callcount = 0;
+tbb::atomic<int> degeneracy_count;
+tbb::atomic<int> exact_count;
+tbb::atomic<int> callcount;
 
 using namespace Ext4;
 using namespace AbsExt4;
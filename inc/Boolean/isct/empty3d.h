@@ -26,6 +26,7 @@
 #pragma once
 
 #include "vec.h"
+#include "tbb/atomic.h"
 
 namespace Empty3d {
 
@@ -62,9 +63,10 @@ namespace Empty3d {
 	bool emptyExact(const TriTriTriIn &input);
 	Vec3d coordsExact(const TriTriTriIn &input);
 
-	extern int degeneracy_count; // count degeneracies encountered
-	extern int exact_count; // count of filter calls failed
-	extern int callcount; // total call count
+	// atomic, the predicates are called from concurrent intersection searches
+	extern tbb::atomic<int> degeneracy_count; // count degeneracies encountered
+	extern tbb::atomic<int> exact_count; // count of filter calls failed
+	extern tbb::atomic<int> callcount; // total call count
 
 	/*
 	// exact versions
@@ -654,17 +654,26 @@ struct memorypool {
 
 
 /* Global constants.                                                         */
-
-REAL splitter;       /* Used to split REAL factors for exact multiplication. */
-REAL epsilon;                             /* Floating-point machine epsilon. */
-REAL resulterrbound;
-REAL ccwerrboundA, ccwerrboundB, ccwerrboundC;
-REAL iccerrboundA, iccerrboundB, iccerrboundC;
-REAL o3derrboundA, o3derrboundB, o3derrboundC;
+/*   They are set again by every call to triangulate(), and the seed drives  */
+/*   the vertex sort, so each thread keeps its own copy.  Separate meshes    */
+/*   can then be triangulated concurrently with a repeatable result.         */
+
+#ifdef _MSC_VER
+#define THREADLOCAL __declspec(thread)
+#else /* not _MSC_VER */
+#define THREADLOCAL __thread
+#endif /* not _MSC_VER */
+
+THREADLOCAL REAL splitter;   /* Used to split REAL factors for exact multiplication. */
+THREADLOCAL REAL epsilon;                 /* Floating-point machine epsilon. */
+THREADLOCAL REAL resulterrbound;
+THREADLOCAL REAL ccwerrboundA, ccwerrboundB, ccwerrboundC;
+THREADLOCAL REAL iccerrboundA, iccerrboundB, iccerrboundC;
+THREADLOCAL REAL o3derrboundA, o3derrboundB, o3derrboundC;
 
 /* Random number seed is not constant, but I've made it global anyway.       */
 
-unsigned long randomseed;                     /* Current random number seed. */
+THREADLOCAL unsigned long randomseed;         /* Current random number seed. */
 
 
 /* Mesh data structure.  Triangle operates on only one mesh, but the mesh    */
@@ -3,16 +3,39 @@
 #include <vector>
 #include "tbb/parallel_reduce.h"
 #include "tbb/blocked_range.h"
+#include "sculpt/brush/BrushSelection.h"
 class VAverageBrushDataOp
 {
 public:
 
-	VAverageBrushDataOp(std::vector<BMLeafNode*> &nodes, const Vector3f& center, const float& sqrRad, const Vector3f& viewDir)
+	VAverageBrushDataOp(const std::vector<BMLeafNode*> &nodes, const Vector3f& center, const float& sqrRad, const Vector3f& viewDir)
 		:
 		_nodes(nodes),
 		_sphereCenter(center),
 		_sqrRadius(sqrRad),
-		_viewDir(viewDir)
+		_viewDir(viewDir),
+		_selection(nullptr),
+		_updateNormals(false)
+	{
+		_areaNorm.setZero();
+		_center.setZero();
+		_cnt = 0;
+
+		_areaNormFlip.setZero();
+		_centerFlip.setZero();
+		_cntFlip = 0;
+	}
+
+	/*average over in-sphere vertices of a selection without testing them again.
+	with updateNormals, vertex normals are computed from face normals in the same pass, just before they are read*/
+	VAverageBrushDataOp(const BrushSelection &selection, const Vector3f& viewDir, bool updateNormals = false)
+		:
+		_nodes(selection.nodes()),
+		_sphereCenter(selection.center()),
+		_sqrRadius(selection.radius() * selection.radius()),
+		_viewDir(viewDir),
+		_selection(&selection),
+		_updateNormals(updateNormals)
 	{
 		_areaNorm.setZero();
 		_center.setZero();
@@ -28,7 +51,9 @@ public:
 		_nodes(rhs._nodes),
 		_sphereCenter(rhs._sphereCenter),
 		_sqrRadius(rhs._sqrRadius),
-		_viewDir(rhs._viewDir)
+		_viewDir(rhs._viewDir),
+		_selection(rhs._selection),
+		_updateNormals(rhs._updateNormals)
 	{
 		_areaNorm.setZero();
 		_center.setZero();
@@ -81,6 +106,19 @@ public:
 
 	void operator()(const tbb::blocked_range<size_t>& range)
 	{
+		if (_selection){
+			for (size_t i = range.begin(); i != range.end(); ++i){
+				BMVert* const *verts = _selection->verts(i);
+				const size_t numVerts = _selection->totvert(i);
+				for (size_t v = 0; v < numVerts; ++v){
+					if (_updateNormals){
+						BM_vert_normal_update_face(verts[v]);
+					}
+					vert_add(verts[v]);
+				}
+			}
+			return;
+		}
 
 		for (size_t i = range.begin(); i != range.end(); ++i){
 			BMLeafNode *node = _nodes[i];
@@ -90,19 +128,7 @@ public:
 			{
 				BMVert* vert = verts[i];
 				if ((vert->co - _sphereCenter).squaredNorm() <= _sqrRadius){
-					const Vector3f& norm = vert->no;
-					if (norm.dot(_viewDir) > 0)
-					{
-						_center += vert->co;
-						_areaNorm += norm;
-						_cnt++;
-					}
-					else
-					{
-						_centerFlip += vert->co;
-						_areaNormFlip += norm;
-						_cntFlip++;
-					}
+					vert_add(vert);
 				}
 			}
 		}
@@ -120,10 +146,30 @@ public:
 	}
 
 private:
-	std::vector<BMLeafNode*> &_nodes;
+	void vert_add(BMVert *vert)
+	{
+		const Vector3f& norm = vert->no;
+		if (norm.dot(_viewDir) > 0)
+		{
+			_center += vert->co;
+			_areaNorm += norm;
+			_cnt++;
+		}
+		else
+		{
+			_centerFlip += vert->co;
+			_areaNormFlip += norm;
+			_cntFlip++;
+		}
+	}
+
+private:
+	const std::vector<BMLeafNode*> &_nodes;
 	const Vector3f			 &_sphereCenter;
-	const float			     &_sqrRadius;
+	const float			      _sqrRadius;
 	const Vector3f &_viewDir;
+	const BrushSelection	 *_selection;
+	const bool				  _updateNormals;
 
 	/*calculation data*/
 	size_t   _cnt;
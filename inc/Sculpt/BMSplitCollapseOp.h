@@ -2,11 +2,10 @@
 #define SCULPT_BM_SUBDIVISION_OP_H
 #include "BMesh\BMesh.h"
 #include "sculpt\StrokeData.h"
-#include <boost\heap\priority_queue.hpp>
-#include <boost/heap/heap_concepts.hpp>
-#include <boost/heap/fibonacci_heap.hpp>
 #include <queue>
+#include <vector>
 #include "BaseLib/VQuadric.h"
+#include "BaseLib/VDaryHeap.h"
 using namespace VM;
 
 class BMSplitCollapseOp
@@ -43,9 +42,22 @@ class BMSplitCollapseOp
 	};
 
 private:
-	typedef boost::heap::fibonacci_heap<EdgeNode> EdgeQueue;
-	typedef boost::heap::fibonacci_heap<EdgeNode>::handle_type EdgeHandle;
+	/*stale entries are skipped when popped, no decrease-key needed*/
+	typedef VDaryHeap<EdgeNode> EdgeQueue;
 	typedef boost::container::small_vector<BMFace*, 32>	FaceSmallBuffer;
+
+	/*edge queue of one pass. in parallel mode each leaf node has its own queue,
+	edges with a face in another leaf node are deferred to the serial pass*/
+	struct EdgeQueueContext
+	{
+		EdgeQueueContext() : node(nullptr){}
+
+		EdgeQueue			  queue;
+		BMLeafNode			 *node;		/*null: whole sphere, no restriction*/
+		std::vector<EdgeNode> deferred;
+	};
+
+	typedef void (BMSplitCollapseOp::*FaceQueueAdd)(EdgeQueueContext &eq, BMFace *f);
 public:
 	typedef std::priority_queue<SplitEdge, std::vector<SplitEdge>, edge_compare_long>  LongEdgeQueue;
 public:
@@ -54,16 +66,16 @@ public:
 	void run();
 private:
 	void split_long_edges();
-	void subdivide(EdgeQueue &equeue);
-	void edge_split(EdgeQueue &equeue, BMEdge *e);
-	void long_edge_queue_create(EdgeQueue &equeue);
-	void long_edge_queue_face_add(EdgeQueue &equeue, BMFace *f);
-	void long_edge_queue_edge_add_recur(EdgeQueue &queue, BMLoop *l_edge, BMLoop *l_end, float len_sq, float limit_len);
-	void long_edge_queue_edge_add(EdgeQueue &equeue, BMEdge *e);
+	void subdivide(EdgeQueueContext &eq);
+	void edge_split(EdgeQueueContext &eq, BMEdge *e);
+	void long_edge_queue_create(EdgeQueueContext &eq);
+	void long_edge_queue_face_add(EdgeQueueContext &eq, BMFace *f);
+	void long_edge_queue_edge_add_recur(EdgeQueueContext &eq, BMLoop *l_edge, BMLoop *l_end, float len_sq, float limit_len);
+	void long_edge_queue_edge_add(EdgeQueueContext &eq, BMEdge *e);
 	
 	/*collapse*/
 	void collapse_short_edges();
-	bool collapse_equeue(EdgeQueue &equeue
+	bool collapse_equeue(EdgeQueueContext &eq
 #ifdef OPTIMIZE_COLLAPSE 
 		, std::vector<Qdr::Quadric> &vquadric
 #endif
@@ -74,19 +86,36 @@ private:
 #endif
 
 	void collapse_edge(BMEdge *e, FaceSmallBuffer &deleted_faces, const Vector3f &optimize_co);
-	void short_edge_queue_create(EdgeQueue &equeue);
-	void short_edge_queue_face_add(EdgeQueue &equeue, BMFace *f);
-	void short_edge_queue_edge_add(EdgeQueue &equeue, BMEdge *e);
+	void short_edge_queue_create(EdgeQueueContext &eq);
+	void short_edge_queue_face_add(EdgeQueueContext &eq, BMFace *f);
+	void short_edge_queue_edge_add(EdgeQueueContext &eq, BMEdge *e);
 	void mark_tri_node_in_sphere_begin();
 	void mark_tri_node_in_sphere_end();
 
+	/*parallel mode*/
+	bool parallel_enabled() const;
+	void leaf_queues_create(std::vector<EdgeQueueContext> &eqs, FaceQueueAdd face_add);
+	void leaf_queues_defer_merge(std::vector<EdgeQueueContext> &eqs, EdgeQueueContext &eq);
+	bool edge_in_queue_node(const EdgeQueueContext &eq, BMEdge *e);
+	bool vert_interior(BMVert *v, BMLeafNode *node, bool owned);
+	bool split_interior(const EdgeQueueContext &eq, BMEdge *e);
+	bool collapse_interior(const EdgeQueueContext &eq, BMEdge *e);
+
 	bool tri_in_sphere(BMFace *f);
+
+	/*view detail mode: edge limits from the projected pixel size of the leaf nodes around the edge*/
+	void  leaf_edge_limits_compute();
+	float view_edge_len(const Vector3f &co) const;
+	float edge_max_len(BMEdge *e);
+	float edge_min_len(BMEdge *e){ return _viewDetail ? _minEdgeRatio * edge_max_len(e) : _minEdgeLen; }
 	
 	BMVert* bmesh_vert_create(const Vector3f &co, const Vector3f &no);
 	BMFace* bvh_bmesh_face_create(BMLeafNode *node, BMVert *verts[3], BMEdge *edges[3]);
 	void    bvh_bmesh_face_remove(BMLeafNode *node, BMFace *face);
 	void	bvh_bmesh_vert_remove(BMVert *v);
 	void	bm_edges_from_verts(BMVert *v_tri[3], BMEdge *e_tri[3]);
+	BMEdge* bm_edge_create(BMVert *v1, BMVert *v2);
+	void	bm_edge_kill(BMEdge *e);
 	bool	edge_queue_test(BMEdge *e){ return (BM_elem_flag_test(e, BM_ELEM_TAG) == false); }
 	void	edge_queue_enable(BMEdge *e){BM_elem_flag_enable(e, BM_ELEM_TAG);}
 	void	edge_queue_disable(BMEdge *e){ BM_elem_flag_disable(e, BM_ELEM_TAG); };
@@ -100,5 +129,8 @@ private:
 	float    _radius, _sqrRadius;
 	float    _maxEdgeLen , _sqrMaxEdgeLen;
 	float	 _minEdgeLen , _sqrMinEdgeLen;
+	bool	 _viewDetail;
+	float	 _minEdgeRatio;
+	std::vector<float> _leafMaxEdgeLen; /*indexed by leaf node idx, 0 for leaf nodes outside the selection*/
 };
 #endif
\ No newline at end of file
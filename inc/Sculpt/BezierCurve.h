@@ -2,8 +2,10 @@
 #define SCULPT_BEZIER_CURVE_H
 #include <iostream>
 #include <fstream>
+#include <algorithm>
 #include "BaseLib/Point3Dd.h"
 #include "VbsQt/VbsDef.h"
+#include <Eigen/Dense>
 
 class BezierCurve
 {
@@ -22,9 +24,48 @@ public:
 	void reset(VbsDef::CURVE type);
 	void dumpCurve();
 
+	/*falloff at normalized distance par, read from the baked lookup table*/
+	float falloff(float par) const
+	{
+		par = std::min<float>(std::max<float>(par, 0.0f), 1.0f) * (float)FALLOFF_RESOLUTION;
+		int i = std::min<int>((int)par, FALLOFF_RESOLUTION - 1);
+		float t = par - (float)i;
+		return _falloff[i] + t * (_falloff[i + 1] - _falloff[i]);
+	}
+
+	/*falloff of num normalized distances. 8 distances are interpolated at once*/
+	void falloff(const float *par, float *r, size_t num) const
+	{
+		typedef Eigen::Array<float, 8, 1> Lane8f;
+		typedef Eigen::Array<int, 8, 1> Lane8i;
+
+		size_t n = 0;
+		for (; n + 8 <= num; n += 8){
+			Lane8f f = Eigen::Map<const Lane8f>(par + n).max(0.0f).min(1.0f) * (float)FALLOFF_RESOLUTION;
+			Lane8i i = f.cast<int>().min(FALLOFF_RESOLUTION - 1);
+			Lane8f t = f - i.cast<float>();
+
+			Lane8f y0, y1;
+			for (int k = 0; k < 8; ++k){
+				y0[k] = _falloff[i[k]];
+				y1[k] = _falloff[i[k] + 1];
+			}
+
+			Eigen::Map<Lane8f>(r + n) = y0 + t * (y1 - y0);
+		}
+
+		for (; n < num; ++n){
+			r[n] = falloff(par[n]);
+		}
+	}
+
 private:
 	bool setControlPoints(int type);
 	void makeTable(int resolution);
+	void makeFalloff();
+
+private:
+	enum { FALLOFF_RESOLUTION = 1024 };
 
 private:
 	int _resolution;
@@ -33,5 +74,6 @@ private:
 	VbsDef::CURVE  _type;
 	CurvePoint		*_cpoints;
 	CurvePoint		*_table;
+	float			_falloff[FALLOFF_RESOLUTION + 1];
 };
 #endif
\ No newline at end of file
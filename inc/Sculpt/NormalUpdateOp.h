@@ -2,6 +2,7 @@
 #define NORMAL_UPDATE_OP_H
 #include <vector>
 #include "tbb/parallel_for.h"
+#include "sculpt/brush/BrushSelection.h"
 
 class VNormalVertexUpdateOp
 {
@@ -10,7 +11,18 @@ public:
 		:
 		_nodes(nodes),
 		_center(center),
-		_sqrRadius(sqrRadius)
+		_sqrRadius(sqrRadius),
+		_selection(nullptr)
+	{
+	}
+
+	/*update in-sphere vertices of a selection without testing them again*/
+	VNormalVertexUpdateOp(const BrushSelection &selection)
+		:
+		_nodes(selection.nodes()),
+		_center(selection.center()),
+		_sqrRadius(selection.radius() * selection.radius()),
+		_selection(&selection)
 	{
 	}
 	~VNormalVertexUpdateOp(){}
@@ -27,6 +39,17 @@ public:
 
 	void operator()(const tbb::blocked_range<size_t>& range) const
 	{
+		if (_selection){
+			for (size_t i = range.begin(); i != range.end(); ++i){
+				BMVert* const *verts = _selection->verts(i);
+				const size_t numvert = _selection->totvert(i);
+				for (size_t v = 0; v < numvert; ++v){
+					BM_vert_normal_update_face(verts[v]);
+				}
+			}
+			return;
+		}
+
 		for (size_t i = range.begin(); i != range.end(); ++i){
 			const BMVertVector &verts = _nodes[i]->verts();
 			const size_t numvert = verts.size();
@@ -41,6 +64,7 @@ private:
 	const std::vector<BMLeafNode*> &_nodes;
 	const Vector3f _center;
 	const float    _sqrRadius;
+	const BrushSelection *_selection;
 };
 
 class VNormalFaceVertexUpdateOp
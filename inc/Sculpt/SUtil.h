@@ -4,9 +4,13 @@
 #include "VBvh/common/simd/simd.h"
 #include "sculpt/commonDefine.h"
 #include "sculpt/StrokeData.h"
+#include "tbb/mutex.h"
 
 using namespace VBvh;
 
+/*held while a sculpt stroke modifies a mesh, defined in SUtil.cpp*/
+extern tbb::mutex g_sculpt_mutex;
+
 class SUtil
 {
 public:
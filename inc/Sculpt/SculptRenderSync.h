@@ -0,0 +1,26 @@
+#ifndef SCULPT_RENDER_SYNC_H
+#define SCULPT_RENDER_SYNC_H
+#include <mutex>
+#include <condition_variable>
+
+/*the renderer syncs between the dabs of a stroke without waiting for g_sculpt_mutex under its gui lock.
+it only tries the mutex. when it misses, the sculpt worker waits for its next sync before it locks the mutex again*/
+class SculptRenderSync
+{
+public:
+	static SculptRenderSync* instance();
+
+	void	missed();	/*renderer. g_sculpt_mutex was held by the worker*/
+	void	synced();	/*renderer. synced under g_sculpt_mutex*/
+	void	wait();		/*worker. before it locks g_sculpt_mutex*/
+	/*while the gui thread waits for the worker, the worker must not wait for the renderer, which waits for the gui thread*/
+	void	bypass(bool on);
+private:
+	SculptRenderSync();
+private:
+	std::mutex				_mutex;
+	std::condition_variable	_cond;
+	bool					_missed;
+	bool					_bypass;
+};
+#endif
@@ -1,5 +1,6 @@
 #ifndef SCULPT_STROKE_DATA_H
 #define SCULPT_STROKE_DATA_H
+#include <algorithm>
 #include <Eigen/Dense>
 #include "BezierCurve.h"
 #include "VKernel/VMeshObject.h"
@@ -22,8 +23,38 @@ struct SymmetricData
 	Vector3f grab_delta;
 };
 
+/*per-dab part of StrokeData. a run of dabs is applied in one pass by SculptStroke::add_steps*/
+struct StrokeDab
+{
+	Vector3f cur_pos;
+	Vector3f last_pos;
+	Vector3f grab_delta;
+	Vector3f view_dir;
+	float	 world_radius;
+	float	 max_edge_len;
+	float	 min_edge_len;
+};
+
+/*screen-space detail. the model length of a pixel grows linearly with the clip w of a position,
+so the target edge length of a leaf node follows from its center*/
+struct ViewDetail
+{
+	bool	 enabled;
+	float	 pixels_per_edge;
+	Vector4f depth_row;		/*last row of projection * modelview*/
+	float	 pixel_scale;	/*model length of a pixel at clip w 1*/
+
+	float world_per_pixel(const Vector3f &co) const
+	{
+		const float w = depth_row.head<3>().dot(co) + depth_row[3];
+		return pixel_scale * std::max<float>(w, 1.0e-6f);
+	}
+};
+
 class BVHRenderer;
+class BrushSelection;
 class VSculptCommand;
+class StrokeProfile;
 
 struct StrokeData
 {
@@ -49,13 +80,17 @@ struct StrokeData
 	float max_edge_len;
 	float min_edge_len;
 	float edge_len_unit_threshold;
+	ViewDetail view_detail; /*edge limits per leaf node instead of max_edge_len/min_edge_len when enabled*/
 
 	float scale;
 	float pinch_factor;
 	float brush_strength;
+	int	  smooth_iterations; /*smooth passes per dab*/
 
     bool ensure_min_edge_len;
 
 	BezierCurve *deform_curve;
+	BrushSelection *selection; /*leaf nodes and vertices of the current dab*/
+	StrokeProfile  *profile; /*phase timings, null outside of the benchmark*/
 };
 #endif
\ No newline at end of file
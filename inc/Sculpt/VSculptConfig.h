@@ -13,6 +13,9 @@ class VSculptConfig
 			spacing(10.0f),
 			pixel_size(50),
 			detail_size(5.0),
+			pixels_per_edge(6.0f),
+			view_detail(false),
+			smooth_iterations(1),
 			dynamic_topo(false),
 			falloff(VbsDef::CURVE_SMOOTH)
 		{}
@@ -21,6 +24,9 @@ class VSculptConfig
 		float spacing;
 		int	  pixel_size;
 		float detail_size;
+		float pixels_per_edge; /*screen size of an edge in view detail mode*/
+		bool  view_detail;
+		int	  smooth_iterations; /*smooth brush passes per dab*/
 		bool  dynamic_topo;
 		VbsDef::CURVE falloff;
 	};
@@ -35,6 +41,9 @@ public:
 	void setBrushDynamicTopology(bool topo);
 	void setFalloffCurve(VbsDef::CURVE type);
 	void setBrushDetailsize(float detail);
+	void setBrushPixelsPerEdge(float pixels);
+	void setBrushViewDetail(bool view);
+	void setBrushSmoothIterations(int iterations);
 	
 	VbsDef::BRUSH  brush();
 	float brushStrength();
@@ -42,6 +51,9 @@ public:
 	float brushPixelSize();
 	float brushDynamicTopology();
 	float brushDetailsize();
+	float brushPixelsPerEdge();
+	bool  brushViewDetail();
+	int   brushSmoothIterations();
 	VbsDef::CURVE brushFalloffCurve();
 
 private:
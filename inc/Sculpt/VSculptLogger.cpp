@@ -8,13 +8,22 @@
 #include "VKernel/VScene.h"
 #include "VKernel/VMeshObject.h"
 #include "BaseLib/MathUtil.h"
+#include "BaseLib/VLzCodec.h"
+#include <cstring>
 
 ////////////////////////////////////////////////////////////////////////////
 VSculptLogger::VSculptLogger(VScene *scene, VMeshObject *obj)
 	:
 	_scene(scene),
-	_obj(obj)
-{}
+	_obj(obj),
+	_is_packed(false),
+	_journal(nullptr),
+	_spilled(false),
+	_undone(false),
+	_released(false)
+{
+	_records[0] = _records[1] = 0;
+}
 
 VSculptLogger::VSculptLogger(VSculptLogger &&other)
 	:
@@ -24,7 +33,14 @@ VSculptLogger::VSculptLogger(VSculptLogger &&other)
 	_created_verts(std::move(other._created_verts)),
 	_created_faces(std::move(other._created_faces)),
 	_deleted_verts(std::move(other._deleted_verts)),
-	_deleted_faces(std::move(other._deleted_faces))
+	_deleted_faces(std::move(other._deleted_faces)),
+	_changed_groups(std::move(other._changed_groups)),
+	_packed(std::move(other._packed)),
+	_is_packed(other._is_packed),
+	_journal(other._journal),
+	_spilled(other._spilled),
+	_undone(other._undone),
+	_released(other._released)
 {
 	other._scene = nullptr;
 	other._obj = nullptr;
@@ -33,16 +49,33 @@ VSculptLogger::VSculptLogger(VSculptLogger &&other)
 	other._created_verts.clear();
 	other._deleted_verts.clear();
 	other._deleted_faces.clear();
+	other._changed_groups.clear();
+	other._packed.clear();
+	other._is_packed = false;
+	other._journal = nullptr;
+	other._spilled = false;
+	_records[0] = other._records[0];
+	_records[1] = other._records[1];
+	other._records[0] = other._records[1] = 0;
 }
 
 VSculptLogger::~VSculptLogger()
-{}
+{
+	records_release();
+}
 
 void VSculptLogger::undo(bool bvh_undo /*= false*/)
 {
+	tbb::mutex::scoped_lock lock(_mutex);
+	if (_released)
+		return;
+	unpack();
+	_undone = true;
+
 	if (_scene->objectExist(_obj)){
 		BMesh *bm = _obj->getBmesh();
 		BMBvh *bvh = _obj->getBmeshBvh();
+		bvh->bvh_optimize_end();
 
 		for (auto it = _deleted_verts.begin(); it != _deleted_verts.end(); ++it){
 			BMVert *v = *it;
@@ -90,15 +123,24 @@ void VSculptLogger::undo(bool bvh_undo /*= false*/)
 			for (auto it = _nodes.begin(); it != _nodes.end(); ++it){
 				bvh->leaf_node_org_data_drop(*it);
 			}
+			/*the mesh is back at its state before the step, which becomes the new origin*/
+			bvh->org_data_reset();
 		}
 	}
 }
 
 void VSculptLogger::redo(bool bvh_undo /*= false*/)
 {
+	tbb::mutex::scoped_lock lock(_mutex);
+	if (_released)
+		return;
+	unpack();
+	_undone = false;
+
 	if (_scene->objectExist(_obj)){
 		BMesh *bm = _obj->getBmesh();
 		BMBvh *bvh = _obj->getBmeshBvh();
+		bvh->bvh_optimize_end();
 
 		for (auto it = _deleted_verts.begin(); it != _deleted_verts.end(); ++it){
 			BMVert *v = *it;
@@ -141,9 +183,15 @@ void VSculptLogger::redo(bool bvh_undo /*= false*/)
 /*NOTE: undo must be called earlier for ensuring consistency property*/
 void VSculptLogger::undo_apply()
 {
+	tbb::mutex::scoped_lock lock(_mutex);
+	if (_released)
+		return;
+	unpack();
+
 	if (_scene->objectExist(_obj)){
 		BMesh *bm = _obj->getBmesh();
 		BMBvh *bvh = _obj->getBmeshBvh();
+		bvh->bvh_optimize_end();
 
 		/*real kill all created faces*/
 		for (auto it = _created_faces.begin(); it != _created_faces.end(); ++it){
@@ -176,11 +224,10 @@ void VSculptLogger::log_faces(const std::vector<BMLeafNode*>& nodes)
 		BMLeafNode *node = *it;
 		OriginLeafNodeData *orgnode = node->originData();
 
-		/*loop over original faces for deleted faces*/
-		BMFaceBackup *orgfaces = orgnode->_faces;
-		const size_t  totorgfaces = orgnode->_totfaces;
-		for (size_t i = 0; i < totorgfaces; ++i){
-			BMFaceBackup &fbackup = orgfaces[i];
+		/*original faces removed from the node. they can be added again by a step undo*/
+		const std::vector<BMFaceBackup> &orgfaces = orgnode->_faces;
+		for (auto fit = orgfaces.begin(); fit != orgfaces.end(); ++fit){
+			const BMFaceBackup &fbackup = *fit;
 			if (BM_elem_flag_test(fbackup.face, BM_ELEM_REMOVED) != 0){
 				_deleted_faces.push_back(BMFaceLog());
 				BMFaceLog &log = _deleted_faces.back();
@@ -209,35 +256,46 @@ void VSculptLogger::log_faces(const std::vector<BMLeafNode*>& nodes)
 
 void VSculptLogger::log_verts(const std::vector<BMLeafNode*>& nodes)
 {
-	size_t totvert = 0;
-	for (auto it = nodes.begin(); it != nodes.end(); ++it){
-		BLI_assert((*it)->originData() != nullptr);
-		totvert += (*it)->originData()->_totverts;
+	/*the bvh logs each vertex once, before its first change in the stroke*/
+	BMBvh *bvh = _obj->getBmeshBvh();
+	const tbb::concurrent_vector<BMVertBackup> &orgverts = bvh->org_verts();
+	_changed_verts.reserve(orgverts.size());
+
+	for (auto it = orgverts.begin(); it != orgverts.end(); ++it){
+		const BMVertBackup &vbackup = *it;
+
+		/*save vertex's original coordinate*/
+		_changed_verts.push_back(BMVLog());
+		BMVLog &vlog = _changed_verts.back();
+		vlog.v = vbackup.v;
+		vlog.co = vbackup.co;
+
+		/*removed verts*/
+		if (BM_elem_flag_test(vlog.v, BM_ELEM_REMOVED) != 0){
+			_deleted_verts.push_back(vlog.v);
+		}
 	}
 
-	_changed_verts.reserve(totvert);
-
-	for (auto it = nodes.begin(); it != nodes.end(); ++it){
-
-		OriginLeafNodeData *orgdata = (*it)->originData();
-		BMVertBackup *orgverts = orgdata->_verts;
-		const size_t totorgverts = orgdata->_totverts;
-
-		for (size_t i = 0; i < totorgverts; ++i){
-			const BMVertBackup &vbackup = orgverts[i];
-
-			/*save vertex's original coordinate*/
-			_changed_verts.push_back(BMVLog());
-			BMVLog &vlog = _changed_verts.back();
-			vlog.v = vbackup.v;
-			vlog.co = vbackup.co;
-
-			/*removed faces*/
-			if (BM_elem_flag_test(vlog.v, BM_ELEM_REMOVED) != 0){
-				_deleted_verts.push_back(vlog.v);
-			}
+	/*group by leaf node: nearby vertices have close pointers and close coordinates, so the pointer deltas
+	and the deltas of the order preserving float bits that pack writes stay small. nothing is quantized*/
+	std::sort(_changed_verts.begin(), _changed_verts.end(), [bvh](const BMVLog &a, const BMVLog &b)
+	{
+		BMLeafNode *na = bvh->elem_leaf_node_get(a.v);
+		BMLeafNode *nb = bvh->elem_leaf_node_get(b.v);
+		return na != nb ? na < nb : a.v < b.v;
+	});
+
+	_changed_groups.clear();
+	BMLeafNode *lastnode = nullptr;
+	for (size_t i = 0; i < _changed_verts.size(); ++i){
+		BMLeafNode *node = bvh->elem_leaf_node_get(_changed_verts[i].v);
+		if (i == 0 || node != lastnode){
+			_changed_groups.push_back(i);
+			lastnode = node;
 		}
+	}
 
+	for (auto it = nodes.begin(); it != nodes.end(); ++it){
 		const BMVertVector &verts = (*it)->verts();
 		for (auto it = verts.begin(); it != verts.end(); ++it){
 			BMVert *v = *it;
@@ -253,3 +311,321 @@ const std::vector<BMLeafNode*>& VSculptLogger::nodes()
 {
 	return _nodes;
 }
+
+namespace
+{
+	template<class T>
+	void vector_free(std::vector<T> &vec)
+	{
+		std::vector<T>().swap(vec);
+	}
+
+	/*float bits mapped to an unsigned integer of the same order, so that close values have a small difference*/
+	uint32_t float_order(float val)
+	{
+		uint32_t bits;
+		memcpy(&bits, &val, sizeof(float));
+		return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+	}
+
+	float float_unorder(uint32_t order)
+	{
+		const uint32_t bits = (order & 0x80000000u) ? (order & 0x7fffffffu) : ~order;
+		float val;
+		memcpy(&val, &bits, sizeof(float));
+		return val;
+	}
+
+	/*pointer as a signed difference to the previous one*/
+	template<class T>
+	void ptr_put(std::vector<uint8_t> &out, T *ptr, uintptr_t &prev)
+	{
+		const uintptr_t cur = reinterpret_cast<uintptr_t>(ptr);
+		VLzCodec::varint_put(out, VLzCodec::zigzag(static_cast<int64_t>(cur - prev)));
+		prev = cur;
+	}
+
+	template<class T>
+	T* ptr_get(const uint8_t *&in, uintptr_t &prev)
+	{
+		prev += static_cast<uintptr_t>(VLzCodec::unzigzag(VLzCodec::varint_get(in)));
+		return reinterpret_cast<T*>(prev);
+	}
+}
+
+void VSculptLogger::pack()
+{
+	tbb::mutex::scoped_lock lock(_mutex);
+	if (_is_packed)
+		return;
+
+	std::vector<uint8_t> stream;
+	stream.reserve(_changed_verts.size() * 8 + (_created_faces.size() + _deleted_faces.size()) * 8);
+
+	/*changed vertices: per leaf node group pointer deltas, then one lane per axis of coordinate deltas.
+	coordinates are restored bit exact, so packing again after an undo/redo does not move them*/
+	VLzCodec::varint_put(stream, _changed_groups.size());
+	uintptr_t prev = 0;
+	for (size_t g = 0; g < _changed_groups.size(); ++g){
+		const size_t first = _changed_groups[g];
+		const size_t last = g + 1 < _changed_groups.size() ? _changed_groups[g + 1] : _changed_verts.size();
+
+		VLzCodec::varint_put(stream, last - first);
+		for (size_t i = first; i < last; ++i){
+			ptr_put(stream, _changed_verts[i].v, prev);
+		}
+
+		for (int a = 0; a < 3; ++a){
+			int64_t lastq = 0;
+			for (size_t i = first; i < last; ++i){
+				const int64_t q = static_cast<int64_t>(float_order(_changed_verts[i].co[a]));
+				VLzCodec::varint_put(stream, VLzCodec::zigzag(q - lastq));
+				lastq = q;
+			}
+		}
+	}
+
+	face_logs_pack(_created_faces, stream);
+	face_logs_pack(_deleted_faces, stream);
+	vert_ptrs_pack(_created_verts, stream);
+	vert_ptrs_pack(_deleted_verts, stream);
+
+	VLzCodec::compress(stream.data(), stream.size(), _packed);
+	_packed.shrink_to_fit();
+	_is_packed = true;
+
+	vector_free(_changed_verts);
+	vector_free(_changed_groups);
+	vector_free(_created_faces);
+	vector_free(_deleted_faces);
+	vector_free(_created_verts);
+	vector_free(_deleted_verts);
+}
+
+/*_mutex must be locked*/
+void VSculptLogger::unpack()
+{
+	if (!_is_packed)
+		return;
+
+	if (_spilled){
+		/*the record is kept, a spill of the same state reuses it*/
+		const bool ok = _journal->read(_records[_undone], _packed);
+		_spilled = false;
+		if (!ok){
+			/*record lost or torn, the step can not be restored*/
+			BLI_assert(false);
+			_journal->release(_records[_undone]);
+			_records[_undone] = 0;
+			_is_packed = false;
+			return;
+		}
+	}
+
+	std::vector<uint8_t> stream;
+	if (!VLzCodec::decompress(_packed.data(), _packed.size(), stream)){
+		BLI_assert(false);
+		return;
+	}
+	const uint8_t *in = stream.data();
+
+	const size_t totgroup = static_cast<size_t>(VLzCodec::varint_get(in));
+	_changed_groups.resize(totgroup);
+	uintptr_t prev = 0;
+	for (size_t g = 0; g < totgroup; ++g){
+		const size_t num = static_cast<size_t>(VLzCodec::varint_get(in));
+		const size_t first = _changed_verts.size();
+		_changed_groups[g] = first;
+		_changed_verts.resize(first + num);
+
+		for (size_t i = first; i < first + num; ++i){
+			_changed_verts[i].v = ptr_get<BMVert>(in, prev);
+		}
+
+		for (int a = 0; a < 3; ++a){
+			int64_t q = 0;
+			for (size_t i = first; i < first + num; ++i){
+				q += VLzCodec::unzigzag(VLzCodec::varint_get(in));
+				_changed_verts[i].co[a] = float_unorder(static_cast<uint32_t>(q));
+			}
+		}
+	}
+
+	face_logs_unpack(in, _created_faces);
+	face_logs_unpack(in, _deleted_faces);
+	vert_ptrs_unpack(in, _created_verts);
+	vert_ptrs_unpack(in, _deleted_verts);
+	BLI_assert(in == stream.data() + stream.size());
+
+	vector_free(_packed);
+	_is_packed = false;
+}
+
+void VSculptLogger::face_logs_pack(const std::vector<BMFaceLog> &logs, std::vector<uint8_t> &out)
+{
+	VLzCodec::varint_put(out, logs.size());
+	uintptr_t prevf = 0, prevv = 0;
+	for (auto it = logs.begin(); it != logs.end(); ++it){
+		ptr_put(out, it->f, prevf);
+		for (int k = 0; k < 3; ++k){
+			ptr_put(out, it->verts[k], prevv);
+		}
+	}
+}
+
+void VSculptLogger::face_logs_unpack(const uint8_t *&in, std::vector<BMFaceLog> &logs)
+{
+	logs.resize(static_cast<size_t>(VLzCodec::varint_get(in)));
+	uintptr_t prevf = 0, prevv = 0;
+	for (auto it = logs.begin(); it != logs.end(); ++it){
+		it->f = ptr_get<BMFace>(in, prevf);
+		for (int k = 0; k < 3; ++k){
+			it->verts[k] = ptr_get<BMVert>(in, prevv);
+		}
+	}
+}
+
+void VSculptLogger::vert_ptrs_pack(const std::vector<BMVert*> &verts, std::vector<uint8_t> &out)
+{
+	VLzCodec::varint_put(out, verts.size());
+	uintptr_t prev = 0;
+	for (auto it = verts.begin(); it != verts.end(); ++it){
+		ptr_put(out, *it, prev);
+	}
+}
+
+void VSculptLogger::vert_ptrs_unpack(const uint8_t *&in, std::vector<BMVert*> &verts)
+{
+	verts.resize(static_cast<size_t>(VLzCodec::varint_get(in)));
+	uintptr_t prev = 0;
+	for (auto it = verts.begin(); it != verts.end(); ++it){
+		*it = ptr_get<BMVert>(in, prev);
+	}
+}
+
+bool VSculptLogger::spill(VSculptUndoJournal *journal)
+{
+	tbb::mutex::scoped_lock lock(_mutex);
+	if (!_is_packed || _spilled)
+		return false;
+
+	if (_journal != journal)
+		records_release();
+
+	VSculptUndoJournal::Record &record = _records[_undone];
+	if (!record || !journal->matches(record, _packed)){
+		if (record)
+			journal->release(record);
+		record = 0;
+		if (!journal->append(_packed, record))
+			return false;
+	}
+
+	_journal = journal;
+	_spilled = true;
+	vector_free(_packed);
+	return true;
+}
+
+/*_mutex must be locked, except in the destructor*/
+void VSculptLogger::records_release()
+{
+	if (_journal){
+		for (int i = 0; i < 2; ++i){
+			if (_records[i])
+				_journal->release(_records[i]);
+			_records[i] = 0;
+		}
+	}
+	_journal = nullptr;
+	_spilled = false;
+}
+
+/*the elements killed by the step stay allocated as long as it can be undone or redone.
+they are kept listed here and freed by release_apply, which must not race the sculpt worker*/
+void VSculptLogger::release()
+{
+	tbb::mutex::scoped_lock lock(_mutex);
+	if (_released)
+		return;
+
+	unpack();
+	_released = true;
+	vector_free(_packed);
+	_is_packed = false;
+	records_release();
+
+	vector_free(_changed_verts);
+	vector_free(_changed_groups);
+	if (_undone){
+		vector_free(_deleted_faces);
+		vector_free(_deleted_verts);
+	}
+	else{
+		vector_free(_created_faces);
+		vector_free(_created_verts);
+	}
+	_nodes.clear();
+}
+
+void VSculptLogger::release_apply()
+{
+	tbb::mutex::scoped_lock lock(_mutex);
+	if (!_released)
+		return;
+
+	if (_scene->objectExist(_obj)){
+		BMesh *bm = _obj->getBmesh();
+		_obj->getBmeshBvh()->bvh_optimize_end();
+		const std::vector<BMFaceLog> &faces = _undone ? _created_faces : _deleted_faces;
+		const std::vector<BMVert*> &verts = _undone ? _created_verts : _deleted_verts;
+
+		for (auto it = faces.begin(); it != faces.end(); ++it){
+			if (BM_elem_flag_test(it->f, BM_ELEM_REMOVED) != 0){
+				bm->BM_face_logged_kill_only(it->f);
+			}
+		}
+
+		for (auto it = verts.begin(); it != verts.end(); ++it){
+			if (BM_elem_flag_test(*it, BM_ELEM_REMOVED) != 0){
+				bm->BM_vert_logged_kill_only(*it);
+			}
+		}
+	}
+
+	vector_free(_created_faces);
+	vector_free(_deleted_faces);
+	vector_free(_created_verts);
+	vector_free(_deleted_verts);
+}
+
+bool VSculptLogger::packed()
+{
+	tbb::mutex::scoped_lock lock(_mutex);
+	return _is_packed;
+}
+
+bool VSculptLogger::spilled()
+{
+	tbb::mutex::scoped_lock lock(_mutex);
+	return _spilled;
+}
+
+bool VSculptLogger::undone()
+{
+	tbb::mutex::scoped_lock lock(_mutex);
+	return _undone;
+}
+
+size_t VSculptLogger::memory_size()
+{
+	tbb::mutex::scoped_lock lock(_mutex);
+	if (_is_packed)
+		return _packed.capacity();
+
+	return
+		_changed_verts.capacity() * sizeof(BMVLog) +
+		_changed_groups.capacity() * sizeof(size_t) +
+		(_created_faces.capacity() + _deleted_faces.capacity()) * sizeof(BMFaceLog) +
+		(_created_verts.capacity() + _deleted_verts.capacity()) * sizeof(BMVert*);
+}
@@ -2,7 +2,10 @@
 #define SCULPT_LOGGER_H
 
 #include <vector>
+#include <cstdint>
 #include "VBvh//BMeshBvh.h"
+#include "tbb/mutex.h"
+#include "VSculptUndoJournal.h"
 #include "VKernel/VScene.h"
 #include "VKernel/VMeshObject.h"
 
@@ -24,6 +27,13 @@ private:
 	};
 
 public:
+	/*undo data of one stroke.
+	it can be packed to a compressed byte stream while it sits in the undo history:
+	vertex coordinates are delta encoded as order preserving float bits inside their leaf node group,
+	which is lossless, pointers are delta encoded, then the stream is LZ compressed.
+	a packed logger can be spilled further to the undo journal on disk. undo swaps the logged and the mesh coordinates,
+	so the packed data alternates between two states: one journal record is kept per state and reused by the next spill.
+	undo, redo and undo_apply unpack it first*/
 	VSculptLogger(VScene *scene, VMeshObject *obj);
 	VSculptLogger(VSculptLogger &&other);
 	~VSculptLogger();
@@ -32,9 +42,25 @@ public:
 	void redo(bool bvh_undo = false);
 	void undo_apply();
 	const std::vector<BMLeafNode*>& nodes();
+
+	/*thread safe against undo/redo*/
+	void   pack();
+	bool   spill(VSculptUndoJournal *journal); /*move packed data to the journal*/
+	void   release();	/*drop all data but the elements killed by the step and its journal records. undo/redo become no-op*/
+	void   release_apply();	/*free the elements killed by a released step. on the thread which modifies the mesh*/
+	bool   packed();
+	bool   spilled();
+	bool   undone();	/*undo was called last*/
+	size_t memory_size(); /*resident bytes*/
 private:
 	void log_faces(const std::vector<BMLeafNode*>& nodes);
 	void log_verts(const std::vector<BMLeafNode*>& nodes);
+	void unpack();
+	void records_release();
+	void face_logs_pack(const std::vector<BMFaceLog> &logs, std::vector<uint8_t> &out);
+	void face_logs_unpack(const uint8_t *&in, std::vector<BMFaceLog> &logs);
+	void vert_ptrs_pack(const std::vector<BMVert*> &verts, std::vector<uint8_t> &out);
+	void vert_ptrs_unpack(const uint8_t *&in, std::vector<BMVert*> &verts);
 private:
 	VScene *_scene;
 	VMeshObject* _obj;
@@ -44,5 +70,15 @@ private:
 	std::vector<BMFaceLog>		_deleted_faces;
 	std::vector<BMVert*>		_created_verts;
 	std::vector<BMVert*>		_deleted_verts;
+	std::vector<size_t>			_changed_groups; /*start of each leaf node group in _changed_verts*/
+
+	std::vector<uint8_t>		_packed;
+	bool						_is_packed;
+	VSculptUndoJournal			*_journal;	/*journal of _records, null if never spilled*/
+	VSculptUndoJournal::Record	_records[2]; /*packed data of the done and of the undone state, indexed by _undone*/
+	bool						_spilled;	/*packed data is only in the journal*/
+	bool						_undone;
+	bool						_released;
+	tbb::mutex					_mutex;
 };
 #endif
\ No newline at end of file
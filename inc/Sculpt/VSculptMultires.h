@@ -0,0 +1,136 @@
+#ifndef SCULPT_MULTIRES_H
+#define SCULPT_MULTIRES_H
+
+#include <vector>
+#include <climits>
+#include <cmath>
+#include <Eigen/Dense>
+#include "BMesh/BMesh.h"
+#include "BezierCurve.h"
+#include "tbb/parallel_for.h"
+#include "tbb/blocked_range.h"
+using namespace VM;
+
+/*multiresolution displacement over the triangles of a base mesh.
+level l splits a base triangle into 4^l triangles on a barycentric grid of (2^l+1)(2^l+2)/2 vertices.
+a vertex is the midpoint interpolation of the coarser level plus its displacement, so an edit of a level
+carries every finer level with it. displacements and cached positions of a level are SoA arrays,
+the grids of the base triangles one after another.
+
+edits mark base triangles. the positions of finer levels are refreshed and the edit is restricted to
+coarser levels on demand, by the caller which reads such a level, in parallel over the marked base triangles.
+neighbouring base triangles duplicate the vertices of their shared edge. edits by position move both copies alike.
+
+this is the standalone level core, driven by SculptBench -multires. brushes, BMBvh, undo and the renderer
+do not use it yet*/
+class VSculptMultires
+{
+public:
+	struct Level
+	{
+		int	res;				/*2^level segments per base edge*/
+		size_t totgridvert;		/*vertices per base triangle*/
+		std::vector<float> dx, dy, dz;	/*displacement from the interpolated coarser level*/
+		std::vector<float> px, py, pz;	/*cached positions*/
+	};
+
+public:
+	VSculptMultires(BMesh *bm, int totlevel);
+	~VSculptMultires();
+
+	/*corners of the base triangles are read again, displacements are kept*/
+	void		base_update();
+
+	int			totlevel() const { return static_cast<int>(_levels.size()); }
+	size_t		totbase() const { return _base.size() / 3; }
+	int			active_level() const { return _active; }
+	void		set_active_level(int level);
+
+	/*refreshes the level if edits are pending*/
+	const Level& level(int l);
+
+	/*grid index of barycentric vertex (i, j), i + j <= res*/
+	static size_t grid_index(int res, int i, int j) { return static_cast<size_t>(i * (res + 1) - i * (i - 1) / 2 + j); }
+
+	/*bounds of base triangle f at the active level*/
+	const Eigen::AlignedBox3f& base_bounds(size_t f) const { return _bounds[f]; }
+
+	/*base triangles of the active level touching the sphere*/
+	size_t		base_select(const Vector3f &center, float radius, std::vector<size_t> &faces);
+
+	/*moves the active level vertices inside the sphere by kernel(co, normalized distance, falloff)*/
+	template<class Kernel>
+	void		deform(const Vector3f &center, float radius, const BezierCurve *curve, const Kernel &kernel);
+
+	size_t		memory_size() const;
+private:
+	void		level_alloc(int l);
+	void		positions_refresh(size_t f, int from, int to);
+	void		restrict_up(size_t f, int from);
+	void		bounds_refresh(size_t f);
+	Vector3f	interp(int l, size_t f, int i, int j) const;
+	void		propagate(int l);
+
+	static const int CLEAN = INT_MAX;
+private:
+	BMesh					*_bm;
+	std::vector<Vector3f>	 _base;		/*3 corners per base triangle*/
+	std::vector<Level>		 _levels;
+	std::vector<Eigen::AlignedBox3f> _bounds;
+	int						 _active;
+
+	/*per base triangle: lowest level with stale positions, highest level with edits not restricted to coarser levels*/
+	std::vector<int>		 _stale;
+	std::vector<int>		 _unrestricted;
+	std::vector<size_t>		 _marked;	/*base triangles with pending work*/
+};
+
+template<class Kernel>
+void VSculptMultires::deform(const Vector3f &center, float radius, const BezierCurve *curve, const Kernel &kernel)
+{
+	std::vector<size_t> faces;
+	if (!base_select(center, radius, faces))
+		return;
+
+	Level &lv = _levels[_active];
+	const int res = lv.res;
+	const float sqrRadius = radius * radius;
+	const float invRadius = 1.0f / radius;
+
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, faces.size()), [&](const tbb::blocked_range<size_t> &range)
+	{
+		for (size_t n = range.begin(); n != range.end(); ++n){
+			const size_t f = faces[n];
+			const size_t off = f * lv.totgridvert;
+			bool moved = false;
+			for (int i = 0; i <= res; ++i){
+				for (int j = 0; j <= res - i; ++j){
+					const size_t k = off + grid_index(res, i, j);
+					const Vector3f co(lv.px[k], lv.py[k], lv.pz[k]);
+					const float sqrdist = (co - center).squaredNorm();
+					if (sqrdist > sqrRadius)
+						continue;
+
+					const float dist = std::sqrt(sqrdist) * invRadius;
+					const Vector3f offset = kernel(co, dist, curve->falloff(dist));
+					lv.dx[k] += offset[0]; lv.dy[k] += offset[1]; lv.dz[k] += offset[2];
+					lv.px[k] += offset[0]; lv.py[k] += offset[1]; lv.pz[k] += offset[2];
+					moved = true;
+				}
+			}
+			if (moved){
+				bounds_refresh(f);
+				if (_active + 1 < totlevel()) _stale[f] = std::min(_stale[f], _active + 1);
+				_unrestricted[f] = std::max(_unrestricted[f], _active);
+			}
+		}
+	});
+
+	for (size_t n = 0; n < faces.size(); ++n){
+		const size_t f = faces[n];
+		if (_stale[f] != CLEAN || _unrestricted[f] > 0)
+			_marked.push_back(f);
+	}
+}
+
+#endif
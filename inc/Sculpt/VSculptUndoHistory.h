@@ -0,0 +1,56 @@
+#ifndef SCULPT_UNDO_HISTORY_H
+#define SCULPT_UNDO_HISTORY_H
+#include <deque>
+#include <memory>
+#include <vector>
+#include "VSculptLogger.h"
+#include "VSculptUndoJournal.h"
+#include "tbb/mutex.h"
+#include "tbb/task_group.h"
+
+/*memory accounting of sculpt undo steps.
+a logger is packed on a background worker as soon as it enters the history, and again after undo/redo unpacked it.
+when the packed steps in memory grow over the resident threshold, the oldest are spilled to the undo journal.
+the journal is trimmed each time the budget is enforced, after dropped and deleted steps released their records.
+when the history still grows over the budget, the data of the oldest steps is dropped:
+they can not be undone anymore, the steps after them are not affected.
+the elements killed by a dropped step are freed later by push or set_memory_budget, which run with the mesh idle*/
+class VSculptUndoHistory
+{
+public:
+	static VSculptUndoHistory* instance();
+public:
+	~VSculptUndoHistory();
+
+	void	push(const std::shared_ptr<VSculptLogger> &logger);
+	void	remove(VSculptLogger *logger);
+	/*pack again after an undo/redo*/
+	void	touch(const std::shared_ptr<VSculptLogger> &logger);
+
+	void	set_memory_budget(size_t bytes);
+	size_t	memory_budget() const { return _budget; }
+	size_t	memory_usage(); /*resident bytes*/
+	void	set_resident_threshold(size_t bytes);
+	size_t	resident_threshold() const { return _resident; }
+	/*empty path disables spilling. the journal is opened at the first spill*/
+	void	set_journal_path(const std::string &path);
+	uint64_t journal_size() const { return _journal.file_size(); }
+	void	wait();
+private:
+	VSculptUndoHistory();
+	void	pack_async(const std::shared_ptr<VSculptLogger> &logger);
+	void	budget_enforce();
+	void	cold_spill(size_t &total);
+	void	released_free();
+private:
+	std::deque<std::shared_ptr<VSculptLogger>> _loggers; /*oldest first*/
+	std::vector<std::shared_ptr<VSculptLogger>> _released; /*dropped, their killed elements not freed yet*/
+	size_t			_budget;
+	size_t			_resident;
+	std::string		_journal_path;
+	bool			_journal_failed;
+	VSculptUndoJournal _journal;
+	tbb::mutex		_mutex;
+	tbb::task_group	_packer;
+};
+#endif
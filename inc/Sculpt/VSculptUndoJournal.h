@@ -0,0 +1,68 @@
+#ifndef SCULPT_UNDO_JOURNAL_H
+#define SCULPT_UNDO_JOURNAL_H
+#include <vector>
+#include <string>
+#include <memory>
+#include <unordered_map>
+#include <cstdio>
+#include <cstdint>
+#include "tbb/mutex.h"
+
+namespace boost { namespace interprocess { class file_mapping; } }
+
+/*append-only file of packed undo steps.
+each record is framed by a header with magic, payload size and crc32, written and flushed before it is indexed,
+so a torn write at a crash is detected instead of replayed. a failed append is rolled back to the last good frame.
+a read maps only the pages of its own frame, so the file can grow past the address space.
+records are referred to by id: released records leave dead bytes, which trim drops by truncating the file
+when nothing is live, or by copying the live frames to a new file when most of it is dead*/
+class VSculptUndoJournal
+{
+public:
+	typedef uint32_t Record; /*0: none*/
+
+public:
+	VSculptUndoJournal();
+	~VSculptUndoJournal();
+
+	bool	open(const std::string &path);
+	void	close();
+	bool	is_open() const { return _file != nullptr; }
+	bool	append(const std::vector<uint8_t> &payload, Record &record);
+	/*false if the record does not pass its frame check*/
+	bool	read(Record record, std::vector<uint8_t> &payload);
+	/*true if the record holds exactly this payload, checked by size and crc*/
+	bool	matches(Record record, const std::vector<uint8_t> &payload);
+	void	release(Record record);
+	void	trim();
+	uint64_t file_size() const { return _size; }
+	uint64_t live_size() const { return _live; }
+	/*for tests: the next append fails after its header is written*/
+	void	append_fail_next() { _fail_next = true; }
+
+	static std::string default_path();
+private:
+	struct Frame
+	{
+		uint64_t offset; /*payload offset in the file*/
+		uint32_t size;
+		uint32_t crc;
+	};
+
+	bool	frame_read(const Frame &frame, std::vector<uint8_t> &payload);
+	bool	compact();
+	void	file_remove();
+private:
+	std::string	 _base_path;
+	std::string	 _path;		/*_base_path, with a generation suffix after compaction*/
+	unsigned	 _generation;
+	FILE		*_file;
+	uint64_t	 _size;		/*end of the last good frame*/
+	uint64_t	 _live;		/*bytes of the frames not released*/
+	bool		 _fail_next;
+	Record		 _next;
+	std::unordered_map<Record, Frame>					_frames;
+	std::unique_ptr<boost::interprocess::file_mapping>	_mapping;
+	tbb::mutex	 _mutex;
+};
+#endif
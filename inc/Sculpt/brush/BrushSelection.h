@@ -0,0 +1,150 @@
+#ifndef SCULPT_BRUSH_SELECTION_H
+#define SCULPT_BRUSH_SELECTION_H
+
+#include <vector>
+#include "sculpt/BezierCurve.h"
+#include "VBvh/BMeshBvh.h"
+#include "VBvh/BMBvhIsect.h"
+#include "tbb/parallel_for.h"
+#include "tbb/blocked_range.h"
+#include <Eigen/Dense>
+
+using namespace VBvh;
+
+/*leaf nodes and in-sphere vertices of one dab, shared by topology update, normal update,
+brush data average and brush kernel so that the sphere is tested once.
+a selection stays valid until the sphere changes, the bvh reports a modification or
+the owner invalidates it after deforming vertices*/
+class BrushSelection
+{
+public:
+	BrushSelection()
+		:
+		_bvh(nullptr),
+		_radius(0.0f),
+		_stamp(0),
+		_curve(nullptr),
+		_valid(false),
+		_verts_valid(false)
+	{}
+
+	/*leaf nodes touching the sphere*/
+	const std::vector<BMLeafNode*>& nodes_select(BMBvh *bvh, const Vector3f &center, const float &radius)
+	{
+		if (!valid(bvh, center, radius)){
+			_bvh = bvh;
+			_center = center;
+			_radius = radius;
+			_stamp = bvh->modify_stamp();
+			_valid = true;
+			_verts_valid = false;
+
+			_nodes.clear();
+			isect_sphere_bm_bvh(bvh, center, radius, _nodes);
+		}
+		return _nodes;
+	}
+
+	/*in-sphere vertices of the selected leaf nodes with normalized distance and falloff*/
+	void verts_select(const BezierCurve *curve)
+	{
+		BLI_assert(_valid && _stamp == _bvh->modify_stamp());
+
+		if (_verts_valid && _curve == curve)
+			return;
+
+		size_t total = 0;
+		_offsets.resize(_nodes.size());
+		_counts.resize(_nodes.size());
+		for (size_t i = 0; i < _nodes.size(); ++i){
+			_offsets[i] = total;
+			total += _nodes[i]->verts().size();
+		}
+		_verts.resize(total);
+		_dist.resize(total);
+		_fade.resize(total);
+
+		tbb::parallel_for(tbb::blocked_range<size_t>(0, _nodes.size()), [&](const tbb::blocked_range<size_t> &range)
+		{
+			const float sqrRadius = _radius * _radius;
+			const float invRadius = 1.0f / _radius;
+
+			for (size_t i = range.begin(); i != range.end(); ++i){
+				const BMVertVector &verts = _nodes[i]->verts();
+				const size_t numvert = verts.size();
+				BMVert **sverts = &_verts[_offsets[i]];
+				float *sdist = &_dist[_offsets[i]];
+
+				size_t cnt = 0;
+				for (size_t v = 0; v < numvert; ++v){
+					const float sqrdist = (verts[v]->co - _center).squaredNorm();
+					if (sqrdist <= sqrRadius){
+						sverts[cnt] = verts[v];
+						sdist[cnt] = sqrdist;
+						cnt++;
+					}
+				}
+
+				Eigen::Map<Eigen::ArrayXf> dist(sdist, cnt);
+				dist = dist.sqrt() * invRadius;
+				curve->falloff(sdist, &_fade[_offsets[i]], cnt);
+				_counts[i] = cnt;
+			}
+		});
+
+		_curve = curve;
+		_verts_valid = true;
+	}
+
+	/*grow the buffers ahead of a selection of totnode leaf nodes with totvert vertices*/
+	void reserve(size_t totnode, size_t totvert)
+	{
+		_nodes.reserve(totnode);
+		_offsets.reserve(totnode);
+		_counts.reserve(totnode);
+		_verts.reserve(totvert);
+		_dist.reserve(totvert);
+		_fade.reserve(totvert);
+	}
+
+	/*vertex coordinates were changed without a bvh modification*/
+	void invalidate()
+	{
+		_valid = false;
+		_verts_valid = false;
+	}
+
+	bool valid(const BMBvh *bvh, const Vector3f &center, const float &radius) const
+	{
+		return _valid && _bvh == bvh && _center == center && _radius == radius && _stamp == bvh->modify_stamp();
+	}
+
+	const Vector3f& center() const { return _center; }
+	const float&	radius() const { return _radius; }
+
+	const std::vector<BMLeafNode*>& nodes() const { return _nodes; }
+	size_t			totvert(size_t i) const { return _counts[i]; }
+	BMVert* const*	verts(size_t i)	const { return &_verts[_offsets[i]]; }
+	const float*	dist(size_t i)	const { return &_dist[_offsets[i]]; }
+	const float*	fade(size_t i)	const { return &_fade[_offsets[i]]; }
+
+private:
+	BMBvh					*_bvh;
+	Vector3f				 _center;
+	float					 _radius;
+	size_t					 _stamp;
+	const BezierCurve		*_curve;
+	bool					 _valid;
+	bool					 _verts_valid;
+
+	std::vector<BMLeafNode*> _nodes;
+
+	/*in-sphere vertices of node i are in [_offsets[i], _offsets[i] + _counts[i])*/
+	std::vector<size_t>		 _offsets;
+	std::vector<size_t>		 _counts;
+	std::vector<BMVert*>	 _verts;
+	std::vector<float>		 _dist;
+	std::vector<float>		 _fade;
+};
+
+#endif
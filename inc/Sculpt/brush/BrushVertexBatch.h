@@ -0,0 +1,245 @@
+#ifndef SCULPT_BRUSH_VERTEX_BATCH_H
+#define SCULPT_BRUSH_VERTEX_BATCH_H
+
+#include "sculpt/commonDefine.h"
+#include "sculpt/StrokeData.h"
+#include "sculpt/BezierCurve.h"
+#include "sculpt/brush/BrushSelection.h"
+#include "VBvh/BMeshBvh.h"
+#include <boost/container/small_vector.hpp>
+#include <Eigen/Dense>
+
+/*gather/compute/scatter helper shared by brush ops.
+vertices of a leaf node inside the brush are gathered into SoA lanes,
+brush math runs on whole lanes as Eigen array expressions (SSE/AVX packets),
+then coordinates are scattered back to the vertices.
+one batch is used per thread, it is reused for every leaf node of a range.
+scatter logs the original coordinate of a vertex before its first write in a stroke*/
+class BrushVertexBatch
+{
+public:
+	typedef Eigen::Map<Eigen::ArrayXf> Lanes;
+
+	enum PlaneSide
+	{
+		PLANE_BOTH,
+		PLANE_BELOW, /*only vertices below the plane move*/
+		PLANE_ABOVE  /*only vertices above the plane move*/
+	};
+
+public:
+	explicit BrushVertexBatch(BMBvh *bvh)
+		: _bvh(bvh), _num(0)
+	{}
+
+	size_t size() const { return _num; }
+
+	/*gather vertices inside the brush sphere. dist is normalized to [0, 1]*/
+	size_t gather(const BMVertVector &verts, const Vector3f &center, const float &radius)
+	{
+		const float sqrRadius = radius * radius;
+		const size_t num = verts.size();
+		reserve(num);
+
+		_num = 0;
+		for (size_t i = 0; i < num; ++i){
+			BMVert *v = verts[i];
+			const float sqrdist = (v->co - center).squaredNorm();
+			if (sqrdist <= sqrRadius){
+				push(v, v->co, sqrdist);
+			}
+		}
+
+		dist() = dist().sqrt() * (1.0f / radius);
+		return _num;
+	}
+
+	/*gather in-sphere vertices of node i of a selection. dist and fade come from the selection*/
+	size_t gather(const BrushSelection &selection, size_t i)
+	{
+		const size_t num = selection.totvert(i);
+		BMVert* const *verts = selection.verts(i);
+		reserve(num);
+
+		_num = 0;
+		for (size_t k = 0; k < num; ++k){
+			push(verts[k], verts[k]->co, 0.0f);
+		}
+
+		dist() = Eigen::Map<const Eigen::ArrayXf>(selection.dist(i), num);
+		fade() = Eigen::Map<const Eigen::ArrayXf>(selection.fade(i), num);
+		return _num;
+	}
+
+	/*gather vertices of a leaf node by their coordinates at stroke start.
+	vertices created during the stroke have no original coordinate and are skipped*/
+	size_t gather_original(BMLeafNode *node, const Vector3f &center, const float &radius)
+	{
+		const BMVertVector &verts = node->verts();
+		const size_t num = verts.size();
+		const float sqrRadius = radius * radius;
+		reserve(num);
+
+		_num = 0;
+		for (size_t i = 0; i < num; ++i){
+			BMVert *v = verts[i];
+			if (!_bvh->vert_org_exists(v))
+				continue;
+
+			const Vector3f &co = _bvh->vert_org_co(v);
+			const float sqrdist = (co - center).squaredNorm();
+			if (sqrdist <= sqrRadius){
+				push(v, co, sqrdist);
+			}
+		}
+
+		dist() = dist().sqrt() * (1.0f / radius);
+		return _num;
+	}
+
+	/*gather vertices with a custom brush volume. inside(co, dist) returns true and normalized distance if co is inside*/
+	template<class Inside>
+	size_t gather_if(const BMVertVector &verts, const Inside &inside)
+	{
+		const size_t num = verts.size();
+		reserve(num);
+
+		_num = 0;
+		float vdist;
+		for (size_t i = 0; i < num; ++i){
+			BMVert *v = verts[i];
+			if (inside(v->co, vdist)){
+				push(v, v->co, vdist);
+			}
+		}
+		return _num;
+	}
+
+	/*vertex normals into attribute lanes*/
+	void gather_normals()
+	{
+		for (size_t i = 0; i < _num; ++i){
+			const Vector3f &no = _verts[i]->no;
+			_ax[i] = no[0]; _ay[i] = no[1]; _az[i] = no[2];
+		}
+	}
+
+	/*mean of neighbour vertices into attribute lanes*/
+	void gather_means()
+	{
+		Vector3f avg;
+		for (size_t i = 0; i < _num; ++i){
+			BM_vert_calc_mean(_verts[i], avg);
+			_ax[i] = avg[0]; _ay[i] = avg[1]; _az[i] = avg[2];
+		}
+	}
+
+	void falloff(const BezierCurve *curve)
+	{
+		curve->falloff(_dist.data(), _fade.data(), _num);
+	}
+
+	void scatter()
+	{
+		for (size_t i = 0; i < _num; ++i){
+			_bvh->vert_org_save(_verts[i]);
+			Vector3f &co = _verts[i]->co;
+			co[0] = _x[i]; co[1] = _y[i]; co[2] = _z[i];
+		}
+	}
+
+	/*write new coordinates to a buffer instead of the vertices*/
+	void scatter(BMVertBackup *out) const
+	{
+		for (size_t i = 0; i < _num; ++i){
+			out[i].v = _verts[i];
+			out[i].co = Vector3f(_x[i], _y[i], _z[i]);
+		}
+	}
+
+	/*co += fade * offset*/
+	void translate(const Vector3f &offset)
+	{
+		x() += offset[0] * fade();
+		y() += offset[1] * fade();
+		z() += offset[2] * fade();
+	}
+
+	/*co += strength * fade * (p - co)*/
+	void pull(const Vector3f &p, const float &strength)
+	{
+		x() += strength * fade() * (p[0] - x());
+		y() += strength * fade() * (p[1] - y());
+		z() += strength * fade() * (p[2] - z());
+	}
+
+	/*co += strength * fade * attribute*/
+	void displace_attribute(const float &strength)
+	{
+		x() += strength * fade() * ax();
+		y() += strength * fade() * ay();
+		z() += strength * fade() * az();
+	}
+
+	/*move vertices toward their projection on plane (p, n)*/
+	void pull_plane(const Vector3f &p, const Vector3f &n, const float &strength, PlaneSide side)
+	{
+		/*signed distance along n from vertex to plane*/
+		t0() = (p[0] - x()) * n[0] + (p[1] - y()) * n[1] + (p[2] - z()) * n[2];
+		if (side == PLANE_BELOW)
+			t0() = t0().max(0.0f);
+		else if (side == PLANE_ABOVE)
+			t0() = t0().min(0.0f);
+
+		t0() *= strength * fade();
+		x() += t0() * n[0];
+		y() += t0() * n[1];
+		z() += t0() * n[2];
+	}
+
+	Lanes x()	 { return Lanes(_x.data(), _num); }
+	Lanes y()	 { return Lanes(_y.data(), _num); }
+	Lanes z()	 { return Lanes(_z.data(), _num); }
+	Lanes ax()	 { return Lanes(_ax.data(), _num); } /*per-vertex vector attribute*/
+	Lanes ay()	 { return Lanes(_ay.data(), _num); }
+	Lanes az()	 { return Lanes(_az.data(), _num); }
+	Lanes dist() { return Lanes(_dist.data(), _num); }
+	Lanes fade() { return Lanes(_fade.data(), _num); }
+	Lanes t0()	 { return Lanes(_t0.data(), _num); } /*scratch*/
+	Lanes t1()	 { return Lanes(_t1.data(), _num); }
+	Lanes t2()	 { return Lanes(_t2.data(), _num); }
+
+private:
+	enum { LANE_INLINE = 256 }; /*lanes of a filled leaf node stay on the stack*/
+	typedef boost::container::small_vector<float, LANE_INLINE> LaneBuffer;
+
+	void reserve(size_t num)
+	{
+		if (_verts.size() < num){
+			_verts.resize(num);
+			_x.resize(num); _y.resize(num); _z.resize(num);
+			_ax.resize(num); _ay.resize(num); _az.resize(num);
+			_dist.resize(num); _fade.resize(num);
+			_t0.resize(num); _t1.resize(num); _t2.resize(num);
+		}
+	}
+
+	BLI_MEMBER_INLINE void push(BMVert *v, const Vector3f &co, const float &vdist)
+	{
+		_verts[_num] = v;
+		_x[_num] = co[0]; _y[_num] = co[1]; _z[_num] = co[2];
+		_dist[_num] = vdist;
+		_num++;
+	}
+
+private:
+	BMBvh		 *_bvh;
+	BMVertVector _verts;
+	LaneBuffer	 _x, _y, _z;
+	LaneBuffer	 _ax, _ay, _az;
+	LaneBuffer	 _dist, _fade;
+	LaneBuffer	 _t0, _t1, _t2;
+	size_t		 _num;
+};
+
+#endif
@@ -3,6 +3,7 @@
 
 #include "sculpt/commonDefine.h"
 #include "sculpt/SUtil.h"
+#include "sculpt/brush/BrushVertexBatch.h"
 #include <Eigen/Dense>
 #include "tbb/parallel_for.h"
 #include "tbb/blocked_range.h"
@@ -35,41 +36,30 @@ public:
 			tbb::parallel_for(tbb::blocked_range<size_t>(0, _nodes.size()), *this);
 		else
 			(*this)(tbb::blocked_range<size_t>(0, _nodes.size()));
+		_sdata->bvh->leaf_node_fused_finish();
 	}
 
 	void operator()(const tbb::blocked_range<size_t>& range) const
 	{
-		float distance, fade;
-		float coo[3];
-		Vector3f proj;
+		const BrushVertexBatch::PlaneSide side = _flip ? BrushVertexBatch::PLANE_ABOVE : BrushVertexBatch::PLANE_BELOW;
+		auto inside = [this](const Vector3f &coord, float &distance)
+		{
+			float coo[3] = { coord(0), coord(1), coord(2) };
+			return insideCube(coo, distance);
+		};
+		BrushVertexBatch batch(_sdata->bvh);
+
 		for (size_t i = range.begin(); i != range.end(); ++i){
 			
 			BMLeafNode *node = _nodes[i];
 			node->setAppFlagBit(LEAF_UPDATE_STEP_BB | LEAF_UPDATE_STEP_DRAW_BUFFER);
 
-			const BMVertVector &verts = node->verts();
-			const size_t num = verts.size();
-
-			for (size_t iv = 0; iv < num; ++iv)
-			{
-				BMVert* vertex = verts[iv];
-				Vector3f& coord = vertex->co;
-
-				coo[0] = coord(0); 
-				coo[1] = coord(1); 
-				coo[2] = coord(2);
-
-				if (insideCube(coo, distance))
-				{
-					if (SUtil::planePointSideFlip(coord, _deformCenter, _normal, _flip))
-					{
-						SUtil::projectPointPlane(_deformCenter, _normal, coord, proj);
-						proj = proj - coord;
-						fade = _sdata->deform_curve->evaluate(distance);
-						coord = coord + _bstrength * fade * proj;
-					}
-				}
+			if (batch.gather_if(node->verts(), inside)){
+				batch.falloff(_sdata->deform_curve);
+				batch.pull_plane(_deformCenter, _normal, (float)_bstrength, side);
+				batch.scatter();
 			}
+			_sdata->bvh->leaf_node_fused_update(node);
 		}
 	}
 
@@ -77,18 +67,16 @@ public:
 	{
 		const Vector3f pos = (_sdata->symn_data.cur_pos);
 		float radius = (float)_sdata->world_radius;
-		const float sqrRadius = radius * radius;
 
-		isect_sphere_bm_bvh(_sdata->bvh, pos, radius, _nodes);
+		_nodes = _sdata->selection->nodes_select(_sdata->bvh, pos, radius);
+		_sdata->selection->verts_select(_sdata->deform_curve);
 
 		/*calculate deform data*/
 		VNormalFaceVertexUpdateOp faceNormalOp(_nodes);
 		faceNormalOp.run();
-		VNormalVertexUpdateOp vertNormOp(_nodes, pos, sqrRadius);
-		vertNormOp.run();
 
 		Vector3f vdir = (_sdata->symn_data.view_dir);
-		VAverageBrushDataOp avgOp(_nodes, pos, sqrRadius, vdir);
+		VAverageBrushDataOp avgOp(*_sdata->selection, vdir, true/*vertex normals*/);
 		avgOp.run();
 		const Vector3f avgCenter = avgOp.avgCenter();
 		const Vector3f norm = avgOp.avgNormal();
@@ -3,6 +3,7 @@
 
 #include "sculpt/commonDefine.h"
 #include "sculpt/SUtil.h"
+#include "sculpt/brush/BrushVertexBatch.h"
 #include "tbb/parallel_for.h"
 #include "tbb/blocked_range.h"
 #include "sculpt/NormalUpdateOp.h"
@@ -29,72 +30,55 @@ public:
 			tbb::parallel_for(tbb::blocked_range<size_t>(0, _nodes.size()), *this);
 		else
 			(*this)(tbb::blocked_range<size_t>(0, _nodes.size()));
+		_sdata->bvh->leaf_node_fused_finish();
 	}
 
 	void operator()(const tbb::blocked_range<size_t>& range) const
 	{
-		double ri, x, fade;
-		Vector3f inter;
-
-		const float sqrRadius = _sdata->world_radius * _sdata->world_radius;
-		const float invRadius = 1.0f / _sdata->world_radius;
-		const float pinchFactor = _sdata->pinch_factor * _sdata->pinch_factor;
-		const Vector3f center = (_sdata->symn_data.cur_pos);
-		const Vector3f offset = -_sdata->brush_strength * _sdata->scale * _sdata->world_radius * (_avgNormal);
-		Vector3f disp, curOff;
+		BrushVertexBatch batch(_sdata->bvh);
 
 		for (size_t i = range.begin(); i != range.end(); ++i){
-	
 			BMLeafNode *node = _nodes[i];
 			node->setAppFlagBit(LEAF_UPDATE_STEP_BB | LEAF_UPDATE_STEP_DRAW_BUFFER);
 
-			const BMVertVector &verts = node->verts();
-			const size_t num = verts.size();
-
-			float creaseCorrection = pinchFactor * pinchFactor;
-			/* we always want crease to pinch or blob to relax even when draw is negative */
-			//creaseCorrection = creaseCorrection * _data->_bstrength;
-
-			for (size_t i = 0; i < num; i++){
-				BMVert* vertex = verts[i];
-				Vector3f& coord = vertex->co;
-
-				if (SUtil::isVertexInsideBrush(center, sqrRadius, coord)){
-					/*toward center direction*/
-					disp = center - coord;
-
-					ri = disp.norm();
-					x = (invRadius * ri);
-					fade = _sdata->deform_curve->evaluate(x);
+			if (batch.gather(*_sdata->selection, i)){
+				deform(batch);
+			}
+			_sdata->bvh->leaf_node_fused_update(node);
+		}
+	}
 
-					//first we pinch
-					disp = creaseCorrection * fade * disp;
+	/*deform gathered vertices*/
+	void deform(BrushVertexBatch &batch) const
+	{
+		const float pinchFactor = _sdata->pinch_factor * _sdata->pinch_factor;
+		const Vector3f center = (_sdata->symn_data.cur_pos);
+		const Vector3f offset = -_sdata->brush_strength * _sdata->scale * _sdata->world_radius * (_avgNormal);
 
-					//then we draw
-					curOff = fade * offset;
+		/* we always want crease to pinch or blob to relax even when draw is negative */
+		const float creaseCorrection = pinchFactor * pinchFactor;
 
-					coord = coord + curOff + disp;
-				}
-			}
-		}
+		//first we pinch
+		batch.pull(center, creaseCorrection);
+		//then we draw
+		batch.translate(offset);
+		batch.scatter();
 	}
 
 	void init()
 	{
 		const float radius = _sdata->world_radius;
-		const float sqrRadius = radius * radius;
 		const Vector3f pos = (_sdata->symn_data.cur_pos);
 
-		isect_sphere_bm_bvh(_sdata->bvh, pos, radius, _nodes);
+		_nodes = _sdata->selection->nodes_select(_sdata->bvh, pos, radius);
+		_sdata->selection->verts_select(_sdata->deform_curve);
 
 		/*calculate deform data*/
 		VNormalFaceVertexUpdateOp faceNormalOp(_nodes);
 		faceNormalOp.run();
-		VNormalVertexUpdateOp vertNormOp(_nodes, pos, sqrRadius);
-		vertNormOp.run();
 
 		Vector3f vdir = (_sdata->symn_data.view_dir);
-		VAverageBrushDataOp avgOp(_nodes, pos, sqrRadius, vdir);
+		VAverageBrushDataOp avgOp(*_sdata->selection, vdir, true/*vertex normals*/);
 		avgOp.run();
 		_avgNormal = avgOp.avgNormal();
 	}
@@ -0,0 +1,66 @@
+#ifndef SCULPT_DAB_SCHEDULER_H
+#define SCULPT_DAB_SCHEDULER_H
+
+#include <vector>
+#include <deque>
+#include "StrokeData.h"
+
+/*paces the dabs of a mouse range so that the range fits a frame time budget.
+the cost of a dab is measured online, with and without dynamic topology.
+over budget the spacing grows up to the brush radius, which merges samples. if that is not enough
+dynamic topology is deferred: the range is brushed without it and its dabs are refined when the input is idle*/
+class DabScheduler
+{
+public:
+	struct Decision
+	{
+		float	length;		/*mouse range in pixels*/
+		float	spacing;	/*pixels between dabs*/
+		size_t	totdab;
+		double	estimate;	/*predicted seconds, 0 before the first measure*/
+		double	seconds;	/*measured seconds*/
+		bool	topology_deferred;
+	};
+
+public:
+	DabScheduler();
+	~DabScheduler();
+
+	void	stroke_begin(float pixel_radius, bool topology);
+
+	/*decide spacing and topology of the next range*/
+	void	plan(float length);
+	float	spacing() const { return _spacing; }
+	bool	topology_deferred() const { return _deferred; }
+
+	/*measured cost of the planned range*/
+	void	range_done(size_t totdab, double seconds);
+
+	/*dabs brushed without dynamic topology, oldest first*/
+	void	refine_add(const std::vector<StrokeDab> &dabs);
+	bool	refine_pop(StrokeDab &dab);
+	void	refine_done(size_t totdab, double seconds);
+	bool	refine_pending() const { return !_refine.empty(); }
+	/*how many deferred dabs fit an idle frame*/
+	size_t	refine_count() const;
+
+	void	set_frame_budget(double seconds) { _budget = seconds; }
+	double	frame_budget() const { return _budget; }
+
+	const std::vector<Decision>& decisions() const { return _decisions; }
+	void	clear();
+private:
+	double	_budget;
+	float	_base_spacing;
+	float	_max_spacing;
+	bool	_topology;
+	double	_topology_cost;	/*seconds per dab with dynamic topology, 0 until measured*/
+	double	_plain_cost;	/*seconds per dab without*/
+
+	float	_spacing;
+	bool	_deferred;
+	std::deque<StrokeDab> _refine;
+	std::vector<Decision> _decisions;
+};
+
+#endif
@@ -3,6 +3,7 @@
 
 #include "sculpt/commonDefine.h"
 #include "sculpt/SUtil.h"
+#include "sculpt/brush/BrushVertexBatch.h"
 #include <Eigen/Dense>
 #include "tbb/parallel_for.h"
 #include "tbb/blocked_range.h"
@@ -28,44 +29,39 @@ public:
 			tbb::parallel_for(tbb::blocked_range<size_t>(0, _nodes.size()), *this);
 		else
 			(*this)(tbb::blocked_range<size_t>(0, _nodes.size()));
+		_sdata->bvh->leaf_node_fused_finish();
 	}
 
 	void operator()(const tbb::blocked_range<size_t>& range) const
 	{
-		const float bstrength = _sdata->brush_strength;
-		const float sqrRadius = _sdata->world_radius * _sdata->world_radius;
-		const float invRadius = 1.0f / _sdata->world_radius;
-		const Vector3f center = (_sdata->symn_data.cur_pos);
-		const Vector3f offset = (_sdata->symn_data.view_dir) * _sdata->scale * _sdata->world_radius;
-		float ri, x, b;
+		BrushVertexBatch batch(_sdata->bvh);
 
 		for (size_t i = range.begin(); i != range.end(); ++i){
 			BMLeafNode *node = _nodes[i];
 			node->setAppFlagBit(LEAF_UPDATE_STEP_BB | LEAF_UPDATE_STEP_DRAW_BUFFER);
 
-			const BMVertVector &verts = node->verts();
-			const size_t num = verts.size();
-			for (size_t iv = 0; iv < num; ++iv)
-			{
-				BMVert* vertex = verts[iv];
-				Vector3f& coord = vertex->co;
-				if (SUtil::isVertexInsideBrush(center, sqrRadius, coord))
-				{
-					
-					ri = (center - coord).norm();
-					x = invRadius * ri;
-					b = _sdata->deform_curve->evaluate(x);
-					coord = coord + bstrength * b * offset;
-				}
+			if (batch.gather(*_sdata->selection, i)){
+				deform(batch);
 			}
+			_sdata->bvh->leaf_node_fused_update(node);
 		}
 	}
 
+	/*deform gathered vertices*/
+	void deform(BrushVertexBatch &batch) const
+	{
+		const Vector3f offset = _sdata->brush_strength * (_sdata->symn_data.view_dir) * _sdata->scale * _sdata->world_radius;
+
+		batch.translate(offset);
+		batch.scatter();
+	}
+
 	void init()
 	{
 		const float radius = _sdata->world_radius;
 		const Vector3f pos = (_sdata->symn_data.cur_pos);
-		isect_sphere_bm_bvh(_sdata->bvh, pos, radius, _nodes);
+		_nodes = _sdata->selection->nodes_select(_sdata->bvh, pos, radius);
+		_sdata->selection->verts_select(_sdata->deform_curve);
 	}
 public:
 	StrokeData *_sdata;
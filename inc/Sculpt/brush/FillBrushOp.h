@@ -3,6 +3,7 @@
 
 #include "sculpt/commonDefine.h"
 #include "sculpt/SUtil.h"
+#include "sculpt/brush/BrushVertexBatch.h"
 #include <Eigen/Dense>
 #include "tbb/parallel_for.h"
 #include "tbb/blocked_range.h"
@@ -29,59 +30,46 @@ public:
 			tbb::parallel_for(tbb::blocked_range<size_t>(0, _nodes.size()), *this);
 		else
 			(*this)(tbb::blocked_range<size_t>(0, _nodes.size()));
+		_sdata->bvh->leaf_node_fused_finish();
 	}
 
 	void operator()(const tbb::blocked_range<size_t>& range) const
 	{
-		const float sqrRadius = _sdata->world_radius * _sdata->world_radius;
-		const float invRadius = 1.0f / _sdata->world_radius;
-		const Vector3f center = (_sdata->symn_data.cur_pos);
-		Vector3f inter;
-		float r, x, fade;
+		BrushVertexBatch batch(_sdata->bvh);
 
 		for (size_t i = range.begin(); i != range.end(); ++i){
 			BMLeafNode *node = _nodes[i];
 			node->setAppFlagBit(LEAF_UPDATE_STEP_DRAW_BUFFER | LEAF_UPDATE_STEP_BB);
 
-			const BMVertVector &verts = node->verts();
-			const size_t num = verts.size();
-			for (size_t iv = 0; iv < num; ++iv)
-			{
-				BMVert* vertex = verts[iv];
-				Vector3f& coord = vertex->co;
-				if (SUtil::isVertexInsideBrush(center, sqrRadius, coord))
-				{
-					if (SUtil::planePointSide(coord, _deformCenter, _normal))
-					{
-						r = (coord - center).norm();
-						x = r * invRadius;
-						fade = _sdata->deform_curve->evaluate(x);
-						SUtil::projectPointPlane(_deformCenter, _normal, coord, inter);
-						inter = inter - coord;
-						coord = coord + fade * inter;
-					}
-				}
+			if (batch.gather(*_sdata->selection, i)){
+				deform(batch);
 			}
+			_sdata->bvh->leaf_node_fused_update(node);
 		}
 	}
 
+	/*deform gathered vertices*/
+	void deform(BrushVertexBatch &batch) const
+	{
+		batch.pull_plane(_deformCenter, _normal, 1.0f, BrushVertexBatch::PLANE_BELOW);
+		batch.scatter();
+	}
+
 	void init()
 	{
 		const float radius = _sdata->world_radius;
-		const float sqrRadius = radius*radius;
 		const Vector3f pos = (_sdata->symn_data.cur_pos);
 
-		isect_sphere_bm_bvh(_sdata->bvh, pos, radius, _nodes);
+		_nodes = _sdata->selection->nodes_select(_sdata->bvh, pos, radius);
+		_sdata->selection->verts_select(_sdata->deform_curve);
 
 		/*calculate deform data*/
 		VNormalFaceVertexUpdateOp faceNormalOp(_nodes);
 		faceNormalOp.run();
-		VNormalVertexUpdateOp vertNormOp(_nodes, pos, sqrRadius);
-		vertNormOp.run();
 
 		/*calculate average center and normal*/
 		Vector3f vdir = (_sdata->symn_data.view_dir);
-		VAverageBrushDataOp avgOp(_nodes, pos, sqrRadius, vdir);
+		VAverageBrushDataOp avgOp(*_sdata->selection, vdir, true/*vertex normals*/);
 		avgOp.run();
 		_deformCenter = avgOp.avgCenter();
 		_normal       = avgOp.avgNormal();
@@ -3,6 +3,7 @@
 
 #include "sculpt/commonDefine.h"
 #include "sculpt/SUtil.h"
+#include "sculpt/brush/BrushVertexBatch.h"
 #include "tbb/parallel_for.h"
 #include "tbb/blocked_range.h"
 #include "sculpt/NormalUpdateOp.h"
@@ -28,59 +29,48 @@ public:
 			tbb::parallel_for(tbb::blocked_range<size_t>(0, _nodes.size()), *this);
 		else
 			(*this)(tbb::blocked_range<size_t>(0, _nodes.size()));
+		_sdata->bvh->leaf_node_fused_finish();
 	}
 
 	void operator()(const tbb::blocked_range<size_t>& range) const
 	{
-		const float sqrRadius = _sdata->world_radius * _sdata->world_radius;
-		const float invRadius = 1.0 / _sdata->world_radius;
-		const Vector3f pos = (_sdata->symn_data.cur_pos);
-		Vector3f proj;
-		const float bstrength = _sdata->brush_strength; 
-		float ri, x, fade;
+		BrushVertexBatch batch(_sdata->bvh);
 
 		for (size_t i = range.begin(); i != range.end(); ++i){
 			BMLeafNode *node = _nodes[i];
 			node->setAppFlagBit(LEAF_UPDATE_STEP_BB | LEAF_UPDATE_STEP_DRAW_BUFFER);
 
-			const BMVertVector &verts = node->verts();
-			const size_t num = verts.size();
-
-			for (size_t i = 0; i < num; i++)
-			{
-				Vector3f& coord = verts[i]->co;
-				if (SUtil::isVertexInsideBrush(pos, sqrRadius, coord))
-				{
-					SUtil::projectPointPlane(_flattenCenter, _normal, coord, proj);
-
-					ri = (pos - coord).norm();
-					x = (invRadius * ri);
-					fade = _sdata->deform_curve->evaluate(x);
-
-					proj = bstrength * fade * (proj - coord);
-					coord = coord + proj;
-				}
+			if (batch.gather(*_sdata->selection, i)){
+				deform(batch);
 			}
+			_sdata->bvh->leaf_node_fused_update(node);
 		}
 	}
 
+	/*deform gathered vertices*/
+	void deform(BrushVertexBatch &batch) const
+	{
+		const float bstrength = _sdata->brush_strength; 
+
+		batch.pull_plane(_flattenCenter, _normal, bstrength, BrushVertexBatch::PLANE_BOTH);
+		batch.scatter();
+	}
+
 	void init()
 	{
-		const float sqrRadius = _sdata->world_radius * _sdata->world_radius;
 		const float radius = _sdata->world_radius;
 		const Vector3f pos = (_sdata->symn_data.cur_pos);
 
-		isect_sphere_bm_bvh(_sdata->bvh, pos, radius, _nodes);
+		_nodes = _sdata->selection->nodes_select(_sdata->bvh, pos, radius);
+		_sdata->selection->verts_select(_sdata->deform_curve);
 
 		/*calculate deform data*/
 		VNormalFaceVertexUpdateOp faceNormalOp(_nodes);
 		faceNormalOp.run();
-		VNormalVertexUpdateOp vertNormOp(_nodes, pos, sqrRadius);
-		vertNormOp.run();
 
 		/*calculate average center and normal*/
 		Vector3f vdir = (_sdata->symn_data.view_dir);
-		VAverageBrushDataOp avgOp(_nodes, pos, sqrRadius, vdir);
+		VAverageBrushDataOp avgOp(*_sdata->selection, vdir, true/*vertex normals*/);
 		avgOp.run();
 		_flattenCenter = avgOp.avgCenter();
 		_normal        = avgOp.avgNormal();
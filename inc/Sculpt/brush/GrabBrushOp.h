@@ -3,6 +3,7 @@
 
 #include "sculpt/commonDefine.h"
 #include "sculpt/SUtil.h"
+#include "sculpt/brush/BrushVertexBatch.h"
 #include "tbb/parallel_for.h"
 #include "tbb/blocked_range.h"
 #include "sculpt/NormalUpdateOp.h"
@@ -27,50 +28,29 @@ public:
 			tbb::parallel_for(tbb::blocked_range<size_t>(0, _nodes.size()), *this);
 		else
 			(*this)(tbb::blocked_range<size_t>(0, _nodes.size()));
+		_sdata->bvh->leaf_node_fused_finish();
 	}
 
 	void operator()(const tbb::blocked_range<size_t>& range) const
 	{
-		const float sqrradius = _sdata->world_radius * _sdata->world_radius;
-		const float invRadius = 1.0f / _sdata->world_radius;
+		const float radius = _sdata->world_radius;
 		const Vector3f center = (_sdata->symn_data.cur_pos);
-		Vector3f acentric_dir;
 		const	Vector3f grabDelta = (_sdata->symn_data.grab_delta);
 		float	bstrength = _sdata->brush_strength;
-		float	ri, x, b;
+		BrushVertexBatch batch(_sdata->bvh);
 
 		for (size_t i = range.begin(); i != range.end(); ++i){
 			BMLeafNode *node = _nodes[i];
 			node->setAppFlagBit(LEAF_UPDATE_STEP_DRAW_BUFFER | LEAF_UPDATE_STEP_BB);
-			BLI_assert(node->originData() != nullptr);
 
-			BMVertBackup *org_verts = node->originData()->_verts;
-			const size_t num = node->originData()->_totverts;
-
-			for (size_t i = 0; i < num; i++){
-
-				BMVert *vert = org_verts[i].v;
-				Vector3f &org_co = org_verts[i].co;
-
-				acentric_dir = org_co - center;
-				float sqrdist = acentric_dir.squaredNorm();
-				
-				if (sqrdist <= sqrradius){
-					ri = std::sqrt(sqrdist);
-					x = ri * invRadius;
-					b = (float)_sdata->deform_curve->evaluate(x);
-
-					//Vector3f tmp = vert->co;
-					vert->co = org_co + bstrength  * b * grabDelta;
-
-					//////this vertex has been deformed before by one of its symmetric brushes
-					//if (vert->getPosition() == _stepID)
-					//{
-					//	Point3Dd org(orgCoord.x(), orgCoord.y(), orgCoord.z());
-					//	vert->_coord = vert->_coord + tmp - org;
-					//}
-				}
+			/*deform from original coordinates. the vertices come from the node's current vertex list,
+			so a vertex moved to another leaf by dynamic topology is written only by that leaf*/
+			if (batch.gather_original(node, center, radius)){
+				batch.falloff(_sdata->deform_curve);
+				batch.translate(bstrength * grabDelta);
+				batch.scatter();
 			}
+			_sdata->bvh->leaf_node_fused_update(node);
 		}
 	}
 
@@ -78,7 +58,7 @@ public:
 	{
 		const Vector3f &pos = (_sdata->symn_data.cur_pos);
 		const float radius = (float)_sdata->world_radius;
-		isect_sphere_bm_bvh(_sdata->bvh, pos, radius, _nodes);
+		_nodes = _sdata->selection->nodes_select(_sdata->bvh, pos, radius);
 	}
 
 public:
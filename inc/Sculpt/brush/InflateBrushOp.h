@@ -3,6 +3,7 @@
 
 #include "sculpt/commonDefine.h"
 #include "sculpt/SUtil.h"
+#include "sculpt/brush/BrushVertexBatch.h"
 #include <Eigen/Dense>
 #include "tbb/parallel_for.h"
 #include "tbb/blocked_range.h"
@@ -29,51 +30,46 @@ public:
 			tbb::parallel_for(tbb::blocked_range<size_t>(0, _nodes.size()), *this);
 		else
 			(*this)(tbb::blocked_range<size_t>(0, _nodes.size()));
+		_sdata->bvh->leaf_node_fused_finish();
 	}
 
 	void operator()(const tbb::blocked_range<size_t>& range) const
 	{
-		float  ri, x, b;
-		Point3Dd inter;
-
-		const float sqrRadius = _sdata->world_radius * _sdata->world_radius;
-		const float invRadius = (float)1.0 / _sdata->world_radius;
-		const Vector3f center = (_sdata->symn_data.cur_pos);
-		const float scaleDownn = 0.15f; /*reduce self intersection*/
-		float maxDisp = (float)(scaleDownn * _sdata->scale * _sdata->brush_strength * _sdata->world_radius);
+		BrushVertexBatch batch(_sdata->bvh);
 
 		for (size_t i = range.begin(); i != range.end(); ++i){
 			BMLeafNode *node = _nodes[i];
 			node->setAppFlagBit(VBvh::LEAF_UPDATE_STEP_BB | VBvh::LEAF_UPDATE_STEP_DRAW_BUFFER);
 
-			const BMVertVector &verts = node->verts();
-			const size_t num = verts.size();
-			for (size_t iv = 0; iv < num; ++iv)
-			{
-				BMVert* vertex = verts[iv];
-				Vector3f& coord = vertex->co;
-				if (SUtil::isVertexInsideBrush(center, sqrRadius, coord))
-				{
-					ri = (coord - center).norm();
-					x = invRadius * ri;
-					b = _sdata->deform_curve->evaluate(x);
-					coord = coord + b * maxDisp *  vertex->no;
-
-				}
+			if (batch.gather(*_sdata->selection, i)){
+				deform(batch);
 			}
+			_sdata->bvh->leaf_node_fused_update(node);
 		}
 	}
 
+	/*deform gathered vertices*/
+	void deform(BrushVertexBatch &batch) const
+	{
+		const float scaleDownn = 0.15f; /*reduce self intersection*/
+		float maxDisp = (float)(scaleDownn * _sdata->scale * _sdata->brush_strength * _sdata->world_radius);
+
+		batch.gather_normals();
+		batch.displace_attribute(maxDisp);
+		batch.scatter();
+	}
+
 	void init()
 	{
 		const float radius = (float)_sdata->world_radius;
 		const Vector3f pos = (_sdata->symn_data.cur_pos);
-		isect_sphere_bm_bvh(_sdata->bvh, pos, radius, _nodes);
+		_nodes = _sdata->selection->nodes_select(_sdata->bvh, pos, radius);
+		_sdata->selection->verts_select(_sdata->deform_curve);
 
 		/*calculate deform data*/
 		VNormalFaceVertexUpdateOp faceNormalOp(_nodes);
 		faceNormalOp.run();
-		VNormalVertexUpdateOp vertNormOp(_nodes, pos, radius * radius);
+		VNormalVertexUpdateOp vertNormOp(*_sdata->selection);
 		vertNormOp.run();
 	}
 
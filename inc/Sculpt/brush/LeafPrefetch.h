@@ -0,0 +1,55 @@
+#ifndef SCULPT_LEAF_PREFETCH_H
+#define SCULPT_LEAF_PREFETCH_H
+
+#include <vector>
+#include <Eigen/Dense>
+#include "VBvh/BMeshBvh.h"
+#include "brush/BrushSelection.h"
+
+/*touches the leaf nodes of the next dabs before they are brushed.
+the next positions are extrapolated from the last dabs of the stroke. while the sculpt worker waits for input,
+leaf nodes around them are collected, their vertices and faces are prefetched into cache
+and the selection buffers are grown to their size, so the next dab starts warm.
+origin data is not touched, it is saved per vertex when the dab writes it*/
+class LeafPrefetch
+{
+	enum
+	{
+		HISTORY = 4	/*dab positions kept for the extrapolation*/
+	};
+
+public:
+	LeafPrefetch();
+	~LeafPrefetch();
+
+	void	dab_add(const Vector3f &pos, float radius);
+
+	/*a dab was added since the last run*/
+	bool	pending() const { return _pending; }
+
+	/*predicted centers of the next dabs, empty while the stroke does not move*/
+	void	predict(std::vector<Vector3f> &centers) const;
+	float	radius() const { return _radius; }
+
+	/*returns the number of leaf nodes prefetched*/
+	size_t	run(BMBvh *bvh, const std::vector<Vector3f> &centers, float radius, BrushSelection &selection);
+
+	/*number of predicted dabs*/
+	void	set_horizon(size_t totdab) { _horizon = totdab; }
+	size_t	horizon() const { return _horizon; }
+
+	/*leaf nodes prefetched during the stroke*/
+	size_t	totprefetch() const { return _totprefetch; }
+private:
+	Vector3f _pos[HISTORY];	/*ring buffer, _totpos dabs so far*/
+	size_t	 _totpos;
+	float	 _radius;
+	bool	 _pending;
+	size_t	 _horizon;
+	size_t	 _totprefetch;
+
+	std::vector<std::vector<BMLeafNode*>> _hits; /*per center*/
+	std::vector<BMLeafNode*> _nodes;
+};
+
+#endif
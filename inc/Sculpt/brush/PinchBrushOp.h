@@ -3,6 +3,7 @@
 
 #include "sculpt/commonDefine.h"
 #include "sculpt/SUtil.h"
+#include "sculpt/brush/BrushVertexBatch.h"
 #include "tbb/parallel_for.h"
 #include "tbb/blocked_range.h"
 #include "sculpt/NormalUpdateOp.h"
@@ -27,50 +28,40 @@ public:
 			tbb::parallel_for(tbb::blocked_range<size_t>(0, _nodes.size()), *this);
 		else
 			(*this)(tbb::blocked_range<size_t>(0, _nodes.size()));
+		_sdata->bvh->leaf_node_fused_finish();
 	}
 
 	void operator()(const tbb::blocked_range<size_t>& range) const
 	{
-		float ri, x, fade;
-		Vector3f inter;
-
-		const float sqrRadius = _sdata->world_radius * _sdata->world_radius;
-		const float invRadius = 1.0 / _sdata->world_radius;
-		const Vector3f pos = (_sdata->symn_data.cur_pos);
-		Vector3f disp;
-
-		float bstrength = 0.5 * std::abs(_sdata->brush_strength); /*too strong, reduce strength a bit*/
+		BrushVertexBatch batch(_sdata->bvh);
 
 		for (size_t i = range.begin(); i != range.end(); ++i){
-			
 			BMLeafNode *node = _nodes[i];
 			node->setAppFlagBit(LEAF_UPDATE_STEP_BB | LEAF_UPDATE_STEP_DRAW_BUFFER);
 
-			const BMVertVector &verts = node->verts();
-			const size_t num = verts.size();
-
-			for (size_t i = 0; i < num; i++){
-				BMVert* vertex = verts[i];
-				Vector3f &coord = vertex->co;
-				if (SUtil::isVertexInsideBrush(pos, sqrRadius, coord))
-				{
-					disp = pos - coord;
-					ri   = disp.norm();
-					x    = (invRadius * ri);
-					fade = _sdata->deform_curve->evaluate(x);
-
-					disp = bstrength * fade * disp;
-					coord = coord + disp;
-				}
+			if (batch.gather(*_sdata->selection, i)){
+				deform(batch);
 			}
+			_sdata->bvh->leaf_node_fused_update(node);
 		}
 	}
 
+	/*deform gathered vertices*/
+	void deform(BrushVertexBatch &batch) const
+	{
+		const Vector3f pos = (_sdata->symn_data.cur_pos);
+		float bstrength = 0.5 * std::abs(_sdata->brush_strength); /*too strong, reduce strength a bit*/
+
+		batch.pull(pos, bstrength);
+		batch.scatter();
+	}
+
 	void init()
 	{
 		const float radius = _sdata->world_radius;
 		const Vector3f pos = (_sdata->symn_data.cur_pos);
-		isect_sphere_bm_bvh(_sdata->bvh, pos, radius, _nodes);
+		_nodes = _sdata->selection->nodes_select(_sdata->bvh, pos, radius);
+		_sdata->selection->verts_select(_sdata->deform_curve);
 	}
 
 public:
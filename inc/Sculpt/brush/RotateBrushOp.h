@@ -4,6 +4,7 @@
 #include <Eigen/Dense>
 #include "sculpt/commonDefine.h"
 #include "sculpt/SUtil.h"
+#include "sculpt/brush/BrushVertexBatch.h"
 #include "tbb/parallel_for.h"
 #include "tbb/blocked_range.h"
 #include "sculpt/NormalUpdateOp.h"
@@ -29,6 +30,7 @@ public:
 				tbb::parallel_for(tbb::blocked_range<size_t>(0, _nodes.size()), *this);
 			else
 				(*this)(tbb::blocked_range<size_t>(0, _nodes.size()));
+			_sdata->bvh->leaf_node_fused_finish();
 		}
 	}
 
@@ -36,66 +38,40 @@ public:
 	{
 		const Vector3f rotationCenter = (_sdata->symn_data.first_hit_pos);
 		const float radius = _sdata->world_radius;
-		const float invRadius = 1.0f / radius;
-		const float sqrWorldRadius	= radius * radius;
-		float rotmatrix[3][3];
-		float centerRotMatrix[3][3];
-		float x, fade, angle;
-		float sculptNorm[3], localCoord[3], rotatedCoord[3];
+		Vector3f n;
 #if 0
-		sculptNorm[0] = static_cast<float>(_sdata->_sym._viewDirection.x);
-		sculptNorm[1] = static_cast<float>(_sdata->_sym._viewDirection.y);
-		sculptNorm[2] = static_cast<float>(_sdata->_sym._viewDirection.z);
+		n = _sdata->_sym._viewDirection;
 #else
-		sculptNorm[0] = (_normal[0]);
-		sculptNorm[1] = (_normal[1]);
-		sculptNorm[2] = (_normal[2]);
+		n = _normal;
 #endif
-
-		const float sqrCenterRadius = (0.3f * radius) * (0.3f * radius);
-		fade = (float)_sdata->deform_curve->evaluate(0.3f);
-		angle = fade * _maxAngle;
-		SUtil::axis_angle_normalized_to_mat3_ex(centerRotMatrix, sculptNorm, std::sinf(angle), std::cosf(angle));
+		BrushVertexBatch batch(_sdata->bvh);
 
 		for (size_t i = range.begin(); i != range.end(); ++i){
 
 			BMLeafNode *node = _nodes[i];
 			node->setAppFlagBit(LEAF_UPDATE_STEP_DRAW_BUFFER | LEAF_UPDATE_STEP_BB);
 
-			const BMVertVector &verts = node->verts();
-			size_t        num = verts.size();
-
-			for (size_t i = 0; i < num; ++i){
-				BMVert* vert = verts[i];
-				Vector3f& coord = vert->co;
+			if (batch.gather(node->verts(), rotationCenter, radius)){
+				/*vertices within 0.3 radius rotate rigidly with the angle at 0.3*/
+				batch.dist() = batch.dist().max(0.3f);
+				batch.falloff(_sdata->deform_curve);
 
 				/*relative coordinate to sphere center*/
-				localCoord[0] = (coord[0] - rotationCenter[0]); 
-				localCoord[1] = (coord[1] - rotationCenter[1]); 
-				localCoord[2] = (coord[2] - rotationCenter[2]);
-
-				if (SUtil::isVertexInsideBrush(rotationCenter, sqrCenterRadius, coord)){
-					SUtil::mul_v3_m3v3(rotatedCoord, centerRotMatrix, localCoord);
-
-					coord[0] = rotatedCoord[0] + rotationCenter[0];
-					coord[1] = rotatedCoord[1] + rotationCenter[1];
-					coord[2] = rotatedCoord[2] + rotationCenter[2];
-				}
-				else if (SUtil::isVertexInsideBrush(rotationCenter, sqrWorldRadius, coord)){
-					x = (rotationCenter - coord).norm();
-					x = x * invRadius;
-					fade = _sdata->deform_curve->evaluate(x);
-					angle = fade * _maxAngle;
-
-					/*rotation matrix*/
-					SUtil::axis_angle_normalized_to_mat3_ex(rotmatrix, sculptNorm, std::sinf(angle), std::cosf(angle));
-					SUtil::mul_v3_m3v3(rotatedCoord, rotmatrix, localCoord);
-
-					coord[0] = rotatedCoord[0] + rotationCenter[0];
-					coord[1] = rotatedCoord[1] + rotationCenter[1];
-					coord[2] = rotatedCoord[2] + rotationCenter[2];
-				}
+				batch.ax() = batch.x() - rotationCenter[0];
+				batch.ay() = batch.y() - rotationCenter[1];
+				batch.az() = batch.z() - rotationCenter[2];
+
+				/*rotate around n (Rodrigues): c*v + s*(n x v) + (1 - c)*(n.v)*n*/
+				batch.t0() = (batch.fade() * _maxAngle).sin();
+				batch.t1() = (batch.fade() * _maxAngle).cos();
+				batch.t2() = (n[0] * batch.ax() + n[1] * batch.ay() + n[2] * batch.az()) * (1.0f - batch.t1());
+
+				batch.x() = rotationCenter[0] + batch.t1() * batch.ax() + batch.t0() * (n[1] * batch.az() - n[2] * batch.ay()) + n[0] * batch.t2();
+				batch.y() = rotationCenter[1] + batch.t1() * batch.ay() + batch.t0() * (n[2] * batch.ax() - n[0] * batch.az()) + n[1] * batch.t2();
+				batch.z() = rotationCenter[2] + batch.t1() * batch.az() + batch.t0() * (n[0] * batch.ay() - n[1] * batch.ax()) + n[2] * batch.t2();
+				batch.scatter();
 			}
+			_sdata->bvh->leaf_node_fused_update(node);
 		}
 	}
 
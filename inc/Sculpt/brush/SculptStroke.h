@@ -5,6 +5,8 @@
 #include "StrokeData.h"
 #include "SculptCommand.h"
 #include "commonDefine.h"
+#include "brush/BrushSelection.h"
+#include "brush/LeafPrefetch.h"
 #include <Eigen/Dense>
 #include <tuple>
 
@@ -24,22 +26,51 @@ class SculptStroke
 		std::vector<VertLog>	 _changed_verts;
 	};
 
+	/*one mirrored pass of a dab*/
+	struct SymmPass
+	{
+		size_t			symm;
+		StrokeData		data;		/*own symmetric data and selection*/
+		Eigen::AlignedBox3f write_bb;	/*leaf nodes the pass deforms*/
+		Eigen::AlignedBox3f reach_bb;	/*leaf nodes overlapping them, read through vertex and face neighbours*/
+	};
+
 public:
 	SculptStroke(StrokeData *sdata);
 	~SculptStroke();
 	void add_step(bool log_step = false);
+	void add_steps(const std::vector<StrokeDab> &dabs);
+	void add_topology_step(const StrokeDab &dab);
 	void finish_stroke();
+
+	/*touch the leaf nodes of the predicted next dabs. called while no dab is pending*/
+	bool prefetch_pending() const { return _prefetch.pending(); }
+	void prefetch();
 	void step_logger_begin();
 	void step_logger_end();
 private:
 	void calc_symm_data(size_t symm);
+	void symm_passes_run();
+	bool symm_pass_select(size_t slot, SymmPass &pass);
+	static bool symm_pass_conflict(const SymmPass &a, const SymmPass &b);
 	bool is_dynamic_topology();
 	void update_topology();
+	void step_update();
 	void push_undo_redo();
 	void save_origin_node_data(const std::vector<BMLeafNode*> &nodes);
-	void do_brush();
+	void do_brush(StrokeData *data);
+	bool is_batch_brush();
+	void dab_load(const StrokeDab &dab);
+	void do_brush_batch(std::vector<StrokeData> &sdatas, const std::vector<BMLeafNode*> &nodes);
+	template<class BrushOp>
+	void brush_batch(std::vector<StrokeData> &sdatas, const std::vector<BMLeafNode*> &nodes);
 private:
 	StrokeData		*_data;
 	VSculptLogger	*_step_logger;
+	BrushSelection	 _selection;
+	BrushSelection	 _symm_selections[8];
+	std::vector<SymmPass> _symm_passes;
+	LeafPrefetch	 _prefetch;
+	std::vector<Vector3f> _prefetch_centers;
 };
 #endif
\ No newline at end of file
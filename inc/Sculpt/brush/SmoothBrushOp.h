@@ -3,13 +3,18 @@
 
 #include "sculpt/commonDefine.h"
 #include "sculpt/SUtil.h"
+#include "sculpt/brush/BrushVertexBatch.h"
 #include "tbb/parallel_for.h"
 #include "tbb/blocked_range.h"
 #include "sculpt/NormalUpdateOp.h"
 #include "sculpt/AverageBrushDataOp.h"
 #include "VBvh/BMBvhIsect.h"
 #include "BaseLib/MathUtil.h"
+#include <algorithm>
 
+/*two-phase smooth. new positions of all vertices inside the brush are computed from a consistent
+snapshot into a scratch buffer, then committed. vertex means read neighbours in other leaf nodes,
+so writing in place would make the result depend on thread scheduling*/
 class SmoothBrushOp
 {
 public:
@@ -24,41 +29,60 @@ public:
 	{
 		init();
 
-		if (threaded)
-			tbb::parallel_for(tbb::blocked_range<size_t>(0, _nodes.size()), *this);
-		else
-			(*this)(tbb::blocked_range<size_t>(0, _nodes.size()));
+		const int iterations = std::max<int>(_sdata->smooth_iterations, 1);
+		const tbb::blocked_range<size_t> range(0, _nodes.size());
+		for (int it = 0; it < iterations; ++it){
+			const bool last = it + 1 == iterations;
+			if (threaded){
+				tbb::parallel_for(range, [this](const tbb::blocked_range<size_t> &r){ compute(r); });
+				tbb::parallel_for(range, [this, last](const tbb::blocked_range<size_t> &r){ commit(r, last); });
+			}
+			else{
+				compute(range);
+				commit(range, last);
+			}
+		}
+		_sdata->bvh->leaf_node_fused_finish();
 	}
 
-	void operator()(const tbb::blocked_range<size_t>& range) const
+	/*phase 1: read only*/
+	void compute(const tbb::blocked_range<size_t>& range)
 	{
-		const float sqrRadius = _sdata->world_radius * _sdata->world_radius;
-		const float invRadius = 1.0 / _sdata->world_radius;
+		const float radius = _sdata->world_radius;
 		const Vector3f center = (_sdata->symn_data.cur_pos);
 		const float bstrength = _sdata->brush_strength;
-		Vector3f avg;
-		float b, x, ri;
+		BrushVertexBatch batch(_sdata->bvh);
 
 		for (size_t i = range.begin(); i != range.end(); ++i){
 			BMLeafNode *node = _nodes[i];
 			node->setAppFlagBit(LEAF_UPDATE_STEP_DRAW_BUFFER | LEAF_UPDATE_STEP_BB);
 
-			const BMVertVector &verts = node->verts();
-			const size_t num = verts.size();
+			_counts[i] = batch.gather(node->verts(), center, radius);
+			if (_counts[i]){
+				batch.falloff(_sdata->deform_curve);
+				batch.gather_means();
+				batch.ax() -= batch.x();
+				batch.ay() -= batch.y();
+				batch.az() -= batch.z();
+				batch.displace_attribute(bstrength);
+				batch.scatter(&_smoothed[_offsets[i]]);
+			}
+		}
+	}
 
-			for (size_t iv = 0; iv < num; ++iv)
-			{
-				BMVert* vertex = verts[iv];
-				Vector3f& coord = vertex->co;
-				if (SUtil::isVertexInsideBrush(center, sqrRadius, coord))
-				{
-					ri = (coord - center).norm();
-					x = invRadius * ri;
-					b = _sdata->deform_curve->evaluate(x);
-					BM_vert_calc_mean(vertex, avg);
-					avg = avg - coord;
-					coord = coord + bstrength * b * avg;
-				}
+	/*phase 2: each vertex belongs to one leaf node, so writes are disjoint.
+	the last iteration updates normals and bounds of the node with its commit*/
+	void commit(const tbb::blocked_range<size_t>& range, bool fused)
+	{
+		BMBvh *bvh = _sdata->bvh;
+		for (size_t i = range.begin(); i != range.end(); ++i){
+			const BMVertBackup *smoothed = &_smoothed[_offsets[i]];
+			for (size_t k = 0; k < _counts[i]; ++k){
+				bvh->vert_org_save(smoothed[k].v);
+				smoothed[k].v->co = smoothed[k].co;
+			}
+			if (fused){
+				bvh->leaf_node_fused_update(_nodes[i]);
 			}
 		}
 	}
@@ -67,11 +91,24 @@ public:
 	{
 		const float radius = _sdata->world_radius;
 		const Vector3f pos = (_sdata->symn_data.cur_pos);
-		isect_sphere_bm_bvh(_sdata->bvh, pos, radius, _nodes);
+		_nodes = _sdata->selection->nodes_select(_sdata->bvh, pos, radius);
+
+		/*scratch slots for every vertex of the nodes*/
+		size_t total = 0;
+		_offsets.resize(_nodes.size());
+		_counts.resize(_nodes.size());
+		for (size_t i = 0; i < _nodes.size(); ++i){
+			_offsets[i] = total;
+			total += _nodes[i]->verts().size();
+		}
+		_smoothed.resize(total);
 	}
 
 public:
 	StrokeData *_sdata;
 	std::vector<BMLeafNode*> _nodes;
+	std::vector<BMVertBackup> _smoothed;
+	std::vector<size_t> _offsets;
+	std::vector<size_t> _counts;
 };
 #endif
\ No newline at end of file
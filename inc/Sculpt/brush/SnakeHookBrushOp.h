@@ -3,6 +3,7 @@
 
 #include "sculpt/commonDefine.h"
 #include "sculpt/SUtil.h"
+#include "sculpt/brush/BrushVertexBatch.h"
 #include "tbb/parallel_for.h"
 #include "tbb/blocked_range.h"
 #include "sculpt/NormalUpdateOp.h"
@@ -26,36 +27,23 @@ public:
 			tbb::parallel_for(tbb::blocked_range<size_t>(0, _nodes.size()), *this);
 		else
 			(*this)(tbb::blocked_range<size_t>(0, _nodes.size()));
+		_sdata->bvh->leaf_node_fused_finish();
 	}
 
 	void operator()(const tbb::blocked_range<size_t>& range) const
 	{
-		float ri, x, b;
-
-		const float sqrRadius = _sdata->world_radius * _sdata->world_radius;
-		const float invRadius = 1.0 / _sdata->world_radius;
-		const Vector3f pos = (_sdata->symn_data.cur_pos);
 		const Vector3f grabDelta = (_sdata->symn_data.grab_delta);
-		BezierCurve *curve = _sdata->deform_curve;
+		BrushVertexBatch batch(_sdata->bvh);
 
 		for (size_t i = range.begin(); i != range.end(); ++i){
 			BMLeafNode *node = _nodes[i];
 			node->setAppFlagBit(VBvh::LEAF_UPDATE_STEP_BB | VBvh::LEAF_UPDATE_STEP_DRAW_BUFFER);
 
-			const BMVertVector &verts = node->verts();
-			const size_t num = verts.size();
-			for (size_t i = 0; i < num; i++)
-			{
-				BMVert* vert = verts[i];
-				Vector3f& coord = vert->co;
-				if (SUtil::isVertexInsideBrush(pos, sqrRadius, coord))
-				{
-					ri = (coord - pos).norm();
-					x = ri * invRadius;
-					b = curve->evaluate((float)x);
-					coord = coord + /*scale **/ b * grabDelta;
-				}
+			if (batch.gather(*_sdata->selection, i)){
+				batch.translate(/*scale **/ grabDelta);
+				batch.scatter();
 			}
+			_sdata->bvh->leaf_node_fused_update(node);
 		}
 
 	}
@@ -64,7 +52,8 @@ public:
 	{
 		const float radius = _sdata->world_radius;
 		const Vector3f pos = (_sdata->symn_data.cur_pos);
-		isect_sphere_bm_bvh(_sdata->bvh, pos, radius, _nodes);
+		_nodes = _sdata->selection->nodes_select(_sdata->bvh, pos, radius);
+		_sdata->selection->verts_select(_sdata->deform_curve);
 	}
 
 public:
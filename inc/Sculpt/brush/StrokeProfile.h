@@ -0,0 +1,95 @@
+#ifndef SCULPT_STROKE_PROFILE_H
+#define SCULPT_STROKE_PROFILE_H
+
+#include <vector>
+#include <cstring>
+#include "tbb/tick_count.h"
+
+/*per-step phase timings of a stroke. the driver opens a step, SculptStroke adds to it.
+without a profile in StrokeData nothing is measured*/
+class StrokeProfile
+{
+public:
+	enum Phase
+	{
+		PHASE_PICK,		/*ray picking of the dab centers*/
+		PHASE_DYNTOPO,	/*edge split/collapse*/
+		PHASE_BRUSH,	/*selection, origin data, deformation, and the fused normals and bounds of brushed leaf nodes*/
+		PHASE_NORMALS,	/*face normals and leaf bounds of leaf nodes still pending, changed by dyntopo*/
+		PHASE_REFIT,	/*bvh refit*/
+		PHASE_BUFFER,	/*draw buffer preparation of changed leaf nodes*/
+		PHASE_TOTAL
+	};
+
+	/*decision of the dab scheduler for the mouse range of a step, taken live in the app*/
+	struct Schedule
+	{
+		bool	scheduled;
+		bool	topology_deferred;
+		float	spacing;	/*pixels between dabs*/
+		double	estimate;	/*predicted seconds*/
+		double	seconds;	/*measured seconds in the app*/
+	};
+
+	struct Step
+	{
+		size_t totdab;
+		size_t totnode;	/*leaf nodes touched*/
+		double seconds[PHASE_TOTAL];
+		Schedule schedule;
+	};
+
+	/*adds the lifetime of the scope to a phase of the current step*/
+	class Scope
+	{
+	public:
+		Scope(StrokeProfile *profile, Phase phase)
+			: _profile(profile), _phase(phase)
+		{
+			if (_profile) _t0 = tbb::tick_count::now();
+		}
+
+		~Scope()
+		{
+			if (_profile && !_profile->_steps.empty()){
+				_profile->_steps.back().seconds[_phase] += (tbb::tick_count::now() - _t0).seconds();
+			}
+		}
+	private:
+		StrokeProfile	*_profile;
+		Phase			_phase;
+		tbb::tick_count	_t0;
+	};
+
+public:
+	void step_begin(size_t totdab)
+	{
+		Step step;
+		memset(&step, 0, sizeof(Step));
+		step.totdab = totdab;
+		_steps.push_back(step);
+	}
+
+	void nodes_add(size_t totnode)
+	{
+		if (!_steps.empty()) _steps.back().totnode += totnode;
+	}
+
+	void schedule_set(const Schedule &schedule)
+	{
+		if (!_steps.empty()) _steps.back().schedule = schedule;
+	}
+
+	const std::vector<Step>& steps() const { return _steps; }
+	void clear() { _steps.clear(); }
+
+	static const char* phase_name(int phase)
+	{
+		static const char *names[PHASE_TOTAL] = { "pick", "dyntopo", "brush", "normals", "refit", "buffer" };
+		return names[phase];
+	}
+private:
+	std::vector<Step> _steps;
+};
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef SCULPT_STROKE_RECORD_H
+#define SCULPT_STROKE_RECORD_H
+
+#include <vector>
+#include <string>
+#include "StrokeData.h"
+#include "StrokeProfile.h"
+
+/*input of sculpt strokes, in the order SculptStroke received it, so that they can be replayed without the viewer.
+a segment is one call of SculptStroke::add_step (single) or SculptStroke::add_steps.
+each sample keeps the dab and the view ray which picked it.
+a segment of sampled mouse range keeps the decision of the dab scheduler, so that the bench reports it next to the replay.
+text file: a header line, then per stroke a "stroke" line, "segment" lines each followed by its "s" lines
+and an optional "schedule" line, and "end"*/
+class StrokeRecord
+{
+public:
+	struct Sample
+	{
+		StrokeDab dab;
+		Vector3f  ray_org;
+		Vector3f  ray_dir;
+		float	  rotate_angle;
+	};
+
+	struct Segment
+	{
+		bool single;
+		std::vector<Sample> samples;
+		StrokeProfile::Schedule schedule;
+	};
+
+	struct Stroke
+	{
+		int		brush_type;
+		int		flag;
+		int		sym_flag;
+		int		falloff;	/*VbsDef::CURVE*/
+		int		smooth_iterations;
+		float	brush_strength;
+		float	pinch_factor;
+		float	scale;
+		float	edge_len_unit_threshold;
+		Vector3f first_hit_pos;
+		std::vector<Segment> segments;
+	};
+
+public:
+	StrokeRecord();
+	~StrokeRecord();
+
+	void stroke_begin(const StrokeData &data, int falloff);
+	void segment_add(bool single, const std::vector<Sample> &samples);
+	/*of the last segment added*/
+	void segment_schedule_set(const StrokeProfile::Schedule &schedule);
+	void stroke_end();
+
+	/*strokes are appended to the file*/
+	bool save(const std::string &path) const;
+	bool load(const std::string &path);
+
+	const std::vector<Stroke>& strokes() const { return _strokes; }
+	void clear() { _strokes.clear(); _open = false; }
+private:
+	std::vector<Stroke> _strokes;
+	bool _open;
+};
+#endif
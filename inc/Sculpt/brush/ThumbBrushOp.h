@@ -3,6 +3,7 @@
 #include <Eigen/Dense>
 #include "sculpt/commonDefine.h"
 #include "sculpt/SUtil.h"
+#include "sculpt/brush/BrushVertexBatch.h"
 #include "tbb/parallel_for.h"
 #include "tbb/blocked_range.h"
 #include "sculpt/NormalUpdateOp.h"
@@ -28,16 +29,16 @@ public:
 			tbb::parallel_for(tbb::blocked_range<size_t>(0, _nodes.size()), *this);
 		else
 			(*this)(tbb::blocked_range<size_t>(0, _nodes.size()));
+		_sdata->bvh->leaf_node_fused_finish();
 	}
 
 	void operator()(const tbb::blocked_range<size_t>& range) const
 	{
 		BezierCurve *curve = _sdata->deform_curve;
-		const float sqrRadius = _sdata->world_radius * _sdata->world_radius;
-		const float invRadius = 1.0f / (float)_sdata->world_radius;
+		const float radius = _sdata->world_radius;
 		const Vector3f center = (_sdata->symn_data.cur_pos);
 		float bstrength = (float)_sdata->brush_strength;
-		float ri, x, b;
+		BrushVertexBatch batch(_sdata->bvh);
 
 		Vector3f displacement = (_sdata->symn_data.grab_delta);
 		Vector3f tmp = _avgNormal.cross(displacement);
@@ -47,40 +48,30 @@ public:
 
 			BMLeafNode *node = _nodes[i];
 
-			BMVertBackup *org_verts = node->originData()->_verts;
-			const size_t        num = node->originData()->_totverts;
-
-			for (size_t i = 0; i < num; i++)
-			{
-				BMVert* vert = org_verts[i].v;
-				Vector3f& orgCoord = org_verts[i].co;
-				Vector3f relativePos = (orgCoord - center);
-				if (relativePos.squaredNorm() < sqrRadius)
-				{
-					ri = relativePos.norm();
-					x = ri * invRadius;
-					b = (float)curve->evaluate(x);
-					vert->co = orgCoord + bstrength * b* displacement;
-				}
+			/*deform from original coordinates. the vertices come from the node's current vertex list,
+			so a vertex moved to another leaf by dynamic topology is written only by that leaf*/
+			if (batch.gather_original(node, center, radius)){
+				batch.falloff(curve);
+				batch.translate(bstrength * displacement);
+				batch.scatter();
 			}
+			_sdata->bvh->leaf_node_fused_update(node);
 		}
 	}
 
 	void init()
 	{
-		const float sqrRadius = _sdata->world_radius * _sdata->world_radius;
 		const float radius = _sdata->world_radius;
 		const Vector3f pos = (_sdata->symn_data.cur_pos);
-		isect_sphere_bm_bvh(_sdata->bvh, pos, radius, _nodes);
+		_nodes = _sdata->selection->nodes_select(_sdata->bvh, pos, radius);
+		_sdata->selection->verts_select(_sdata->deform_curve);
 
 		/*calculate deform data*/
 		VNormalFaceVertexUpdateOp faceNormalOp(_nodes);
 		faceNormalOp.run();
-		VNormalVertexUpdateOp vertNormOp(_nodes, pos, sqrRadius);
-		vertNormOp.run();
 
 		Vector3f viewdir = (_sdata->symn_data.view_dir);
-		VAverageBrushDataOp avgOp(_nodes, pos, sqrRadius, viewdir);
+		VAverageBrushDataOp avgOp(*_sdata->selection, viewdir, true/*vertex normals*/);
 		avgOp.run();
 		_avgNormal = avgOp.avgNormal();
 	}
@@ -42,6 +42,20 @@ struct BoxTubeIsectFunctor
 };
 
 
+struct BoxIsectFunctor
+{
+	BoxIsectFunctor(const Eigen::AlignedBox3f &box_)
+		: box(box_){}
+
+	bool isect(BaseNode *node) const
+	{
+		return box.intersects(node->boundsEigen());
+	}
+
+	Eigen::AlignedBox3f box;
+};
+
+
 struct BBInsideFunctor
 {
 	BBInsideFunctor(const Vector3f &p_)
@@ -57,15 +71,17 @@ struct BBInsideFunctor
 	Vector3f p;
 };
 
-int		isect_ray_backup_tris_nearest_hit(BMFaceBackup *faces, size_t num, const Vector3f &org, const Vector3f &dir, float &hitLambda, const float &epsilon);
+int		isect_ray_backup_tris_nearest_hit(const BMFaceBackup *faces, size_t num, const Vector3f &org, const Vector3f &dir, float &hitLambda, const float &epsilon);
 int		isect_ray_bm_faces_nearest_hit(BMFace * const *faces, size_t num, const Vector3f &org, const Vector3f &dir, float &hitLambda, const float &epsilon);
 int		isect_ray_bm_faces_all(BMFace * const *faces, size_t num, const Vector3f &org, const Vector3f &dir, float &hitLambda, const float &epsilon, bool test_cull);
 bool	isect_ray_bm_face(BMFace *face, const Vector3f &org, const Vector3f &dir, float &lambda, float uv[2], const float &epsilon, bool test_cull);
 
 bool	isect_ray_bm_bvh_nearest_hit(const BMBvh *bvh, const Vector3f &org, const Vector3f dir, bool origin_data, Vector3f &hit, const float epsilon);
+bool	isect_ray_bm_bvh_nearest_hit_cached(const BMBvh *bvh, const Vector3f &org, const Vector3f dir, bool origin_data, Vector3f &hit, const float epsilon);
 bool	isect_ray_bm_bvh_all_hit(const BMBvh *bvh, const Vector3f &org, const Vector3f dir, bool origin_data, std::vector<Vector3f> *hitpoints, std::vector<Vector2f> *hituvs, std::vector<BMFace*> *hitfaces, const float epsilon);
 
 bool	isect_sphere_bm_bvh(const BMBvh *bvh, const Eigen::Vector3f &center, const float &radius, std::vector<BMLeafNode*> &leafs);
+bool	isect_box_bm_bvh(const BMBvh *bvh, const Eigen::AlignedBox3f &box, std::vector<BMLeafNode*> &leafs);
 bool	isect_box_tube_bm_bvh(const BMBvh *bvh, const Eigen::Vector4f(*plane)[4], std::vector<BMLeafNode*> &leafs);
 
 bool	bvh_closest_face_point_to_face(const BMBvh *bvh, const Vector3f &p, Vector3f &r_closest_p, BMFace **r_closest_f);
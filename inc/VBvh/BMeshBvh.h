@@ -8,8 +8,7 @@
 #include "BMesh/BMesh.h"
 #include "tbb/scalable_allocator.h"
 #include "tbb/atomic.h"
-#define TBB_PREVIEW_MEMORY_POOL 1
-#include "tbb/memory_pool.h"
+#include "tbb/concurrent_vector.h"
 #include <Eigen/Geometry>
 using namespace VBvh;
 using namespace  VM;
@@ -26,8 +25,23 @@ struct BMeshBvhContext
 	int cd_voff;  /*at ((int*)aux_data)[cd_voff]*/
 	int cd_fnode; /*as above*/
 	int cd_foff;  /*as above*/
+	int cd_vorg;	/*index of the vertex in the origin log*/
+	int cd_vstamp;	/*stroke stamp. +stamp: logged, -stamp: created during the stroke*/
+	int cd_fstamp;	/*stroke stamp. -stamp: created during the stroke*/
 };
 
+/*int slots of the element aux data used by the bvh*/
+enum
+{
+	BVH_AUX_NODE	= 0,	/*cd_vnode, cd_fnode*/
+	BVH_AUX_OFF		= 1,	/*cd_voff, cd_foff*/
+	BVH_AUX_ORG		= 2,	/*cd_vorg*/
+	BVH_AUX_STAMP_F = 2,	/*cd_fstamp*/
+	BVH_AUX_STAMP_V = 3,	/*cd_vstamp*/
+	BVH_AUX_TOTAL	= 4
+};
+static_assert(BVH_AUX_TOTAL * sizeof(int) <= AUX_DATA_SIZE, "aux data too small for the bvh slots");
+
 enum
 {
 	LEAF_UPDATE_STEP_DRAW_BUFFER = 1 << 0,
@@ -52,15 +66,14 @@ struct BMVertBackup
 	BMVert *v;
 };
 
+/*state of a leaf node at stroke start, captured copy-on-write.
+faces and vertices which are not logged here are read from the mesh, see BMBvh::vert_org_co*/
 struct OriginLeafNodeData
 {
 	Vector3f lower; /*original bounding box. This structure needs to be aligned for correctly functioning*/
 	Vector3f upper;
 
-	BMFaceBackup *_faces;
-	size_t		  _totfaces;
-	BMVertBackup *_verts;
-	size_t		  _totverts;
+	std::vector<BMFaceBackup> _faces; /*original faces removed from this node during the stroke*/
 };
 
 class BMLeafNode : public BaseNode
@@ -120,12 +133,25 @@ public:
 private:
 	friend class BMBvh;
 	BaseNode *_parent_node;
-	std::vector<BMFace*, tbb::scalable_allocator<BMFace*>> _faces;
-	std::vector<BMVert*, tbb::scalable_allocator<BMVert*>> _verts;
+	BMFaceVector		 _faces;
+	BMVertVector		 _verts;
 	OriginLeafNodeData	*_orgData;
 	int					 _idx; /*index to bvh node array*/
 };
 
+class BMeshBvhOptimizer;
+
+/*leaf node of the last ray pick. successive picks along a stroke test it and its siblings first*/
+struct BMBvhPickCache
+{
+	BMLeafNode *leaf;
+
+	/*stats*/
+	size_t tot_pick;
+	size_t tot_leaf_hit;	 /*nearest hit found in the cached leaf node*/
+	size_t tot_ancestor_hit; /*nearest hit found in a sibling of the cached leaf node*/
+	size_t tot_fallback;	 /*nearest hit found elsewhere, or missed*/
+};
 
 class BMBvh
 {
@@ -135,22 +161,52 @@ public:
 	const std::vector<BMLeafNode*>& leafNodes(){ return _leafs; };
 	BaseNode *rootNode() const { return _root; } 
 	bool bvh_dirty(){ return _dirty; }
+	size_t modify_stamp() const { return _modify_stamp; }
 	void bvh_set_dirty(bool val){ _dirty = val; };
 	void bvh_marked_leaf_nodes_bb_update();
 	void bvh_full_refit();
+
+	/*fused update of a leaf node by the brush task which just moved its vertices: face normals and bounds
+	are computed while the node is hot in cache, and the node leaves the pending bounds update.
+	a face with a vertex of another leaf node may see it move later in the same pass, it is kept as a seam face.
+	leaf_node_fused_finish updates seam faces, it must be called once the pass is done*/
+	void leaf_node_fused_update(BMLeafNode *node);
+	void leaf_node_fused_finish();
+
+	/*passes which run concurrently share one finish: inside a group leaf_node_fused_finish does nothing,
+	the seam faces of all passes are finished by leaf_node_fused_group_end*/
+	void leaf_node_fused_group_begin();
+	void leaf_node_fused_group_end();
 	void bvh_full_update_bb_redraw();
 	void bvh_full_redraw();
 	void leaf_node_org_data_save(BMLeafNode *node);
 	void leaf_node_org_data_drop(BMLeafNode *node);
 
+	/*copy-on-write origin data of the current stroke. 
+	a vertex is logged before it is first modified or removed, an original face when it is removed.
+	a vertex is only logged by the thread which owns its leaf node*/
+	void			vert_org_save(BMVert *v);
+	const Vector3f&	vert_org_co(BMVert *v) const;
+	bool			vert_org_exists(BMVert *v) const;	/*existed at stroke start*/
+	bool			face_org_exists(BMFace *f) const;	/*existed at stroke start*/
+	const tbb::concurrent_vector<BMVertBackup>& org_verts() const { return _org_verts; }
+	void			org_data_reset();
+
 	void leaf_node_vert_add(BMLeafNode *node, BMVert *v);
 	void leaf_node_vert_remove(BMLeafNode *node, BMVert *v, bool reset = false);
 	void leaf_node_face_add(BMLeafNode *node, BMFace *f);
 	void leaf_node_face_remove(BMLeafNode *node, BMFace *f, bool reset = false);
 
+	void sculpt_stroke_begin_update();
 	void sculpt_stroke_step_update();
 	void sculpt_stroke_finish_update();
 
+	void bvh_optimize_begin();
+	void bvh_optimize_end();
+
+	BMBvhPickCache& pick_cache() const { return _pick_cache; }
+	void pick_cache_reset() { _pick_cache.leaf = nullptr; }
+
 
 	BLI_MEMBER_INLINE BMLeafNode* elem_leaf_node_get(BMVert *v)
 	{
@@ -222,8 +278,13 @@ private:
 	void	leaf_node_collect_vert_from_face();
 	void	leaf_node_collect_vert_from_face(std::vector<BMLeafNode*> &nodes);
 	void	leaf_node_split_big(std::vector<BMLeafNode*> &largenodes);
+	void	leaf_node_slots_fill(const std::vector<BMLeafNode*> &nodes);
+	void	leaf_node_slots_compact();
+	void	vert_org_stamp_reset(BMVert *v);
+	void	node_leafs_collect(BaseNode *node, std::vector<BMLeafNode*> &leafs);
 	void	leaf_node_free(BMLeafNode *lnode);
 	void	leaf_node_bound_face_norm_update(BMLeafNode *node);
+	bool	leaf_node_face_owned(BMLeafNode *node, BMFace *f);
 	void	leaf_node_indexing(const std::vector<BMLeafNode*> &nodes);
 	void	leaf_node_faces_add_referece(const std::vector<BMLeafNode*> &nodes);
 	void    base_node_free(BaseNode *bnode);
@@ -232,7 +293,14 @@ private:
 	BaseNode				*_root;
 	std::vector<BMLeafNode*> _leafs;
 	bool					_dirty;
-	tbb::memory_pool<tbb::scalable_allocator<char>> _originDataAllocator;
+	tbb::atomic<size_t>		_modify_stamp; /*bumped on every change to leaf content or bounds. leaf nodes may be edited concurrently*/
+	BMeshBvhOptimizer		*_optimizer;
+	mutable BMBvhPickCache	_pick_cache;
+	tbb::concurrent_vector<BMVertBackup> _org_verts; /*original coordinates of the vertices modified during the stroke*/
+	tbb::concurrent_vector<std::pair<BMLeafNode*, std::vector<BMFace*>>> _fused_seams; /*seam faces of the current fused pass*/
+	bool					_fused_group;
+	int						_org_stamp;
+	bool					_org_active;	/*a stroke is running*/
 };
 
 
@@ -0,0 +1,56 @@
+#ifndef VBVH_BMESHBVH_OPTIMIZER_H
+#define VBVH_BMESHBVH_OPTIMIZER_H
+#include "VBvh/VBvhDefine.h"
+#include "VBvh/BMeshBvh.h"
+#include "VBvh/VPrimRef.h"
+#include "VBvh/VPrimInfor.h"
+#include "tbb/atomic.h"
+#include "tbb/task_group.h"
+#include <vector>
+
+VBVH_BEGIN_NAMESPACE
+
+/*re-optimize degraded sub-trees of a BMBvh between strokes.
+the tree is analysed on the calling thread, the SAH rebuilds run on a background worker.
+rebuilt sub-trees stay detached from the live tree until BMBvh swaps them in.
+the mesh must not be modified while the worker is running*/
+class BMeshBvhOptimizer
+{
+public:
+	struct SubtreeTask
+	{
+		BaseNode			*node;		/*degraded sub-tree in the live tree*/
+		BaseNode			*parent;	/*parent of node in the live tree*/
+		std::vector<BMFace*> faces;		/*faces of the sub-tree, captured at analysis time*/
+
+		/*result*/
+		BaseNode				*new_root;
+		std::vector<BMLeafNode*> new_leafs;
+		tbb::atomic<bool>		 done;
+	};
+
+public:
+	BMeshBvhOptimizer(const BMeshBvhContext &bmbvhinfo);
+	~BMeshBvhOptimizer();
+	void	start(BaseNode *root, size_t stamp);
+	void	stop();
+	void	clear();
+	bool	pending() const { return !_tasks.empty(); }
+	size_t	stamp() const { return _stamp; }
+	const std::vector<SubtreeTask*>& tasks() const { return _tasks; }
+private:
+	void	node_analyse(BaseNode *node, BaseNode *parent, size_t &r_faces, size_t &r_leafs);
+	void	node_faces_collect(BaseNode *node, std::vector<BMFace*> &faces);
+	void	subtree_build(SubtreeTask &task);
+	void	subtree_free(BaseNode *node);
+private:
+	const BMeshBvhContext	  &_bmbvh_info;
+	std::vector<SubtreeTask*>  _tasks;
+	size_t					   _stamp;
+	tbb::atomic<bool>		   _cancel;
+	tbb::task_group			   _worker;
+	bool					   _running;
+};
+
+VBVH_END_NAMESPACE
+#endif
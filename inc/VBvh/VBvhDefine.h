@@ -3,6 +3,8 @@
 
 #include "BMesh/BMesh.h"
 #include "tbb/scalable_allocator.h"
+#include "tbb/spin_mutex.h"
+#include <boost/container/small_vector.hpp>
 #include <Eigen/Dense>
 
 #define VBVH_BEGIN_NAMESPACE  namespace VBvh {
@@ -27,8 +29,54 @@ VBVH_BEGIN_NAMESPACE
 const std::string cd_node_off = "nodePtrLayer";
 const std::string cd_arr_off  = "arrayOffLayer";
 
-typedef std::vector<BMFace*, tbb::scalable_allocator<BMFace*>> BMFaceVector;
-typedef std::vector<BMVert*, tbb::scalable_allocator<BMVert*>> BMVertVector;
+/*leaf node element arrays. sparse leaf nodes, such as those emptied by edge collapse or by elements moving to
+other nodes, keep their elements inline. filled leaf nodes take a block from LeafBlockPool*/
+static const size_t LEAF_INLINE_FACES = 16;
+static const size_t LEAF_INLINE_VERTS = 16;
+static const size_t LEAF_BLOCK_SIZE	  = 512; /*BMeshBvhBuilder leaf limit of 400 faces, rounded up*/
+
+/*shared pool of leaf element arrays. blocks come in size classes of 32 elements up to LEAF_BLOCK_SIZE and are
+carved from 64 KB slabs, so the arrays of leaf nodes built together are next to each other in memory.
+larger arrays, leaf nodes waiting for a split, go to the tbb scalable pool. slabs are kept for reuse*/
+class LeafBlockPool
+{
+public:
+	static void* alloc(size_t bytes);
+	static void  free(void *p, size_t bytes);
+private:
+	static const size_t GRANULE	   = 32 * sizeof(void*);
+	static const size_t CLASSES	   = LEAF_BLOCK_SIZE * sizeof(void*) / GRANULE;
+	static const size_t SLAB_BYTES = 64 * 1024;
+
+	static size_t class_get(size_t bytes){ return (bytes + GRANULE - 1) / GRANULE - 1; }
+
+	static tbb::spin_mutex	  _mutex;
+	static std::vector<void*> _free[CLASSES];
+};
+
+template<typename T>
+class LeafBlockAllocator
+{
+public:
+	typedef T			value_type;
+	typedef T*			pointer;
+	typedef const T*	const_pointer;
+	typedef size_t		size_type;
+	typedef ptrdiff_t	difference_type;
+	template<typename U> struct rebind { typedef LeafBlockAllocator<U> other; };
+
+	LeafBlockAllocator(){}
+	template<typename U> LeafBlockAllocator(const LeafBlockAllocator<U>&){}
+
+	T*		allocate(size_t n, const void* = 0){ return static_cast<T*>(LeafBlockPool::alloc(n * sizeof(T))); }
+	void	deallocate(T *p, size_t n){ LeafBlockPool::free(p, n * sizeof(T)); }
+	size_t	max_size() const { return static_cast<size_t>(-1) / sizeof(T); }
+};
+template<typename T, typename U> bool operator==(const LeafBlockAllocator<T>&, const LeafBlockAllocator<U>&){ return true; }
+template<typename T, typename U> bool operator!=(const LeafBlockAllocator<T>&, const LeafBlockAllocator<U>&){ return false; }
+
+typedef boost::container::small_vector<BMFace*, LEAF_INLINE_FACES, LeafBlockAllocator<BMFace*>> BMFaceVector;
+typedef boost::container::small_vector<BMVert*, LEAF_INLINE_VERTS, LeafBlockAllocator<BMVert*>> BMVertVector;
 
 
 /*! Maximal depth of the BVH. */
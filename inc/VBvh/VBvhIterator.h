@@ -24,10 +24,12 @@ private:
 	typedef boost::container::static_vector<IterNode, STACK_SIZE>  IterStack;
 	typedef boost::container::static_vector<IterNode, 4>		    HitNodes;
 public:
-	VBvhRayIterator(BaseNode* root, Ray *ray)
+	/*skip: sub-tree excluded from traversal*/
+	VBvhRayIterator(BaseNode* root, Ray *ray, BaseNode *skip = nullptr)
 		:
 		_root(root),
 		_ray(ray),
+		_skip(skip),
 		_curleaf(nullptr)
 	{
 		_stack.push_back(IterNode(dynamic_cast<BaseNode*>(_root), std::numeric_limits<float>::lowest()));
@@ -72,7 +74,7 @@ private:
 				HitNodes hits;
 				for (size_t ni = 0; ni < 4; ni++){
 					BaseNode *child = node->child(ni);
-					if (child){
+					if (child && child != _skip){
 						const BBox3fa &bb = child->bounds();
 						Vector3f lower(bb.lower.x, bb.lower.y, bb.lower.z);
 						Vector3f upper(bb.upper.x, bb.upper.y, bb.upper.z);
@@ -116,6 +118,7 @@ private:
 private:
 	BaseNode *_root;
 	Ray		  *_ray;
+	BaseNode  *_skip;
 	IterStack  _stack;
 	LeafType  *_curleaf;
 };
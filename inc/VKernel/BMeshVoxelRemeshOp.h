@@ -0,0 +1,65 @@
+#ifndef VKERNEL_VOXEL_REMESH_OP
+#define VKERNEL_VOXEL_REMESH_OP
+#include "BMesh/BMesh.h"
+#include "VBvh/BMeshBvh.h"
+#include <vector>
+#include <cstdint>
+
+using namespace VM;
+
+/*uniform remesh through a sparse voxel grid.
+the grid is split into blocks of BLOCK_SIZE^3 cells, only blocks near the reference surface are allocated
+and indexed, by a sorted list of their keys, so memory follows the surface and not the bounding volume.
+samples hold the signed distance to the closest face of the reference bvh within a narrow band, the sign
+follows the face normal. surface nets puts one vertex per cell crossed by the surface and one quad per crossed edge.
+blocks are processed in parallel, the new mesh is built in one pass over the collected vertices and triangles*/
+class BMeshVoxelRemeshOp
+{
+	enum
+	{
+		BLOCK_SIZE = 8,
+		BLOCK_SAMPLES = BLOCK_SIZE + 1	/*samples per block axis, the last one is shared with the next block*/
+	};
+
+	struct Block
+	{
+		int		 org[3];	/*first cell*/
+		float	 dist[BLOCK_SAMPLES * BLOCK_SAMPLES * BLOCK_SAMPLES];	/*FLT_MAX outside the band*/
+		int		 cell_vert[BLOCK_SIZE * BLOCK_SIZE * BLOCK_SIZE];	/*index in verts or -1*/
+		size_t	 vert_offset;
+		std::vector<Vector3f> verts;
+		std::vector<int>	  tris;
+	};
+
+public:
+	BMeshVoxelRemeshOp(BMBvh *refer_bvh, float voxel_size);
+	~BMeshVoxelRemeshOp();
+
+	/*a new mesh, the reference is not changed*/
+	BMesh*	run();
+
+	/*about the average edge length of the reference mesh*/
+	static float defaultVoxelSize(BMesh *bm);
+private:
+	void	gridSetup();
+	void	blocksMark();
+	void	blockSample(Block &block);
+	void	blockVertices(Block &block);
+	void	blockFaces(Block &block);
+	int		cellVertex(int x, int y, int z) const;
+	int		blockSlot(int bx, int by, int bz) const;
+	uint64_t blockKey(int bx, int by, int bz) const { return (static_cast<uint64_t>(bz) * _nblock[1] + by) * _nblock[0] + bx; }
+	BMesh*	meshBuild();
+
+	static size_t sampleIndex(int x, int y, int z) { return (z * BLOCK_SAMPLES + y) * BLOCK_SAMPLES + x; }
+	static size_t cellIndex(int x, int y, int z)   { return (z * BLOCK_SIZE + y) * BLOCK_SIZE + x; }
+private:
+	BMBvh	*_refer_bvh;
+	float	 _voxel;
+	float	 _band;		/*samples further from the surface are not computed*/
+	Vector3f _origin;	/*position of sample 0*/
+	int		 _nblock[3];
+	std::vector<uint64_t> _block_keys;	/*sorted keys of the allocated blocks, _blocks is in the same order*/
+	std::vector<Block>	_blocks;
+};
+#endif
@@ -6,12 +6,34 @@
 #include "BezierCurve.h"
 #include "StrokeData.h"
 #include "brush/SculptStroke.h"
+#include "brush/StrokeRecord.h"
+#include "brush/DabScheduler.h"
 #include "commonDefine.h"
 #include "VKernel/VMeshObject.h"
-#include <queue>
+#include <QRect>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
+class QQuickWindow;
+
+/*mouse events only queue samples. dabs run on a sculpt worker thread, which holds g_sculpt_mutex
+while it modifies the mesh so that the renderer syncs dirty leaf nodes between dabs.
+the worker reads no gui state: the view is captured when the stroke begins, samples carry window coordinates*/
 class VSculptBrushOp : public VOperator
 {
+	typedef std::pair<Vector2f, Vector2f> MouseRange;
+
+	/*the view does not change during a stroke*/
+	struct ViewState
+	{
+		Matrix4x4	proj;
+		Matrix4x4	modelview;
+		QRect		viewport;
+		Vector3f	camera;		/*scene space*/
+		Vector3f	view_dir;	/*model space, toward the viewer*/
+	};
 public:
 	VSculptBrushOp(vk::VScene *scene);
 	virtual ~VSculptBrushOp();
@@ -23,20 +45,32 @@ public:
 	virtual int  invoke(QEvent *ev);
 private:
 	void init();
-	void apply();
+	void apply(const MouseRange &mrange);
 	void cancel();
 
+	void worker_start();
+	void worker_stop();
+	void worker_run(QQuickWindow *window);
+	bool worker_idle_pending();
+	void view_update();
+	void view_line(Vector2f mouse, Vector3f &l1, Vector3f &l2);
+	float view_world_distance(float pixel_dst, const Vector3f &ref_pos);
+
 	void add_step(Vector2f cur_mouse, Vector2f last_mouse, Vector2f first_hit_mouse);
+	void add_dab(Vector2f cur_mouse, Vector2f last_mouse, std::vector<StrokeDab> &dabs);
 	bool update(Vector2f cur_mouse, Vector2f last_mouse, Vector2f first_hit_mouse);
 	bool init_stroke(Vector2f curmouse);
 	bool is_sample_mouse();
 	void sample_mouse(Vector2f start, Vector2f end);
+	void refine();
 	bool is_one_step_stroke();
 
 	bool pick(Vector2f mouse, Vector3f &hit);
 	void interpolate_param();
+	void view_detail_update();
 	void init_undo_redo();
 	void queue_mouse_range(Vector2f start, Vector2f end);
+	StrokeRecord::Sample record_sample();
 private:
 	VScene *_scene;
 	VMeshObject *_object;
@@ -57,6 +91,22 @@ private:
 	SculptStroke *_stroke;
 	BezierCurve *_curve;
 
-	std::queue<std::pair<Vector2f, Vector2f>> _queuemouse;
+	std::deque<MouseRange>	_queuemouse;
+	std::mutex				_queue_mutex;
+	std::condition_variable	_queue_cond;
+	std::thread				_worker;
+	bool					_worker_stop; /*under _queue_mutex*/
+	ViewState				_view;
+	bool					_sample_mouse;
+
+	/*stroke input is recorded for replay when VSCULPT_STROKE_RECORD names a file*/
+	StrokeRecord	*_record;
+	std::string		 _record_path;
+	int				 _falloff;
+	Vector3f		 _ray_org; /*view ray of the last dab*/
+	Vector3f		 _ray_dir;
+	std::vector<StrokeRecord::Sample> _record_samples;
+
+	DabScheduler	 _scheduler;
 };
 #endif
\ No newline at end of file
@@ -16,6 +16,17 @@
 #include <boost/container/small_vector.hpp>
 #include <tuple>
 
+#ifdef USE_BOOST_POOL
+#define BM_POOL_ALLOC(T, pool)		reinterpret_cast<T*>((pool).malloc())
+#define BM_POOL_FREE(pool, elm)		(pool).free(elm)
+#else
+#define BM_POOL_ALLOC(T, pool)		reinterpret_cast<T*>((pool).allocate(1))
+#define BM_POOL_FREE(pool, elm)		(pool).deallocate(elm, 1)
+#endif
+
+/*elements and custom data blocks taken from a pool at once when a local reserve is empty*/
+#define BM_LOCAL_RESERVE 64
+
 extern std::vector<Point3Dd> g_vscene_testPoints;
 
 VM_BEGIN_NAMESPACE
@@ -27,7 +38,8 @@ BMesh::BMesh()
 	_tot_vert(0),
 	_tot_edge(0),
 	_tot_loop(0),
-	_tot_face(0)
+	_tot_face(0),
+	_local_enabled(false)
 #ifdef USE_BOOST_POOL
 #ifdef LIMIT_MEM_POOL
 	_vpool(sizeof(BMVert), 32, 256),
@@ -64,7 +76,8 @@ BMesh::BMesh(BMesh &other)
 	_vert_data(other._vert_data),
 	_edge_data(other._edge_data),
 	_face_data(other._face_data),
-	_loop_data(other._loop_data)
+	_loop_data(other._loop_data),
+	_local_enabled(false)
 {
 	vtable.resize(other._tot_vert);
 	etable.resize(other._tot_edge);
@@ -112,12 +125,22 @@ BMesh::BMesh(BMesh &other)
 
 BMVert * BMesh::BM_vert_create(const Vector3f &co, const BMVert *v_example, const eBMCreateFlag create_flag)
 {
-#ifdef USE_BOOST_POOL
-	BMVert *v = reinterpret_cast<BMVert*>(_vpool.malloc());
-#else
-	BMVert *v = reinterpret_cast<BMVert*>(_vpool.allocate(1));
-#endif
-	_vert_list.insert(v);
+	BMLocalData *local = _local_enabled ? &_local.local() : nullptr;
+	BMVert *v;
+	if (local){
+		v = bm_local_elem_alloc(_vpool, local->vert_reserve);
+		local->vert_list.insert(v);
+		local->tot_vert++;
+	}
+	else{
+		v = BM_POOL_ALLOC(BMVert, _vpool);
+		_vert_list.insert(v);
+		_tot_vert++;
+
+		/* may add to middle of the pool */
+		_elem_index_dirty |= BM_VERT;
+		_elem_table_dirty |= BM_VERT;
+	}
 
 	BLI_assert((v_example == NULL) || (v_example->head.htype == BM_VERT));
 	BLI_assert(!(create_flag & 1));
@@ -149,11 +172,11 @@ BMVert * BMesh::BM_vert_create(const Vector3f &co, const BMVert *v_example, cons
 	/* disallow this flag for verts - its meaningless */
 	BLI_assert((create_flag & BM_CREATE_NO_DOUBLE) == 0);
 
-	/* may add to middle of the pool */
-	_elem_index_dirty |= BM_VERT;
-	_elem_table_dirty |= BM_VERT;
-
-	_tot_vert++;
+	if (local && !(create_flag & BM_CREATE_SKIP_CD)) {
+		/* copying from an example could allocate from the shared pool */
+		BLI_assert(v_example == NULL);
+		v->head.data = bm_local_data_alloc(_vert_data, local->vdata_reserve);
+	}
 
 	if (!(create_flag & BM_CREATE_SKIP_CD)) {
 		if (v_example) {
@@ -202,12 +225,22 @@ BMEdge * BMesh::BM_edge_create(BMVert *v1, BMVert *v2, const BMEdge *e_example,
 
 	if ((create_flag & BM_CREATE_NO_DOUBLE) && (e = BM_edge_exists(v1, v2)))
 		return e;
-#ifdef USE_BOOST_POOL
-	e = reinterpret_cast<BMEdge*>(_epool.malloc());
-#else
-	e = reinterpret_cast<BMEdge*>(_epool.allocate(1));
-#endif
-	_edge_list.insert(e);
+
+	BMLocalData *local = _local_enabled ? &_local.local() : nullptr;
+	if (local){
+		e = bm_local_elem_alloc(_epool, local->edge_reserve);
+		local->edge_list.insert(e);
+		local->tot_edge++;
+	}
+	else{
+		e = BM_POOL_ALLOC(BMEdge, _epool);
+		_edge_list.insert(e);
+		_tot_edge++;
+
+		/* may add to middle of the pool */
+		_elem_index_dirty |= BM_EDGE;
+		_elem_table_dirty |= BM_EDGE;
+	}
 
 	/* --- assign all members --- */
 	e->head.data = NULL;
@@ -232,11 +265,10 @@ BMEdge * BMesh::BM_edge_create(BMVert *v1, BMVert *v2, const BMEdge *e_example,
 	bmesh_disk_edge_append(e, e->v1);
 	bmesh_disk_edge_append(e, e->v2);
 
-	/* may add to middle of the pool */
-	_elem_index_dirty |= BM_EDGE;
-	_elem_table_dirty |= BM_EDGE;
-
-	_tot_edge++;
+	if (local && !(create_flag & BM_CREATE_SKIP_CD)) {
+		BLI_assert(e_example == NULL);
+		e->head.data = bm_local_data_alloc(_edge_data, local->edata_reserve);
+	}
 
 	if (!(create_flag & BM_CREATE_SKIP_CD)) {
 		if (e_example) {
@@ -263,12 +295,20 @@ BMLoop *BMesh::bm_loop_create(
 {
 	BMLoop *l = NULL;
 
-#ifdef USE_BOOST_POOL
-	l = reinterpret_cast<BMLoop*>(_lpool.malloc());
-#else
-	l = reinterpret_cast<BMLoop*>(_lpool.allocate(1));
-#endif
-	_loop_list.insert(l);
+	BMLocalData *local = _local_enabled ? &_local.local() : nullptr;
+	if (local){
+		l = bm_local_elem_alloc(_lpool, local->loop_reserve);
+		local->loop_list.insert(l);
+		local->tot_loop++;
+	}
+	else{
+		l = BM_POOL_ALLOC(BMLoop, _lpool);
+		_loop_list.insert(l);
+		_tot_loop++;
+
+		/* may add to middle of the pool */
+		_elem_index_dirty |= BM_LOOP;
+	}
 
 #ifdef USE_BMLOOP_HEAD
 	BLI_assert((l_example == NULL) || (l_example->head.htype == BM_LOOP));
@@ -303,13 +343,12 @@ BMLoop *BMesh::bm_loop_create(
 	l->prev = NULL;
 	/* --- done --- */
 
-	/* may add to middle of the pool */
-	_elem_index_dirty |= BM_LOOP;
-
-	_tot_loop++;
-
 	if (!(create_flag & BM_CREATE_SKIP_CD)) {
 #ifdef USE_BMLOOP_HEAD
+		if (local) {
+			BLI_assert(l_example == NULL);
+			l->head.data = bm_local_data_alloc(_loop_data, local->ldata_reserve);
+		}
 		if (l_example) {
 			/* no need to copy attrs, just handle customdata */
 			//BM_elem_attrs_copy(this, this, l_example, l);
@@ -384,12 +423,21 @@ BMFace* BMesh::bm_mesh_copy_new_face(BMesh *bm_new, BMesh *bm_old, std::vector<B
 BMFace * BMesh::bm_face_create__internal()
 {
 	BMFace *f;
-#ifdef USE_BOOST_POOL
-	f = reinterpret_cast<BMFace*>(_fpool.malloc());
-#else
-	f = reinterpret_cast<BMFace*>(_fpool.allocate(1));
-#endif
-	_face_list.insert(f);
+	if (_local_enabled){
+		BMLocalData &local = _local.local();
+		f = bm_local_elem_alloc(_fpool, local.face_reserve);
+		local.face_list.insert(f);
+		local.tot_face++;
+	}
+	else{
+		f = BM_POOL_ALLOC(BMFace, _fpool);
+		_face_list.insert(f);
+		_tot_face++;
+
+		/* may add to middle of the pool */
+		_elem_index_dirty |= BM_FACE;
+		_elem_table_dirty |= BM_FACE;
+	}
 
 	/* --- assign all members --- */
 	f->head.data = NULL;
@@ -412,12 +460,6 @@ BMFace * BMesh::bm_face_create__internal()
 	// zero_v3(f->no);
 	/* --- done --- */
 
-	/* may add to middle of the pool */
-	_elem_index_dirty |= BM_FACE;
-	_elem_table_dirty |= BM_FACE;
-
-	_tot_face++;
-
 	return f;
 }
 
@@ -457,6 +499,11 @@ BMFace * BMesh::BM_face_create(BMVert **verts, BMEdge **edges, const int len, co
 
 	f = bm_face_create__internal();
 
+	if (_local_enabled && !(create_flag & BM_CREATE_SKIP_CD)) {
+		BLI_assert(f_example == NULL);
+		f->head.data = bm_local_data_alloc(_face_data, _local.local().fdata_reserve);
+	}
+
 	startl = lastl = bm_face_boundary_add(f, verts[0], edges[0], create_flag);
 
 	startl->v = verts[0];
@@ -578,6 +625,15 @@ BMFace * BMesh::BM_face_create_quad_tri(BMVert *v1, BMVert *v2, BMVert *v3, BMVe
 */
 void BMesh::bm_kill_only_vert(BMVert *v, bool log)
 {
+	if (_local_enabled){
+		BMLocalData &local = _local.local();
+		if (log)
+			v->head.hflag |= BM_ELEM_REMOVED;
+		local.vert_kill.push_back(v);
+		local.tot_vert--;
+		return;
+	}
+
 	_tot_vert--;
 	_elem_index_dirty |= BM_VERT;
 	_elem_table_dirty |= BM_VERT;
@@ -609,6 +665,13 @@ void BMesh::bm_kill_only_vert(BMVert *v, bool log)
 */
 void BMesh::bm_kill_only_edge(BMEdge *e)
 {
+	if (_local_enabled){
+		BMLocalData &local = _local.local();
+		local.edge_kill.push_back(e);
+		local.tot_edge--;
+		return;
+	}
+
 	_tot_edge--;
 	_elem_index_dirty |= BM_EDGE;
 	_elem_table_dirty |= BM_EDGE;
@@ -630,6 +693,15 @@ void BMesh::bm_kill_only_edge(BMEdge *e)
 */
 void BMesh::bm_kill_only_face(BMFace *f, bool log)
 {
+	if (_local_enabled){
+		BMLocalData &local = _local.local();
+		if (log)
+			f->head.hflag |= BM_ELEM_REMOVED;
+		local.face_kill.push_back(f);
+		local.tot_face--;
+		return;
+	}
+
 	_tot_face--;
 	_elem_index_dirty |= BM_FACE;
 	_elem_table_dirty |= BM_FACE;
@@ -657,6 +729,13 @@ void BMesh::bm_kill_only_face(BMFace *f, bool log)
 
 void BMesh::bm_kill_only_loop(BMLoop *l)
 {
+	if (_local_enabled){
+		BMLocalData &local = _local.local();
+		local.loop_kill.push_back(l);
+		local.tot_loop--;
+		return;
+	}
+
 	_tot_loop--;
 	_elem_index_dirty |= BM_LOOP;
 
@@ -673,6 +752,129 @@ void BMesh::bm_kill_only_loop(BMLoop *l)
 #endif
 }
 
+template<typename T, typename Pool>
+T* BMesh::bm_local_elem_alloc(Pool &pool, std::vector<T*> &reserve)
+{
+	if (reserve.empty()){
+		tbb::spin_mutex::scoped_lock lock(_local_mutex);
+		for (size_t i = 0; i < BM_LOCAL_RESERVE; ++i)
+			reserve.push_back(BM_POOL_ALLOC(T, pool));
+	}
+
+	T *elm = reserve.back();
+	reserve.pop_back();
+	return elm;
+}
+
+void* BMesh::bm_local_data_alloc(CustomData &data, std::vector<void*> &reserve)
+{
+	if (data.totsize <= 0)
+		return nullptr;
+
+	if (reserve.empty()){
+		tbb::spin_mutex::scoped_lock lock(_local_mutex);
+		for (size_t i = 0; i < BM_LOCAL_RESERVE; ++i)
+			reserve.push_back(data.pool->malloc());
+	}
+
+	void *block = reserve.back();
+	reserve.pop_back();
+	return block;
+}
+
+void BMesh::BM_mesh_local_begin()
+{
+	BLI_assert(!_local_enabled);
+	_local.clear();
+	_local_enabled = true;
+}
+
+/*sync point: link the created elements of all threads into the mesh, then unlink and free the killed ones.
+created lists go first because a thread can kill an element another thread created*/
+void BMesh::BM_mesh_local_end()
+{
+	BLI_assert(_local_enabled);
+	_local_enabled = false;
+
+	for (auto it = _local.begin(); it != _local.end(); ++it){
+		BMLocalData &local = *it;
+		_vert_list.splice(local.vert_list);
+		_edge_list.splice(local.edge_list);
+		_loop_list.splice(local.loop_list);
+		_face_list.splice(local.face_list);
+
+		_tot_vert = (size_t)((ptrdiff_t)_tot_vert + local.tot_vert);
+		_tot_edge = (size_t)((ptrdiff_t)_tot_edge + local.tot_edge);
+		_tot_loop = (size_t)((ptrdiff_t)_tot_loop + local.tot_loop);
+		_tot_face = (size_t)((ptrdiff_t)_tot_face + local.tot_face);
+	}
+
+	for (auto it = _local.begin(); it != _local.end(); ++it)
+		bm_local_merge(*it);
+
+	_local.clear();
+
+	_elem_index_dirty |= BM_VERT | BM_EDGE | BM_LOOP | BM_FACE;
+	_elem_table_dirty |= BM_VERT | BM_EDGE | BM_FACE;
+}
+
+void BMesh::bm_local_merge(BMLocalData &local)
+{
+	for (size_t i = 0; i < local.vert_kill.size(); ++i){
+		BMVert *v = local.vert_kill[i];
+		_vert_list.remove(v);
+		if (BM_elem_flag_test(v, BM_ELEM_REMOVED)){
+			_removed_vert_list.insert(v);
+		}
+		else{
+			if (v->head.data)
+				_vert_data.CustomData_bmesh_free_block(&v->head.data);
+			BM_POOL_FREE(_vpool, v);
+		}
+	}
+
+	for (size_t i = 0; i < local.edge_kill.size(); ++i){
+		BMEdge *e = local.edge_kill[i];
+		_edge_list.remove(e);
+		if (e->head.data)
+			_edge_data.CustomData_bmesh_free_block(&e->head.data);
+		BM_POOL_FREE(_epool, e);
+	}
+
+	for (size_t i = 0; i < local.loop_kill.size(); ++i){
+		BMLoop *l = local.loop_kill[i];
+		_loop_list.remove(l);
+#ifdef USE_BMLOOP_HEAD
+		if (l->head.data)
+			_loop_data.CustomData_bmesh_free_block(&l->head.data);
+#endif
+		BM_POOL_FREE(_lpool, l);
+	}
+
+	for (size_t i = 0; i < local.face_kill.size(); ++i){
+		BMFace *f = local.face_kill[i];
+		_face_list.remove(f);
+		if (BM_elem_flag_test(f, BM_ELEM_REMOVED)){
+			_removed_face_list.insert(f);
+		}
+		else{
+			if (f->head.data)
+				_face_data.CustomData_bmesh_free_block(&f->head.data);
+			BM_POOL_FREE(_fpool, f);
+		}
+	}
+
+	/*give back what was reserved but not used*/
+	for (size_t i = 0; i < local.vert_reserve.size(); ++i) BM_POOL_FREE(_vpool, local.vert_reserve[i]);
+	for (size_t i = 0; i < local.edge_reserve.size(); ++i) BM_POOL_FREE(_epool, local.edge_reserve[i]);
+	for (size_t i = 0; i < local.loop_reserve.size(); ++i) BM_POOL_FREE(_lpool, local.loop_reserve[i]);
+	for (size_t i = 0; i < local.face_reserve.size(); ++i) BM_POOL_FREE(_fpool, local.face_reserve[i]);
+	for (size_t i = 0; i < local.vdata_reserve.size(); ++i) _vert_data.pool->free(local.vdata_reserve[i]);
+	for (size_t i = 0; i < local.edata_reserve.size(); ++i) _edge_data.pool->free(local.edata_reserve[i]);
+	for (size_t i = 0; i < local.ldata_reserve.size(); ++i) _loop_data.pool->free(local.ldata_reserve[i]);
+	for (size_t i = 0; i < local.fdata_reserve.size(); ++i) _face_data.pool->free(local.fdata_reserve[i]);
+}
+
 /**
 * kills all edges associated with \a f, along with any other faces containing
 * those edges
@@ -1,4 +1,5 @@
 #include "BMesh/Tools/BMeshDecimate.h"
+#include "BMesh/Tools/BMeshEdgeQueueBench.h"
 #include "BaseLib/MathUtil.h"
 #include "BaseLib/MathGeom.h"
 #include "tbb/parallel_for.h"
@@ -18,7 +19,8 @@ void BMeshDecimate::run()
 
 	_vquadrics.resize(_bm->BM_mesh_verts_total());
 	memset(_vquadrics.data(), 0, _vquadrics.size() * sizeof(Qdr::Quadric));
-	_eheaphandles.resize(_bm->BM_mesh_edges_total());
+	_edges = _bm->BM_mesh_edge_table();
+	_eheap.reset(_edges.size());
 
 	bm_decim_build_quadrics();
 	bm_decim_build_edge_cost();
@@ -29,18 +31,17 @@ void BMeshDecimate::run()
 	/* simple non-mirror case */
 	while ((_bm->BM_mesh_faces_total() > face_tot_target) && (!_eheap.empty()))
 	{
-		const EHeapNode enode = _eheap.top(); _eheap.pop();
-		if (enode.cost  == COST_INVALID) continue;
+		const float cost = _eheap.top_cost();
+		BMEdge *e = _edges[_eheap.top_id()];
+		/* popping also drops the id, so a freed edge is never looked up again */
+		if (_stream) _stream->record(EdgeQueueStream::OP_POP, _eheap.top_id(), cost);
+		_eheap.pop();
+		if (cost == COST_INVALID) continue;
 
 		// const float value = BLI_heap_node_value(BLI_heap_top(eheap));
-		BMEdge *e = enode.e;
 		Vector3f optimize_co;
 		BLI_assert(BM_elem_index_get(e) < tot_edge_orig);  /* handy to detect corruptions elsewhere */
 
-		/* under normal conditions wont be accessed again,
-		* but NULL just incase so we don't use freed node */
-		_eheaphandles[BM_elem_index_get(e)] = EHeapHanle();
-
 		bm_decim_edge_collapse(e, optimize_co, true);
 	}
 }
@@ -115,23 +116,13 @@ void BMeshDecimate::bm_decim_build_edge_cost_single_heap(BMEdge *e, bool update
 {
 	float cost = bm_decim_build_edge_cost_single(e);
 
+	if (_stream) _stream->record(update ? EdgeQueueStream::OP_UPDATE : EdgeQueueStream::OP_PUSH, BM_elem_index_get(e), cost);
+
 	if (update){
-		EHeapHanle &ehanle = _eheaphandles[BM_elem_index_get(e)];
-		if (ehanle.node_){
-			EHeapNode &node = *ehanle;
-			if (node.cost < cost){
-				_eheap.increase(ehanle, EHeapNode(node.e, cost));
-			}
-			else{
-				_eheap.decrease(ehanle, EHeapNode(node.e, cost));
-			}
-		}
-		else{
-			_eheaphandles[BM_elem_index_get(e)] = _eheap.push(EHeapNode(e, cost));
-		}
+		_eheap.update(BM_elem_index_get(e), cost);
 	}
 	else{
-		_eheaphandles[BM_elem_index_get(e)] = _eheap.push(EHeapNode(e, cost));
+		_eheap.push(BM_elem_index_get(e), cost);
 	}
 }
 
@@ -210,7 +201,8 @@ void BMeshDecimate::bm_decim_build_edge_cost()
 	});
 
 	for (size_t i = 0; i < totedge; ++i){
-		_eheaphandles[i] = _eheap.push(EHeapNode(edges[i], ecost[i]));
+		_eheap.push(static_cast<int>(i), ecost[i]);
+		if (_stream) _stream->record(EdgeQueueStream::OP_PUSH, static_cast<int>(i), ecost[i]);
 	}
 }
 
@@ -252,9 +244,9 @@ bool BMeshDecimate::bm_decim_edge_collapse(BMEdge *e, Vector3f &optimize_co, boo
 		/* remove eheap */
 		for (i = 0; i < 2; i++) {
 			/* highly unlikely 'eheap_table[ke_other[i]]' would be NULL, but do for sanity sake */
-			if ((e_clear_other[i] != -1) && (_eheaphandles[e_clear_other[i]].node_)) {
-				_eheap.erase(_eheaphandles[e_clear_other[i]]);
-				_eheaphandles[e_clear_other[i]] = EHeapHanle();
+			if ((e_clear_other[i] != -1) && _eheap.contains(e_clear_other[i])) {
+				if (_stream) _stream->record(EdgeQueueStream::OP_ERASE, e_clear_other[i], 0.0f);
+				_eheap.erase(e_clear_other[i]);
 			}
 		}
 
@@ -429,7 +421,9 @@ bool BMeshDecimate::bm_edge_collapse(BMEdge *e_clear, BMVert *v_clear, int r_e_c
 * this way it may be calculated again if surrounding geometry changes */
 void BMeshDecimate::bm_decim_invalid_edge_cost_single(BMEdge *e)
 {
-	_eheaphandles[BM_elem_index_get(e)] = _eheap.push(EHeapNode(e, COST_INVALID));
+	/* the edge was popped right before its collapse failed, so it is not queued and a fresh entry is pushed */
+	if (_stream) _stream->record(EdgeQueueStream::OP_PUSH, BM_elem_index_get(e), COST_INVALID);
+	_eheap.push(BM_elem_index_get(e), COST_INVALID);
 }
 
 
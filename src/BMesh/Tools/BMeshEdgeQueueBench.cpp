@@ -0,0 +1,220 @@
+#include "BMesh/Tools/BMeshEdgeQueueBench.h"
+#include "BMesh/Tools/BMeshDecimate.h"
+#include "BaseLib/VDaryHeap.h"
+#include <boost/heap/fibonacci_heap.hpp>
+#include "tbb/tick_count.h"
+#include <algorithm>
+#include <cfloat>
+
+VM_BEGIN_NAMESPACE
+
+namespace
+{
+	struct HeapNode
+	{
+		HeapNode(int id_, float cost_) : id(id_), cost(cost_){}
+		bool operator<(HeapNode const &rhs) const { return cost > rhs.cost; }
+
+		int	  id;
+		float cost;
+	};
+
+	struct LazyNode
+	{
+		LazyNode(int id_, float cost_, unsigned stamp_) : id(id_), cost(cost_), stamp(stamp_){}
+		bool operator<(LazyNode const &rhs) const { return cost > rhs.cost; }
+
+		int		 id;
+		float	 cost;
+		unsigned stamp;
+	};
+
+	/*keeps popped ids alive so that the replay loops are not optimized away*/
+	volatile int g_bench_sink = 0;
+}
+
+void BMeshEdgeQueueBench::stream_record_decimate(BMesh *bm, float ratio, EdgeQueueStream &stream)
+{
+	BMesh dcbm(*bm);
+	stream.ops.clear();
+	stream.totid = dcbm.BM_mesh_edges_total();
+
+	BMeshDecimate op(&dcbm);
+	op.setRatio(ratio);
+	op.setRecorder(&stream);
+	op.run();
+}
+
+BMeshEdgeQueueBench::Result BMeshEdgeQueueBench::run(const EdgeQueueStream &stream, int repeat)
+{
+	Result result;
+	result.totop = stream.ops.size();
+	result.fibonacci = result.indexed = result.lazy_fibonacci = result.lazy_dary = DBL_MAX;
+
+	for (int i = 0; i < repeat; ++i){
+		result.fibonacci		= std::min(result.fibonacci,		run_fibonacci(stream));
+		result.indexed			= std::min(result.indexed,			run_indexed(stream));
+		result.lazy_fibonacci	= std::min(result.lazy_fibonacci,	run_lazy<boost::heap::fibonacci_heap<LazyNode>>(stream));
+		result.lazy_dary		= std::min(result.lazy_dary,		run_lazy<VDaryHeap<LazyNode>>(stream));
+	}
+	return result;
+}
+
+void BMeshEdgeQueueBench::report(const Result &result, FILE *file)
+{
+	fprintf(file, "edge queue benchmark: %u operations\n", (unsigned)result.totop);
+	fprintf(file, "  fibonacci heap, handles : %8.3f ms\n", result.fibonacci * 1000.0);
+	fprintf(file, "  4-ary indexed heap      : %8.3f ms\n", result.indexed * 1000.0);
+	fprintf(file, "  fibonacci heap, lazy    : %8.3f ms\n", result.lazy_fibonacci * 1000.0);
+	fprintf(file, "  4-ary heap, lazy        : %8.3f ms\n", result.lazy_dary * 1000.0);
+}
+
+bool BMeshEdgeQueueBench::replay_matches(const EdgeQueueStream &stream)
+{
+	typedef boost::heap::fibonacci_heap<HeapNode> Heap;
+	Heap heap;
+	std::vector<Heap::handle_type> handles(stream.totid);
+
+	for (auto it = stream.ops.begin(); it != stream.ops.end(); ++it){
+		switch (it->type){
+		case EdgeQueueStream::OP_PUSH:
+			/*a push over a queued edge left the old entry in the heap*/
+			handles[it->id] = heap.push(HeapNode(it->id, it->cost));
+			break;
+		case EdgeQueueStream::OP_UPDATE:
+			if (handles[it->id].node_){
+				heap.update(handles[it->id], HeapNode(it->id, it->cost));
+			}
+			else{
+				handles[it->id] = heap.push(HeapNode(it->id, it->cost));
+			}
+			break;
+		case EdgeQueueStream::OP_ERASE:
+			if (handles[it->id].node_){
+				heap.erase(handles[it->id]);
+				handles[it->id] = Heap::handle_type();
+			}
+			break;
+		case EdgeQueueStream::OP_POP:
+			if (heap.empty() || heap.top().id != it->id || heap.top().cost != it->cost)
+				return false;
+			handles[it->id] = Heap::handle_type();
+			heap.pop();
+			break;
+		}
+	}
+	return true;
+}
+
+double BMeshEdgeQueueBench::run_fibonacci(const EdgeQueueStream &stream)
+{
+	typedef boost::heap::fibonacci_heap<HeapNode> Heap;
+	Heap heap;
+	std::vector<Heap::handle_type> handles(stream.totid);
+	int sink = 0;
+
+	tbb::tick_count t0 = tbb::tick_count::now();
+	for (auto it = stream.ops.begin(); it != stream.ops.end(); ++it){
+		switch (it->type){
+		case EdgeQueueStream::OP_PUSH:
+			handles[it->id] = heap.push(HeapNode(it->id, it->cost));
+			break;
+		case EdgeQueueStream::OP_UPDATE:
+			if (handles[it->id].node_){
+				heap.update(handles[it->id], HeapNode(it->id, it->cost));
+			}
+			else{
+				handles[it->id] = heap.push(HeapNode(it->id, it->cost));
+			}
+			break;
+		case EdgeQueueStream::OP_ERASE:
+			if (handles[it->id].node_){
+				heap.erase(handles[it->id]);
+				handles[it->id] = Heap::handle_type();
+			}
+			break;
+		case EdgeQueueStream::OP_POP:
+			if (!heap.empty()){
+				sink += heap.top().id;
+				handles[heap.top().id] = Heap::handle_type();
+				heap.pop();
+			}
+			break;
+		}
+	}
+	tbb::tick_count t1 = tbb::tick_count::now();
+
+	g_bench_sink += sink;
+	return (t1 - t0).seconds();
+}
+
+double BMeshEdgeQueueBench::run_indexed(const EdgeQueueStream &stream)
+{
+	VIndexedHeap<4> heap;
+	heap.reset(stream.totid);
+	int sink = 0;
+
+	tbb::tick_count t0 = tbb::tick_count::now();
+	for (auto it = stream.ops.begin(); it != stream.ops.end(); ++it){
+		switch (it->type){
+		case EdgeQueueStream::OP_PUSH:
+		case EdgeQueueStream::OP_UPDATE:
+			heap.update(it->id, it->cost);
+			break;
+		case EdgeQueueStream::OP_ERASE:
+			heap.erase(it->id);
+			break;
+		case EdgeQueueStream::OP_POP:
+			if (!heap.empty()){
+				sink += heap.top_id();
+				heap.pop();
+			}
+			break;
+		}
+	}
+	tbb::tick_count t1 = tbb::tick_count::now();
+
+	g_bench_sink += sink;
+	return (t1 - t0).seconds();
+}
+
+/*an update pushes a new entry and bumps the stamp of the id. entries with an old stamp are skipped when popped*/
+template<class LazyHeap>
+double BMeshEdgeQueueBench::run_lazy(const EdgeQueueStream &stream)
+{
+	LazyHeap heap;
+	std::vector<unsigned> stamps(stream.totid, 0);
+	std::vector<bool> queued(stream.totid, false);
+	int sink = 0;
+
+	tbb::tick_count t0 = tbb::tick_count::now();
+	for (auto it = stream.ops.begin(); it != stream.ops.end(); ++it){
+		switch (it->type){
+		case EdgeQueueStream::OP_PUSH:
+		case EdgeQueueStream::OP_UPDATE:
+			heap.push(LazyNode(it->id, it->cost, ++stamps[it->id]));
+			queued[it->id] = true;
+			break;
+		case EdgeQueueStream::OP_ERASE:
+			++stamps[it->id];
+			queued[it->id] = false;
+			break;
+		case EdgeQueueStream::OP_POP:
+			while (!heap.empty()){
+				const LazyNode node = heap.top(); heap.pop();
+				if (queued[node.id] && node.stamp == stamps[node.id]){
+					sink += node.id;
+					queued[node.id] = false;
+					break;
+				}
+			}
+			break;
+		}
+	}
+	tbb::tick_count t1 = tbb::tick_count::now();
+
+	g_bench_sink += sink;
+	return (t1 - t0).seconds();
+}
+
+VM_END_NAMESPACE
@@ -0,0 +1,135 @@
+#include "BaseLib/VLzCodec.h"
+#include <cstring>
+
+namespace
+{
+	const int	 LZ_MIN_MATCH	= 4;
+	const int	 LZ_HASH_BITS	= 14;
+	const size_t LZ_MAX_OFFSET	= 0xffff;
+
+	inline uint32_t read32(const uint8_t *p)
+	{
+		uint32_t val;
+		memcpy(&val, p, sizeof(val));
+		return val;
+	}
+
+	inline uint32_t hash4(uint32_t seq)
+	{
+		return (seq * 2654435761u) >> (32 - LZ_HASH_BITS);
+	}
+
+	/*length above the 4 bits of the token, as a run of 255 bytes and a remainder*/
+	inline void length_put(std::vector<uint8_t> &out, size_t len)
+	{
+		while (len >= 255){
+			out.push_back(255);
+			len -= 255;
+		}
+		out.push_back(static_cast<uint8_t>(len));
+	}
+
+	inline bool length_get(const uint8_t *&in, const uint8_t *end, size_t &len)
+	{
+		uint8_t byte;
+		do{
+			if (in >= end) return false;
+			byte = *in++;
+			len += byte;
+		} while (byte == 255);
+		return true;
+	}
+
+	void sequence_put(std::vector<uint8_t> &out, const uint8_t *lit, size_t totlit, size_t offset, size_t matchlen)
+	{
+		const size_t mlen = matchlen ? matchlen - LZ_MIN_MATCH : 0;
+		uint8_t token = static_cast<uint8_t>((totlit < 15 ? totlit : 15) << 4);
+		token |= static_cast<uint8_t>(mlen < 15 ? mlen : 15);
+		out.push_back(token);
+		if (totlit >= 15) length_put(out, totlit - 15);
+		out.insert(out.end(), lit, lit + totlit);
+
+		if (matchlen){
+			out.push_back(static_cast<uint8_t>(offset));
+			out.push_back(static_cast<uint8_t>(offset >> 8));
+			if (mlen >= 15) length_put(out, mlen - 15);
+		}
+	}
+}
+
+void VLzCodec::compress(const uint8_t *src, size_t size, std::vector<uint8_t> &dst)
+{
+	dst.clear();
+	dst.reserve(size / 2 + 16);
+	varint_put(dst, size);
+
+	std::vector<uint32_t> table(size_t(1) << LZ_HASH_BITS, 0);
+	const uint8_t *anchor = src;
+	const uint8_t *end = src + size;
+	const uint8_t *ip = src;
+
+	if (size >= LZ_MIN_MATCH){
+		const uint8_t *limit = end - LZ_MIN_MATCH;
+		while (ip <= limit){
+			const uint32_t seq = read32(ip);
+			uint32_t &slot = table[hash4(seq)];
+			const uint8_t *ref = src + slot;
+			slot = static_cast<uint32_t>(ip - src);
+
+			if (ref < ip && static_cast<size_t>(ip - ref) <= LZ_MAX_OFFSET && read32(ref) == seq){
+				size_t len = LZ_MIN_MATCH;
+				while (ip + len < end && ip[len] == ref[len]) ++len;
+
+				sequence_put(dst, anchor, ip - anchor, ip - ref, len);
+				ip += len;
+				anchor = ip;
+			}
+			else{
+				++ip;
+			}
+		}
+	}
+
+	/*trailing literals, a sequence without match*/
+	sequence_put(dst, anchor, end - anchor, 0, 0);
+}
+
+bool VLzCodec::decompress(const uint8_t *src, size_t size, std::vector<uint8_t> &dst)
+{
+	const uint8_t *ip = src;
+	const uint8_t *end = src + size;
+	if (size == 0) return false;
+
+	const size_t rawsize = static_cast<size_t>(varint_get(ip));
+	dst.resize(rawsize);
+	uint8_t *op = dst.data();
+	uint8_t *oend = op + rawsize;
+
+	while (ip < end){
+		const uint8_t token = *ip++;
+
+		size_t totlit = token >> 4;
+		if (totlit == 15 && !length_get(ip, end, totlit)) return false;
+		if (totlit > static_cast<size_t>(end - ip) || totlit > static_cast<size_t>(oend - op)) return false;
+		memcpy(op, ip, totlit);
+		op += totlit; ip += totlit;
+
+		if (ip >= end) break; /*last sequence has no match*/
+
+		if (end - ip < 2) return false;
+		const size_t offset = ip[0] | (static_cast<size_t>(ip[1]) << 8);
+		ip += 2;
+
+		size_t matchlen = token & 15;
+		if (matchlen == 15 && !length_get(ip, end, matchlen)) return false;
+		matchlen += LZ_MIN_MATCH;
+
+		if (offset == 0 || offset > static_cast<size_t>(op - dst.data()) || matchlen > static_cast<size_t>(oend - op)) return false;
+		/*byte copy, the match may overlap the output*/
+		const uint8_t *ref = op - offset;
+		for (size_t i = 0; i < matchlen; ++i) op[i] = ref[i];
+		op += matchlen;
+	}
+
+	return op == oend;
+}
@@ -1,10 +1,15 @@
 #include "bm/bm_isct_isct_problem.h"
 #include "BaseLib/MathUtil.h"
+#include <tbb/parallel_for.h>
+#include <algorithm>
 
 namespace bm_isct
 {
 	using namespace VM;
 
+	/*faces per task of the edge-triangle search*/
+	static const size_t ISCT_FACE_CHUNK = 256;
+
 	IsctProblem::IsctProblem(VM::BMesh *mesh_, const std::vector<BMFace*> &isct_faces)
 		: mesh(mesh_),
 		faces(isct_faces)
@@ -373,30 +378,56 @@ namespace bm_isct
 	}
 
 
-	void IsctProblem::bvh_edge_tri(std::function<bool(Eptr e, Tptr t)> func)
+	/*two phases. bvh candidates and exact predicates are evaluated in parallel over fixed chunks of faces,
+	each chunk has its own hit buffer. chunks are concatenated in order, which is the order of a serial search,
+	so the glue points built from the hits do not depend on scheduling*/
+	bool IsctProblem::bvh_edge_tri(std::vector<std::pair<Eptr, Tptr>> &hits)
 	{
-		std::vector< GeomBlob<Eptr> > edge_geoms;
-		std::for_each(
-			edges.begin(), edges.end(), 
-			[&](Eptr e) 
+		std::vector< GeomBlob<Eptr> > edge_geoms(edges.size());
+		tbb::parallel_for(tbb::blocked_range<size_t>(0, edges.size()),
+			[&](const tbb::blocked_range<size_t> &range)
 		{
-			edge_geoms.push_back(edge_blob(e));
+			for (size_t i = range.begin(); i != range.end(); ++i){
+				edge_geoms[i] = edge_blob(edges[i]);
+			}
 		});
-		
+
 		AABVH<Eptr> edgeBVH(edge_geoms);
 
 		// use the acceleration structure
-		bool aborted = false;
-		std::for_each(faces.begin(), faces.end(),
-			[&](Tptr t) {
-			BBox3d bbox = buildBox(t);
-			if (!aborted) {
+		const size_t totchunk = (faces.size() + ISCT_FACE_CHUNK - 1) / ISCT_FACE_CHUNK;
+		std::vector<std::vector<std::pair<Eptr, Tptr>>> chunk_hits(totchunk);
+		tbb::parallel_for(static_cast<size_t>(0), totchunk, [&](size_t c)
+		{
+			std::vector<std::pair<Eptr, Tptr>> &local = chunk_hits[c];
+			const size_t end = std::min<size_t>(faces.size(), (c + 1) * ISCT_FACE_CHUNK);
+			for (size_t i = c * ISCT_FACE_CHUNK; i < end; ++i){
+				/*the search restarts anyway*/
+				if (Empty3d::degeneracy_count > 0)
+					return;
+
+				Tptr t = faces[i];
+				BBox3d bbox = buildBox(t);
 				edgeBVH.for_each_in_box(bbox, [&](Eptr e) {
-					if (!func(e, t))
-						aborted = true;
+					if (checkIsct(e, t))
+						local.push_back(std::make_pair(e, t));
 				});
 			}
 		});
+
+		if (Empty3d::degeneracy_count > 0)
+			return false;
+
+		size_t tothit = 0;
+		for (auto it = chunk_hits.begin(); it != chunk_hits.end(); ++it){
+			tothit += it->size();
+		}
+		hits.clear();
+		hits.reserve(tothit);
+		for (auto it = chunk_hits.begin(); it != chunk_hits.end(); ++it){
+			hits.insert(hits.end(), it->begin(), it->end());
+		}
+		return true;
 	}
 
 	// if we encounter ambiguous degeneracies, then this
@@ -405,29 +436,32 @@ namespace bm_isct
 	{
 		Empty3d::degeneracy_count = 0;
 		// Find all edge-triangle intersection points
-		//for_edge_tri([&](Eptr eisct, Tptr tisct)->bool{
-		bvh_edge_tri([&](Eptr eisct, Tptr tisct)->bool{
-			if (checkIsct(eisct, tisct)) {
-				
-				GluePt      glue = newGluePt();
-				glue->edge_tri_type = true;
-				glue->e = eisct;
-				glue->t[0] = tisct;
-				
-				// first add point and edges to the pierced triangle
-				IVptr iv = getTprob(tisct)->addInteriorEndpoint(this, eisct, glue);
-				
-				BMLoop *l_iter = eisct->l;
-				do {
-					Tptr tri = l_iter->f;
-					getTprob(tri)->addBoundaryEndpoint(this, tisct, eisct, iv);
-				} while ((l_iter = l_iter->radial_next) != eisct->l);
-			}
+		std::vector<std::pair<Eptr, Tptr>> hits;
+		if (!bvh_edge_tri(hits))
+			return false;   // restart / abort
+
+		/*triangle problems and glue points are built serially, in the order of the hits*/
+		for (auto it = hits.begin(); it != hits.end(); ++it) {
+			Eptr eisct = it->first;
+			Tptr tisct = it->second;
+
+			GluePt      glue = newGluePt();
+			glue->edge_tri_type = true;
+			glue->e = eisct;
+			glue->t[0] = tisct;
+
+			// first add point and edges to the pierced triangle
+			IVptr iv = getTprob(tisct)->addInteriorEndpoint(this, eisct, glue);
+
+			BMLoop *l_iter = eisct->l;
+			do {
+				Tptr tri = l_iter->f;
+				getTprob(tri)->addBoundaryEndpoint(this, tisct, eisct, iv);
+			} while ((l_iter = l_iter->radial_next) != eisct->l);
+
 			if (Empty3d::degeneracy_count > 0)
-				return false; // break
-			else
-				return true; // continue
-		});
+				break;
+		}
 		if (Empty3d::degeneracy_count > 0) {
 			return false;   // restart / abort
 		}
@@ -576,10 +610,23 @@ namespace bm_isct
 
 	void IsctProblem::resolveAllIntersections()
 	{
-		// solve a subdivision problem in each triangle
+		// solve a subdivision problem in each triangle.
+		// the triangulations only touch their own problem and run in parallel,
+		// the pool allocations follow serially in pool order, so the result does not depend on scheduling
+		std::vector<Tprob> probs;
 		tprobs.for_each([&](Tprob tprob) {
-			tprob->subdivide(this);
+			probs.push_back(tprob);
+		});
+		tbb::parallel_for(tbb::blocked_range<size_t>(0, probs.size()),
+			[&](const tbb::blocked_range<size_t> &range)
+		{
+			for (size_t i = range.begin(); i != range.end(); ++i){
+				probs[i]->triangulate();
+			}
 		});
+		for (auto it = probs.begin(); it != probs.end(); ++it){
+			(*it)->subdivide(this);
+		}
 
 		// now we have diced up triangles inside each triangle problem
 
@@ -164,80 +164,31 @@ namespace bm_isct
 		return true;
 	}
 
-	void TriangleProblem::subdivide(IsctProblem *iprob)
+	void TriangleProblem::triangulate()
 	{
-		// collect all the points, and create more points as necessary
-		ShortVec<GVptr, 7> points;
+		// collect all the points
+		points.resize(0);
 		for (uint k = 0; k<3; k++) {
 			points.push_back(overts[k]);
-			//std::cout << k << ": id " << overts[k]->concrete->ref << std::endl;
 		}
 		for (auto it = iverts.begin(); it != iverts.end(); ++it) {
-			auto &iv = *it;
-			//iprob->buildConcreteVert(iv);
-			points.push_back(iv);
-			/*std::cout << "  " << points.size() - 1
-			<< " (" << iv->glue_marker->edge_tri_type
-			<< ") ";
-			if(iv->glue_marker->edge_tri_type) {
-			Eptr e = iv->glue_marker->e;
-			Vec3d p0 = iprob->vPos(e->verts[0]);
-			Vec3d p1 = iprob->vPos(e->verts[1]);
-			std::cout << " "
-			<< e->verts[0]->ref << p0
-			<< "  " << e->verts[1]->ref << p1;
-
-			Tptr t = iv->glue_marker->t[0];
-			p0 = iprob->vPos(t->verts[0]);
-			p1 = iprob->vPos(t->verts[1]);
-			Vec3d p2 = iprob->vPos(t->verts[2]);
-			std::cout << "        "
-			<< t->verts[0]->ref << p0
-			<< "  " << t->verts[1]->ref << p1
-			<< "  " << t->verts[2]->ref << p2;
-			}
-			std::cout
-			<< std::endl;*/
+			points.push_back(*it);
 		}
 		for (uint i = 0; i<points.size(); i++)
 			points[i]->idx = i;
 
-		// split edges and marshall data
-		// for safety, we zero out references to pre-subdivided edges,
-		// which may have been destroyed
-		ShortVec<GEptr, 8> edges;
-		for (uint k = 0; k<3; k++) {
-			//std::cout << "oedge:  "
-			//          << oedges[k]->ends[0]->idx << "; "
-			//          << oedges[k]->ends[1]->idx << std::endl;
-			//for(IVptr iv : oedges[k]->interior)
-			//    std::cout << "  " << iv->idx << std::endl;
-			subdivideEdge(iprob, oedges[k], edges);
-			oedges[k] = nullptr;
-		}
-		//std::cout << "THE TRI: " << the_tri->verts[0]->ref
-		//          << "; " << the_tri->verts[1]->ref
-		//          << "; " << the_tri->verts[2]->ref
-		//          << std::endl;
-		//        for(IEptr &ie : iedges) {
-		for (auto it = iedges.begin(); it != iedges.end(); ++it) {
-			auto &ie = *it;
-			//std::cout << "iedge:  "
-			//          << ie->ends[0]->idx << "; "
-			//          << ie->ends[1]->idx << std::endl;
-			//std::cout << "other tri: " << ie->other_tri_key->verts[0]->ref
-			//          << "; " << ie->other_tri_key->verts[1]->ref
-			//          << "; " << ie->other_tri_key->verts[2]->ref
-			//          << std::endl;
-			//for(IVptr iv : ie->interior)
-			//    std::cout << "  " << iv->idx 
-			//              << " (" << iv->glue_marker->edge_tri_type
-			//              << ") " << std::endl;
-			subdivideEdge(iprob, ie, edges);
-			ie = nullptr;
+		// segments of the edges as they will be split by subdivide
+		std::vector<int> segments, segment_markers;
+		std::vector<GVptr> chain;
+		for (uint k = 0; k < 3 + iedges.size(); k++) {
+			GEptr ge = (k < 3) ? static_cast<GEptr>(oedges[k]) : static_cast<GEptr>(iedges[k - 3]);
+			edgeChain(ge, chain);
+			for (size_t i = 1; i < chain.size(); i++) {
+				segments.push_back(chain[i - 1]->idx);
+				segments.push_back(chain[i]->idx);
+				segment_markers.push_back((ge->boundary) ? 1 : 0);
+			}
 		}
-		for (uint i = 0; i<edges.size(); i++)
-			edges[i]->idx = i;
 
 		// find 2 dimensions to project onto
 		// get normal
@@ -251,29 +202,25 @@ namespace bm_isct
 		struct triangulateio in, out;
 
 		/* Define input points. */
+		std::vector<REAL> pointlist(points.size() * 2);
+		std::vector<int> pointmarkers(points.size());
 		in.numberofpoints = points.size();
 		in.numberofpointattributes = 0;
-		in.pointlist = new REAL[in.numberofpoints * 2];
+		in.pointlist = pointlist.data();
 		in.pointattributelist = nullptr;
-		in.pointmarkerlist = new int[in.numberofpoints];
+		in.pointmarkerlist = pointmarkers.data();
 		for (int k = 0; k<in.numberofpoints; k++) {
 			in.pointlist[k * 2 + 0] = points[k]->coord.v[dim0];
 			in.pointlist[k * 2 + 1] = points[k]->coord.v[dim1] * sign_flip;
 			in.pointmarkerlist[k] = (points[k]->boundary) ? 1 : 0;
-
 		}
 
 		/* Define the input segments */
-		in.numberofsegments = edges.size();
+		in.numberofsegments = static_cast<int>(segment_markers.size());
 		in.numberofholes = 0;// yes, zero
 		in.numberofregions = 0;// not using regions
-		in.segmentlist = new int[in.numberofsegments * 2];
-		in.segmentmarkerlist = new int[in.numberofsegments];
-		for (int k = 0; k<in.numberofsegments; k++) {
-			in.segmentlist[k * 2 + 0] = edges[k]->ends[0]->idx;
-			in.segmentlist[k * 2 + 1] = edges[k]->ends[1]->idx;
-			in.segmentmarkerlist[k] = (edges[k]->boundary) ? 1 : 0;
-		}
+		in.segmentlist = segments.data();
+		in.segmentmarkerlist = segment_markers.data();
 
 		// to be safe... declare 0 triangle attributes on input
 		in.numberoftriangles = 0;
@@ -284,18 +231,13 @@ namespace bm_isct
 		out.pointattributelist = nullptr; // not necessary if using -N or 0 attr
 		out.pointmarkerlist = nullptr;
 		out.trianglelist = nullptr; // not necessary if using -E
-		//out.triangleattributelist = null; // not necessary if using -E or 0 attr
-		//out.trianglearealist = // only needed with -r and -a
-		//out.neighborlist = null; // only neccesary if -n is used
 		out.segmentlist = nullptr; // NEED THIS; output segments go here
 		out.segmentmarkerlist = nullptr; // NEED THIS for OUTPUT SEGMENTS
-		//out.edgelist = null; // only necessary if -e is used
-		//out.edgemarkerlist = null; // only necessary if -e is used
 
 		// solve the triangulation problem
 		char *params = (char*)("pzQYY");
 		//char *debug_params = (char*)("pzYYVC");
-		triangulate(params, &in, &out, nullptr);
+		::triangulate(params, &in, &out, nullptr);
 
 		if (out.numberofpoints != in.numberofpoints) {
 			std::cout << "out.numberofpoints: "
@@ -326,62 +268,66 @@ namespace bm_isct
 		}
 		ENSURE(out.numberofpoints == in.numberofpoints);
 
-		//std::cout << "number of points in: " << in.numberofpoints
-		//          << std::endl;
-		//std::cout << "number of edges in: " << in.numberofsegments
-		//          << std::endl;
-		//std::cout << "number of triangles out: " << out.numberoftriangles
-		//          << std::endl;
-
-		gtris.resize(out.numberoftriangles);
-		for (int k = 0; k<out.numberoftriangles; k++) {
-			GVptr       gv0 = points[out.trianglelist[(k * 3) + 0]];
-			GVptr       gv1 = points[out.trianglelist[(k * 3) + 1]];
-			GVptr       gv2 = points[out.trianglelist[(k * 3) + 2]];
-			gtris[k] = iprob->newGenericTri(gv0, gv1, gv2);
-		}
-
+		tri_verts.assign(out.trianglelist, out.trianglelist + out.numberoftriangles * 3);
 
 		// clean up after triangulate...
-		// in free
-		free(in.pointlist);
-		free(in.pointmarkerlist);
-		free(in.segmentlist);
-		free(in.segmentmarkerlist);
-		// out free
 		free(out.pointlist);
-		//free(out.pointattributelist);
 		free(out.pointmarkerlist);
 		free(out.trianglelist);
-		//free(out.triangleattributelist);
-		//free(out.trianglearealist);
-		//free(out.neighborlist);
 		free(out.segmentlist);
 		free(out.segmentmarkerlist);
-		//free(out.edgelist);
-		//free(out.edgemarkerlist);
 	}
 
-	void TriangleProblem::subdivideEdge(IsctProblem *iprob, GEptr ge, ShortVec<GEptr, 8> &edges)
+	void TriangleProblem::subdivide(IsctProblem *iprob)
 	{
-		if (ge->interior.size() == 0) {
-			//if(typeid(ge) == typeid(IEptr)) { // generate new edge
-			//    iprob->buildConcreteEdge(ge);
-			//}
-			edges.push_back(ge);
+		// split edges in the order triangulate used.
+		// for safety, we zero out references to pre-subdivided edges,
+		// which may have been destroyed
+		for (uint k = 0; k<3; k++) {
+			subdivideEdge(iprob, oedges[k]);
+			oedges[k] = nullptr;
+		}
+		for (auto it = iedges.begin(); it != iedges.end(); ++it) {
+			auto &ie = *it;
+			subdivideEdge(iprob, ie);
+			ie = nullptr;
+		}
+
+		gtris.resize(static_cast<uint>(tri_verts.size() / 3));
+		for (uint k = 0; k<gtris.size(); k++) {
+			GVptr       gv0 = points[tri_verts[(k * 3) + 0]];
+			GVptr       gv1 = points[tri_verts[(k * 3) + 1]];
+			GVptr       gv2 = points[tri_verts[(k * 3) + 2]];
+			gtris[k] = iprob->newGenericTri(gv0, gv1, gv2);
 		}
-		else if (ge->interior.size() == 1) { // common case
-			SEptr se0 = iprob->newSplitEdge(ge->ends[0], ge->interior[0], ge->boundary);
-			SEptr se1 = iprob->newSplitEdge(ge->interior[0], ge->ends[1], ge->boundary);
-			//iprob->buildConcreteEdge(se0);
-			//iprob->buildConcreteEdge(se1);
-			edges.push_back(se0);
-			edges.push_back(se1);
-
-			// get rid of old edge
-			iprob->releaseEdge(ge);
+
+		// the pool does not run destructors on clear
+		std::vector<int>().swap(tri_verts);
+	}
+
+	void TriangleProblem::subdivideEdge(IsctProblem *iprob, GEptr ge)
+	{
+		if (ge->interior.size() == 0)
+			return;
+
+		// create the split edges between consecutive points
+		std::vector<GVptr> chain;
+		edgeChain(ge, chain);
+		for (size_t i = 1; i < chain.size(); i++) {
+			iprob->newSplitEdge(chain[i - 1], chain[i], ge->boundary);
 		}
-		else { // sorting is the uncommon case
+		// get rid of old edge
+		iprob->releaseEdge(ge);
+	}
+
+	void TriangleProblem::edgeChain(GEptr ge, std::vector<GVptr> &chain)
+	{
+		chain.clear();
+		chain.push_back(ge->ends[0]);
+		if (ge->interior.size() == 1) { // common case
+			chain.push_back(ge->interior[0]);
+		}
+		else if (ge->interior.size() > 1) { // sorting is the uncommon case
 			// determine the primary dimension and direction of the edge
 			Vec3d       dir = ge->ends[1]->coord - ge->ends[0]->coord;
 			uint        dim = (fabs(dir.x) > fabs(dir.y)) ?
@@ -391,7 +337,6 @@ namespace bm_isct
 
 			// pack the interior vertices into a vector for sorting
 			std::vector< std::pair<double, IVptr> > verts;
-			//            for(IVptr iv : ge->interior) {
 			for (auto it = ge->interior.begin(); it != ge->interior.end(); ++it) {
 				auto &iv = *it;
 
@@ -403,23 +348,10 @@ namespace bm_isct
 			}
 			// ... and sort the vector
 			std::sort(verts.begin(), verts.end());
-			// then, write the verts into a new container with the endpoints
-			std::vector<GVptr>  allv(verts.size() + 2);
-			allv[0] = ge->ends[0];
-			allv[allv.size() - 1] = ge->ends[1];
 			for (uint k = 0; k < verts.size(); k++)
-				allv[k + 1] = verts[k].second;
-
-			// now create and accumulate new split edges
-			for (uint i = 1; i < allv.size(); i++) {
-				SEptr   se = iprob->newSplitEdge(allv[i - 1],
-					allv[i],
-					ge->boundary);
-				edges.push_back(se);
-			}
-			// get rid of old edge
-			iprob->releaseEdge(ge);
+				chain.push_back(verts[k].second);
 		}
+		chain.push_back(ge->ends[1]);
 	}
 
-}
\ No newline at end of file
+}
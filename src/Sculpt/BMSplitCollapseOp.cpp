@@ -2,6 +2,7 @@
 #include "BaseLib/MathUtil.h"
 #include "BaseLib/MathGeom.h"
 #include "VBvh/BMBvhIsect.h"
+#include "sculpt/brush/BrushSelection.h"
 #include <boost/container/static_vector.hpp>
 #include <tbb/parallel_for.h>
 #include "sculpt/commonDefine.h"
@@ -9,6 +10,9 @@
 extern std::vector<Point3Dd> g_vscene_testSegments;
 extern std::vector<Point3Dd> g_vscene_testPoints;
 
+/*below this number of leaf nodes the queues are processed serially*/
+static const size_t PARALLEL_MIN_NODES = 4;
+
 BMSplitCollapseOp::BMSplitCollapseOp(StrokeData *sdata)
 	:
 	_sdata(sdata)
@@ -23,6 +27,8 @@ BMSplitCollapseOp::BMSplitCollapseOp(StrokeData *sdata)
 	_sqrMaxEdgeLen	= _maxEdgeLen * _maxEdgeLen;
 	_minEdgeLen		= _sdata->min_edge_len;
 	_sqrMinEdgeLen	= _minEdgeLen * _minEdgeLen;
+	_minEdgeRatio	= _maxEdgeLen > 0.0f ? _minEdgeLen / _maxEdgeLen : 0.4f;
+	_viewDetail		= _sdata->view_detail.enabled && _sdata->view_detail.pixel_scale > 0.0f;
 }
 
 BMSplitCollapseOp::~BMSplitCollapseOp()
@@ -30,7 +36,10 @@ BMSplitCollapseOp::~BMSplitCollapseOp()
 
 void BMSplitCollapseOp::run()
 {
-	isect_sphere_bm_bvh(_sdata->bvh, _center, _radius, _nodes);
+	_nodes = _sdata->selection->nodes_select(_bvh, _center, _radius);
+
+	if (_viewDetail)
+		leaf_edge_limits_compute();
 
 	collapse_short_edges();
 	
@@ -39,12 +48,27 @@ void BMSplitCollapseOp::run()
 
 void BMSplitCollapseOp::split_long_edges()
 {
-	EdgeQueue equeue;
-	long_edge_queue_create(equeue);
-	subdivide(equeue);
+	EdgeQueueContext eq;
+	if (parallel_enabled()){
+		/*split edges inside each leaf node concurrently, then the edges across leaf nodes*/
+		std::vector<EdgeQueueContext> leaf_eqs;
+		leaf_queues_create(leaf_eqs, &BMSplitCollapseOp::long_edge_queue_face_add);
+
+		_bm->BM_mesh_local_begin();
+		tbb::parallel_for((size_t)0, leaf_eqs.size(), [&](size_t i){
+			subdivide(leaf_eqs[i]);
+		});
+		_bm->BM_mesh_local_end();
+
+		leaf_queues_defer_merge(leaf_eqs, eq);
+	}
+	else{
+		long_edge_queue_create(eq);
+	}
+	subdivide(eq);
 }
 
-void BMSplitCollapseOp::long_edge_queue_create(EdgeQueue &equeue)
+void BMSplitCollapseOp::long_edge_queue_create(EdgeQueueContext &eq)
 {
 	mark_tri_node_in_sphere_begin();
 
@@ -56,7 +80,7 @@ void BMSplitCollapseOp::long_edge_queue_create(EdgeQueue &equeue)
 		for (size_t i = 0; i < totface; ++i){
 			BMFace *f = faces[i];
 			if (BM_elem_app_flag_test(f, F_MARK_DIRTY)){
-				long_edge_queue_face_add(equeue, f);
+				long_edge_queue_face_add(eq, f);
 			}
 		}
 	}
@@ -64,15 +88,20 @@ void BMSplitCollapseOp::long_edge_queue_create(EdgeQueue &equeue)
 	mark_tri_node_in_sphere_end();
 }
 
-void BMSplitCollapseOp::subdivide(EdgeQueue &equeue)
+void BMSplitCollapseOp::subdivide(EdgeQueueContext &eq)
 {
+	EdgeQueue &equeue = eq.queue;
 	while (!equeue.empty()){
 		EdgeNode se = equeue.top(); equeue.pop();
 		BMEdge *e;
 		if ((e = BM_edge_exists(se.v1, se.v2)) == nullptr) 
 			continue;
 		edge_queue_disable(e);
-		edge_split(equeue, e);
+		if (eq.node && !split_interior(eq, e)){
+			eq.deferred.push_back(se);
+			continue;
+		}
+		edge_split(eq, e);
 	}
 }
 
@@ -85,23 +114,24 @@ bool BMSplitCollapseOp::tri_in_sphere(BMFace *f)
 }
 
 /*face must be stay in sphere*/
-void BMSplitCollapseOp::long_edge_queue_face_add(EdgeQueue &equeue, BMFace *f)
+void BMSplitCollapseOp::long_edge_queue_face_add(EdgeQueueContext &eq, BMFace *f)
 {
 	/* Check each edge of the face */
 	BMLoop *l_first = BM_FACE_FIRST_LOOP(f);
 	BMLoop *l_iter = l_first;
 	do {
 		const float len_sq = BM_edge_calc_length_squared(l_iter->e);
-		if (len_sq > _sqrMaxEdgeLen) {
+		const float max_len = edge_max_len(l_iter->e);
+		if (len_sq > max_len * max_len) {
 			long_edge_queue_edge_add_recur(
-				equeue,
+				eq,
 				l_iter->radial_next, l_iter,
-				len_sq, _maxEdgeLen);
+				len_sq, max_len);
 		}
 	} while ((l_iter = l_iter->next) != l_first);
 }
 
-void BMSplitCollapseOp::long_edge_queue_edge_add_recur(EdgeQueue &queue, BMLoop *l_edge, BMLoop *l_end, float len_sq, float limit_len)
+void BMSplitCollapseOp::long_edge_queue_edge_add_recur(EdgeQueueContext &eq, BMLoop *l_edge, BMLoop *l_end, float len_sq, float limit_len)
 {
 	/* how much longer we need to be to consider for subdividing
 	* (avoids subdividing faces which are only *slightly* skinny) */
@@ -112,8 +142,14 @@ void BMSplitCollapseOp::long_edge_queue_edge_add_recur(EdgeQueue &queue, BMLoop
 
 	BLI_assert(len_sq > limit_len * limit_len);
 
+	/*don't walk into other leaf nodes*/
+	if (!edge_in_queue_node(eq, l_edge->e)){
+		eq.deferred.push_back(EdgeNode(l_edge->e, -len_sq));
+		return;
+	}
+
 	if (edge_queue_test(l_edge->e)){
-		queue.push(EdgeNode(l_edge->e, -len_sq));
+		eq.queue.push(EdgeNode(l_edge->e, -len_sq));
 		edge_queue_enable(l_edge->e);
 	}
 
@@ -131,7 +167,7 @@ void BMSplitCollapseOp::long_edge_queue_edge_add_recur(EdgeQueue &queue, BMLoop
 				float len_sq_other = BM_edge_calc_length_squared(l_adjacent[i]->e);
 				if (len_sq_other > std::max<float>(len_sq_cmp, limit_len_sq)) {
 					long_edge_queue_edge_add_recur(
-						queue, l_adjacent[i]->radial_next, l_adjacent[i],
+						eq, l_adjacent[i]->radial_next, l_adjacent[i],
 						len_sq_other, limit_len);
 				}
 			}
@@ -139,17 +175,21 @@ void BMSplitCollapseOp::long_edge_queue_edge_add_recur(EdgeQueue &queue, BMLoop
 	}
 }
 
-void BMSplitCollapseOp::long_edge_queue_edge_add(EdgeQueue &equeue, BMEdge *e)
+void BMSplitCollapseOp::long_edge_queue_edge_add(EdgeQueueContext &eq, BMEdge *e)
 {
 	if (edge_queue_test(e) == false){
 		const float len_sq = BM_edge_calc_length_squared(e);
-		if (len_sq > _sqrMaxEdgeLen) {
-			equeue.push(EdgeNode(e, -len_sq));
+		const float max_len = edge_max_len(e);
+		if (len_sq > max_len * max_len) {
+			if (edge_in_queue_node(eq, e))
+				eq.queue.push(EdgeNode(e, -len_sq));
+			else
+				eq.deferred.push_back(EdgeNode(e, -len_sq));
 		}
 	}
 }
 
-void BMSplitCollapseOp::edge_split(EdgeQueue &equeue, BMEdge *e)
+void BMSplitCollapseOp::edge_split(EdgeQueueContext &eq, BMEdge *e)
 {
 	Vector3f co_mid, no_mid;
 	boost::container::static_vector<BMLoop*, 2> edge_loops;
@@ -233,16 +273,16 @@ void BMSplitCollapseOp::edge_split(EdgeQueue &equeue, BMEdge *e)
 		v_tri[2] = v_opp;
 		bm_edges_from_verts(v_tri, e_tri);
 		f_new = bvh_bmesh_face_create(fnode, v_tri, e_tri);
-		if(tri_in_sphere(f_new)) long_edge_queue_face_add(equeue, f_new);
+		if(tri_in_sphere(f_new)) long_edge_queue_face_add(eq, f_new);
 
 		v_tri[0] = v_new;
 		v_tri[1] = v2;
 		/* v_tri[2] = v_opp; */ /* unchanged */
-		e_tri[0] = _bm->BM_edge_create(v_tri[0], v_tri[1], NULL, BM_CREATE_NO_DOUBLE);
+		e_tri[0] = bm_edge_create(v_tri[0], v_tri[1]);
 		e_tri[2] = e_tri[1];  /* switched */
-		e_tri[1] = _bm->BM_edge_create(v_tri[1], v_tri[2], NULL, BM_CREATE_NO_DOUBLE);
+		e_tri[1] = bm_edge_create(v_tri[1], v_tri[2]);
 		f_new = bvh_bmesh_face_create(fnode, v_tri, e_tri);
-		if(tri_in_sphere(f_new)) long_edge_queue_face_add(equeue, f_new);
+		if(tri_in_sphere(f_new)) long_edge_queue_face_add(eq, f_new);
 
 		/* Delete original */
 		bvh_bmesh_face_remove(fnode, f_adj);
@@ -252,12 +292,12 @@ void BMSplitCollapseOp::edge_split(EdgeQueue &equeue, BMEdge *e)
 			BMEdge *e2;
 
 			BM_ITER_ELEM(e2, &bm_iter, v_opp, BM_EDGES_OF_VERT) {
-				long_edge_queue_edge_add(equeue, e2);
+				long_edge_queue_edge_add(eq, e2);
 			}
 		}
 	}
 
-	_bm->BM_edge_kill(e);
+	bm_edge_kill(e);
 }
 
 
@@ -271,7 +311,7 @@ BMVert* BMSplitCollapseOp::bmesh_vert_create(const Vector3f &co, const Vector3f
 {
 	BMVert *v = _bm->BM_vert_create(co, nullptr, BM_CREATE_NOP);
 	_bm->BM_data_vert().CustomData_bmesh_set_default(&v->head.data);
-	
+
 	BM_elem_app_flag_enable(v, V_NEW_SUBDIVISION_VERTEX);
 	v->no = no;
 	return v;
@@ -318,6 +358,7 @@ void BMSplitCollapseOp::bvh_bmesh_vert_remove(BMVert *v)
 #endif
 
 	_bvh->leaf_node_vert_remove(node, v);
+
 	_bm->BM_vert_kill(v, true);
 }
 
@@ -328,7 +369,17 @@ void BMSplitCollapseOp::bm_edges_from_verts(BMVert *v_tri[3], BMEdge *e_tri[3])
 	e_tri[2] = _bm->BM_edge_create(v_tri[2], v_tri[0], NULL, BM_CREATE_NO_DOUBLE);
 }
 
-void BMSplitCollapseOp::short_edge_queue_create(EdgeQueue &equeue)
+BMEdge* BMSplitCollapseOp::bm_edge_create(BMVert *v1, BMVert *v2)
+{
+	return _bm->BM_edge_create(v1, v2, NULL, BM_CREATE_NO_DOUBLE);
+}
+
+void BMSplitCollapseOp::bm_edge_kill(BMEdge *e)
+{
+	_bm->BM_edge_kill(e);
+}
+
+void BMSplitCollapseOp::short_edge_queue_create(EdgeQueueContext &eq)
 {
 	mark_tri_node_in_sphere_begin();
 
@@ -340,7 +391,7 @@ void BMSplitCollapseOp::short_edge_queue_create(EdgeQueue &equeue)
 		for (size_t i = 0; i < totface; ++i){
 			BMFace *f = faces[i];
 			if (BM_elem_app_flag_test(f, F_MARK_DIRTY)){
-				short_edge_queue_face_add(equeue, f);
+				short_edge_queue_face_add(eq, f);
 			}
 		}
 	}
@@ -348,7 +399,7 @@ void BMSplitCollapseOp::short_edge_queue_create(EdgeQueue &equeue)
 	mark_tri_node_in_sphere_end();
 }
 
-void BMSplitCollapseOp::short_edge_queue_face_add(EdgeQueue &equeue, BMFace *f)
+void BMSplitCollapseOp::short_edge_queue_face_add(EdgeQueueContext &eq, BMFace *f)
 {
 #ifdef USE_EDGEQUEUE_FRONTFACE
 	if (eq_ctx->q->use_view_normal) {
@@ -361,21 +412,67 @@ void BMSplitCollapseOp::short_edge_queue_face_add(EdgeQueue &equeue, BMFace *f)
 	/* Check each edge of the face */
 	l_iter = l_first = BM_FACE_FIRST_LOOP(f);
 	do {
-		short_edge_queue_edge_add(equeue, l_iter->e);
+		short_edge_queue_edge_add(eq, l_iter->e);
 	} while ((l_iter = l_iter->next) != l_first);
 }
 
-void BMSplitCollapseOp::short_edge_queue_edge_add(EdgeQueue &equeue, BMEdge *e)
+void BMSplitCollapseOp::short_edge_queue_edge_add(EdgeQueueContext &eq, BMEdge *e)
 {
 	if (edge_queue_test(e)){
 		const float len_sq = BM_edge_calc_length_squared(e);
-		if (len_sq < _sqrMinEdgeLen) {
-			edge_queue_enable(e);
-			equeue.push(EdgeNode(e, len_sq));
+		const float min_len = edge_min_len(e);
+		if (len_sq < min_len * min_len) {
+			if (edge_in_queue_node(eq, e)){
+				edge_queue_enable(e);
+				eq.queue.push(EdgeNode(e, len_sq));
+			}
+			else{
+				eq.deferred.push_back(EdgeNode(e, len_sq));
+			}
 		}
 	}
 }
 
+void BMSplitCollapseOp::leaf_edge_limits_compute()
+{
+	_leafMaxEdgeLen.assign(_bvh->leafNodes().size(), 0.0f);
+	for (auto it = _nodes.begin(); it != _nodes.end(); ++it){
+		BMLeafNode *node = *it;
+		const Vector3f lower(node->lower().x, node->lower().y, node->lower().z);
+		const Vector3f upper(node->upper().x, node->upper().y, node->upper().z);
+		if (node->idx() >= 0 && node->idx() < static_cast<int>(_leafMaxEdgeLen.size()))
+			_leafMaxEdgeLen[node->idx()] = view_edge_len(0.5f * (lower + upper));
+	}
+}
+
+float BMSplitCollapseOp::view_edge_len(const Vector3f &co) const
+{
+	const ViewDetail &view = _sdata->view_detail;
+	return std::max<float>(view.world_per_pixel(co) * view.pixels_per_edge, _sdata->edge_len_unit_threshold);
+}
+
+/*an edge across leaf nodes takes the finest limit. leaf nodes outside the selection are measured at the edge*/
+float BMSplitCollapseOp::edge_max_len(BMEdge *e)
+{
+	if (!_viewDetail)
+		return _maxEdgeLen;
+
+	float max_len = FLT_MAX;
+	BMLoop *l_iter = e->l;
+	if (l_iter){
+		do {
+			BMLeafNode *node = _bvh->elem_leaf_node_get(l_iter->f);
+			const int idx = node ? node->idx() : -1;
+			if (idx >= 0 && idx < static_cast<int>(_leafMaxEdgeLen.size()) && _leafMaxEdgeLen[idx] > 0.0f)
+				max_len = std::min<float>(max_len, _leafMaxEdgeLen[idx]);
+		} while ((l_iter = l_iter->radial_next) != e->l);
+	}
+
+	if (max_len == FLT_MAX)
+		max_len = view_edge_len(0.5f * (e->v1->co + e->v2->co));
+	return max_len;
+}
+
 void BMSplitCollapseOp::mark_tri_node_in_sphere_begin()
 {
 	auto mark_in_sphere_face_node = [&](BMLeafNode *node)
@@ -419,13 +516,13 @@ void BMSplitCollapseOp::mark_tri_node_in_sphere_end()
 	}
 }
 
-bool BMSplitCollapseOp::collapse_equeue(EdgeQueue &equeue
+bool BMSplitCollapseOp::collapse_equeue(EdgeQueueContext &eq
 #ifdef OPTIMIZE_COLLAPSE
 	, std::vector<Qdr::Quadric> &vquadric
 #endif
 	)
 {
-	const float min_len_squared = _sqrMinEdgeLen;
+	EdgeQueue &equeue = eq.queue;
 	bool any_collapsed = false;
 	Qdr::Quadric quadric;
 	Vector3f opt_co;
@@ -450,8 +547,14 @@ bool BMSplitCollapseOp::collapse_equeue(EdgeQueue &equeue
 
 		edge_queue_disable(e);
 
-		if ((v1->co - v2->co).squaredNorm() >= min_len_squared)
+		const float min_len = edge_min_len(e);
+		if ((v1->co - v2->co).squaredNorm() >= min_len * min_len)
+			continue;
+
+		if (eq.node && !collapse_interior(eq, e)){
+			eq.deferred.push_back(enode);
 			continue;
+		}
 
 		/* Check that the edge's vertices are still in the PBVH. It's
 		* possible that an edge collapse has deleted adjacent faces
@@ -504,7 +607,7 @@ void BMSplitCollapseOp::collapse_edge(BMEdge *e, FaceSmallBuffer &deleted_faces,
 
 	/* Kill the edge */
 	BLI_assert(BM_edge_is_wire(e));
-	_bm->BM_edge_kill(e);
+	bm_edge_kill(e);
 
 	/* For all remaining faces of v_del, create a new face that is the
 	* same except it uses v_conn instead of v_del */
@@ -565,7 +668,7 @@ void BMSplitCollapseOp::collapse_edge(BMEdge *e, FaceSmallBuffer &deleted_faces,
 		* face, if so delete them */
 		for (int j = 0; j < 3; j++) {
 			if (BM_edge_is_wire(e_tri[j]))
-				_bm->BM_edge_kill(e_tri[j]);
+				bm_edge_kill(e_tri[j]);
 		}
 
 		/* Check if any of the face's vertices are now unused, if so
@@ -581,6 +684,7 @@ void BMSplitCollapseOp::collapse_edge(BMEdge *e, FaceSmallBuffer &deleted_faces,
 	/* Move v_conn to the midpoint of v_conn and v_del (if v_conn still exists, it
 	* may have been deleted above) */
 	if (!BM_elem_flag_test(v_conn, BM_ELEM_REMOVED)){
+		_bvh->vert_org_save(v_conn);
 		v_conn->co = optimize_co;
 		v_conn->no = (v_conn->no + v_del->no).normalized();
 	}
@@ -596,17 +700,143 @@ void BMSplitCollapseOp::collapse_edge(BMEdge *e, FaceSmallBuffer &deleted_faces,
 
 void BMSplitCollapseOp::collapse_short_edges()
 {
-	EdgeQueue equeue;
+	EdgeQueueContext eq;
 	std::vector<Qdr::Quadric> vquadric;
-	short_edge_queue_create(equeue);
+#ifndef OPTIMIZE_COLLAPSE
+	if (parallel_enabled()){
+		/*collapse edges inside each leaf node concurrently, then the edges across leaf nodes*/
+		std::vector<EdgeQueueContext> leaf_eqs;
+		leaf_queues_create(leaf_eqs, &BMSplitCollapseOp::short_edge_queue_face_add);
+
+		_bm->BM_mesh_local_begin();
+		tbb::parallel_for((size_t)0, leaf_eqs.size(), [&](size_t i){
+			collapse_equeue(leaf_eqs[i]);
+		});
+		_bm->BM_mesh_local_end();
+
+		leaf_queues_defer_merge(leaf_eqs, eq);
+		collapse_equeue(eq);
+		return;
+	}
+#endif
+	short_edge_queue_create(eq);
 #ifdef OPTIMIZE_COLLAPSE
-	vert_quadric_compute(equeue, vquadric);
-	collapse_equeue(equeue, vquadric);
+	vert_quadric_compute(eq.queue, vquadric);
+	collapse_equeue(eq, vquadric);
 #else
-	collapse_equeue(equeue);
+	collapse_equeue(eq);
 #endif
 }
 
+bool BMSplitCollapseOp::parallel_enabled() const
+{
+	return _nodes.size() >= PARALLEL_MIN_NODES;
+}
+
+/*one queue per leaf node. edges whose faces are all in the leaf node are queued, the others are deferred*/
+void BMSplitCollapseOp::leaf_queues_create(std::vector<EdgeQueueContext> &eqs, FaceQueueAdd face_add)
+{
+	mark_tri_node_in_sphere_begin();
+
+	eqs.resize(_nodes.size());
+	tbb::parallel_for((size_t)0, _nodes.size(), [&](size_t i){
+		EdgeQueueContext &eq = eqs[i];
+		eq.node = _nodes[i];
+
+		const BMFaceVector &faces = eq.node->faces();
+		const size_t totface = faces.size();
+		for (size_t j = 0; j < totface; ++j){
+			BMFace *f = faces[j];
+			if (BM_elem_app_flag_test(f, F_MARK_DIRTY)){
+				(this->*face_add)(eq, f);
+			}
+		}
+	});
+
+	mark_tri_node_in_sphere_end();
+}
+
+/*queue deferred edges of leaf nodes in a fixed order, so the result does not depend on scheduling*/
+void BMSplitCollapseOp::leaf_queues_defer_merge(std::vector<EdgeQueueContext> &eqs, EdgeQueueContext &eq)
+{
+	for (auto it = eqs.begin(); it != eqs.end(); ++it){
+		const std::vector<EdgeNode> &deferred = it->deferred;
+		for (auto dit = deferred.begin(); dit != deferred.end(); ++dit){
+			if (BM_elem_app_flag_test(dit->v1, BM_ELEM_REMOVED) ||
+				BM_elem_app_flag_test(dit->v2, BM_ELEM_REMOVED))
+				continue;
+
+			BMEdge *e = BM_edge_exists(dit->v1, dit->v2);
+			if (e && edge_queue_test(e)){
+				edge_queue_enable(e);
+				eq.queue.push(EdgeNode(e, dit->cost));
+			}
+		}
+	}
+}
+
+bool BMSplitCollapseOp::edge_in_queue_node(const EdgeQueueContext &eq, BMEdge *e)
+{
+	if (!eq.node)
+		return true;
+
+	BMLoop *l_iter = e->l;
+	if (!l_iter)
+		return false;
+	do {
+		if (_bvh->elem_leaf_node_get(l_iter->f) != eq.node)
+			return false;
+	} while ((l_iter = l_iter->radial_next) != e->l);
+	return true;
+}
+
+/*every face around v is in node. other leaf nodes never touch the disk cycle of such a vertex*/
+bool BMSplitCollapseOp::vert_interior(BMVert *v, BMLeafNode *node, bool owned)
+{
+	if (owned && _bvh->elem_leaf_node_get(v) != node)
+		return false;
+
+	BMIter iter;
+	BMFace *f;
+	BM_ITER_ELEM(f, &iter, v, BM_FACES_OF_VERT){
+		if (_bvh->elem_leaf_node_get(f) != node)
+			return false;
+	}
+	return true;
+}
+
+/*splitting e touches its vertices and the opposite vertices of its faces*/
+bool BMSplitCollapseOp::split_interior(const EdgeQueueContext &eq, BMEdge *e)
+{
+	if (!vert_interior(e->v1, eq.node, false) || !vert_interior(e->v2, eq.node, false))
+		return false;
+
+	BMLoop *l_iter = e->l;
+	do {
+		if (!vert_interior(l_iter->prev->v, eq.node, false))
+			return false;
+	} while ((l_iter = l_iter->radial_next) != e->l);
+	return true;
+}
+
+/*collapsing e re-creates the faces around both vertices and may remove any vertex of their ring*/
+bool BMSplitCollapseOp::collapse_interior(const EdgeQueueContext &eq, BMEdge *e)
+{
+	BMVert *verts[2] = { e->v1, e->v2 };
+	for (int i = 0; i < 2; ++i){
+		if (!vert_interior(verts[i], eq.node, true))
+			return false;
+
+		BMIter iter;
+		BMEdge *e_ring;
+		BM_ITER_ELEM(e_ring, &iter, verts[i], BM_EDGES_OF_VERT){
+			if (!vert_interior(BM_edge_other_vert(e_ring, verts[i]), eq.node, true))
+				return false;
+		}
+	}
+	return true;
+}
+
 #ifdef OPTIMIZE_COLLAPSE
 void BMSplitCollapseOp::vert_quadric_compute(EdgeQueue &equeue, std::vector<Qdr::Quadric> &vquadric)
 {
@@ -10,6 +10,7 @@ BezierCurve::BezierCurve(VbsDef::CURVE  type /*= CURVE_PRESET_ROOT*/)
 {
     setControlPoints(_type);
     makeTable(_resolution);
+    makeFalloff();
 }
 
 BezierCurve::~BezierCurve()
@@ -25,6 +26,7 @@ void BezierCurve::reset(VbsDef::CURVE type)
 {
     setControlPoints(type);
     makeTable(_resolution);
+    makeFalloff();
 }
 
 bool BezierCurve::setControlPoints(int type)
@@ -173,6 +175,15 @@ double BezierCurve::evaluate(const double par)
     return (fi * _table[i].y + (1.0 - fi) *_table[i + 1].y);
 }
 
+/*bake evaluate() into a uniform float table so brushes can look up falloff without branching*/
+void BezierCurve::makeFalloff()
+{
+    for (int i = 0; i <= FALLOFF_RESOLUTION; i++)
+    {
+        _falloff[i] = (float)evaluate((double)i / (double)FALLOFF_RESOLUTION);
+    }
+}
+
 void BezierCurve::render()
 {
 #if 0
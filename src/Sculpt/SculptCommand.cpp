@@ -1,4 +1,5 @@
 #include "sculpt/SculptCommand.h"
+#include "sculpt/VSculptUndoHistory.h"
 #include "tbb/mutex.h"
 #include "tbb/parallel_for.h"
 #include <algorithm>
@@ -20,18 +21,23 @@ VSculptCommand::VSculptCommand(VScene *scene, VMeshObject *obj)
 VSculptCommand::~VSculptCommand()
 {
 	/*logger::undo must be called earlier*/
-	if(_logger) _logger->undo_apply();
+	if (_logger){
+		VSculptUndoHistory::instance()->remove(_logger.get());
+		_logger->undo_apply();
+	}
 }
 
 void VSculptCommand::log_data(const std::vector<BMLeafNode*>& nodes)
 {
 	_logger = std::shared_ptr<VSculptLogger>(new VSculptLogger(_scene, _obj));
 	_logger->log_nodes(nodes);
+	VSculptUndoHistory::instance()->push(_logger);
 }
 
 void VSculptCommand::log_data(VSculptLogger &&logger)
 {
 	_logger = std::shared_ptr<VSculptLogger>(new VSculptLogger(std::move(logger)));
+	VSculptUndoHistory::instance()->push(_logger);
 }
 
 #if 0
@@ -45,6 +51,7 @@ void VSculptCommand::undoHook()
 {
 	if (_scene->objectExist(_obj)){
 		_logger->undo();
+		VSculptUndoHistory::instance()->touch(_logger);
 
 		_obj->getBmesh()->BM_mesh_normals_update_parallel();
 		_obj->rebuildBVH();
@@ -55,6 +62,7 @@ void VSculptCommand::redoHook()
 {
 	if (_scene->objectExist(_obj)){
 		_logger->redo();
+		VSculptUndoHistory::instance()->touch(_logger);
 
 		_obj->getBmesh()->BM_mesh_normals_update_parallel();
 		_obj->rebuildBVH();
@@ -0,0 +1,46 @@
+#include "sculpt/SculptRenderSync.h"
+#include <chrono>
+
+SculptRenderSync* SculptRenderSync::instance()
+{
+	static SculptRenderSync sync;
+	return &sync;
+}
+
+SculptRenderSync::SculptRenderSync()
+	:
+	_missed(false),
+	_bypass(false)
+{}
+
+void SculptRenderSync::missed()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_missed = true;
+}
+
+void SculptRenderSync::synced()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_missed = false;
+	}
+	_cond.notify_all();
+}
+
+/*bounded, a hidden window does not render*/
+void SculptRenderSync::wait()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	_cond.wait_for(lock, std::chrono::milliseconds(50), [this](){ return !_missed || _bypass; });
+}
+
+void SculptRenderSync::bypass(bool on)
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_bypass = on;
+		_missed = false;
+	}
+	_cond.notify_all();
+}
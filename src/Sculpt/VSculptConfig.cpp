@@ -41,6 +41,21 @@ void VSculptConfig::setBrushDetailsize(float detail)
 	_brush_confs[_brush].detail_size = detail;
 }
 
+void VSculptConfig::setBrushPixelsPerEdge(float pixels)
+{
+	_brush_confs[_brush].pixels_per_edge = pixels;
+}
+
+void VSculptConfig::setBrushViewDetail(bool view)
+{
+	_brush_confs[_brush].view_detail = view;
+}
+
+void VSculptConfig::setBrushSmoothIterations(int iterations)
+{
+	_brush_confs[_brush].smooth_iterations = std::max<int>(iterations, 1);
+}
+
 VbsDef::BRUSH VSculptConfig::brush()
 {
 	return _brush;
@@ -75,3 +90,18 @@ float VSculptConfig::brushDetailsize()
 {
 	return _brush_confs[_brush].detail_size;
 }
+
+float VSculptConfig::brushPixelsPerEdge()
+{
+	return _brush_confs[_brush].pixels_per_edge;
+}
+
+bool VSculptConfig::brushViewDetail()
+{
+	return _brush_confs[_brush].view_detail;
+}
+
+int VSculptConfig::brushSmoothIterations()
+{
+	return _brush_confs[_brush].smooth_iterations;
+}
@@ -0,0 +1,239 @@
+#include "sculpt/VSculptMultires.h"
+#include <algorithm>
+
+namespace
+{
+	void base_collect(BMesh *bm, std::vector<Vector3f> &corners)
+	{
+		corners.clear();
+
+		BMIter iter;
+		BMFace *f;
+		BM_ITER_MESH(f, &iter, bm, BM_FACES_OF_MESH){
+			/*fan of an n-gon*/
+			BMLoop *l_first = BM_FACE_FIRST_LOOP(f);
+			BMLoop *l_iter = l_first->next;
+			while (l_iter->next != l_first){
+				corners.push_back(l_first->v->co);
+				corners.push_back(l_iter->v->co);
+				corners.push_back(l_iter->next->v->co);
+				l_iter = l_iter->next;
+			}
+		}
+	}
+}
+
+VSculptMultires::VSculptMultires(BMesh *bm, int totlevel)
+	:
+	_bm(bm),
+	_active(0)
+{
+	base_collect(_bm, _base);
+
+	_levels.resize(std::max<int>(totlevel, 1));
+	for (int l = 0; l < this->totlevel(); ++l){
+		level_alloc(l);
+	}
+
+	const size_t totf = totbase();
+	_bounds.resize(totf);
+	_stale.assign(totf, 0);
+	_unrestricted.assign(totf, -1);
+	_marked.resize(totf);
+	for (size_t f = 0; f < totf; ++f){
+		_marked[f] = f;
+	}
+	set_active_level(0);
+}
+
+VSculptMultires::~VSculptMultires()
+{}
+
+void VSculptMultires::level_alloc(int l)
+{
+	Level &lv = _levels[l];
+	lv.res = 1 << l;
+	lv.totgridvert = static_cast<size_t>((lv.res + 1) * (lv.res + 2) / 2);
+
+	const size_t total = totbase() * lv.totgridvert;
+	lv.dx.assign(total, 0.0f); lv.dy.assign(total, 0.0f); lv.dz.assign(total, 0.0f);
+	lv.px.assign(total, 0.0f); lv.py.assign(total, 0.0f); lv.pz.assign(total, 0.0f);
+}
+
+void VSculptMultires::base_update()
+{
+	const size_t totf = totbase();
+	base_collect(_bm, _base);
+
+	if (totbase() != totf){
+		/*topology of the base changed, displacements do not map anymore*/
+		for (int l = 0; l < totlevel(); ++l){
+			level_alloc(l);
+		}
+		_bounds.resize(totbase());
+		_unrestricted.assign(totbase(), -1);
+	}
+
+	_stale.assign(totbase(), 0);
+	_marked.resize(totbase());
+	for (size_t f = 0; f < totbase(); ++f){
+		_marked[f] = f;
+	}
+	set_active_level(_active);
+}
+
+/*pending edits are finished before the level changes, so edits are only ever pending on the active level*/
+void VSculptMultires::set_active_level(int level)
+{
+	_active = std::min<int>(std::max<int>(level, 0), totlevel() - 1);
+
+	propagate(0);
+	propagate(totlevel() - 1);
+
+	tbb::parallel_for(static_cast<size_t>(0), totbase(), [&](size_t f)
+	{
+		bounds_refresh(f);
+	});
+}
+
+const VSculptMultires::Level& VSculptMultires::level(int l)
+{
+	if (l != _active){
+		propagate(l);
+	}
+	return _levels[l];
+}
+
+/*makes level l current on every marked base triangle*/
+void VSculptMultires::propagate(int l)
+{
+	if (_marked.empty())
+		return;
+
+	std::sort(_marked.begin(), _marked.end());
+	_marked.erase(std::unique(_marked.begin(), _marked.end()), _marked.end());
+
+	tbb::parallel_for(static_cast<size_t>(0), _marked.size(), [&](size_t n)
+	{
+		const size_t f = _marked[n];
+		if (_unrestricted[f] > l){
+			restrict_up(f, _unrestricted[f]);
+			_unrestricted[f] = -1;
+		}
+		if (_stale[f] <= l){
+			positions_refresh(f, _stale[f], l);
+			_stale[f] = l + 1 < totlevel() ? l + 1 : CLEAN;
+		}
+	});
+
+	_marked.erase(std::remove_if(_marked.begin(), _marked.end(),
+		[this](size_t f){ return _stale[f] == CLEAN && _unrestricted[f] <= 0; }), _marked.end());
+}
+
+/*midpoint interpolation of the coarser level. a fine vertex is a coarse vertex or the midpoint of a coarse edge*/
+Vector3f VSculptMultires::interp(int l, size_t f, int i, int j) const
+{
+	if (l == 0){
+		const Vector3f *c = &_base[3 * f];
+		return i ? c[1] : (j ? c[2] : c[0]);
+	}
+
+	const Level &p = _levels[l - 1];
+	const size_t off = f * p.totgridvert;
+	int i0, j0, i1, j1;
+	if (!(i & 1) && !(j & 1)){
+		i0 = i1 = i / 2; j0 = j1 = j / 2;
+	}
+	else if (i & 1 && !(j & 1)){
+		i0 = (i - 1) / 2; i1 = (i + 1) / 2; j0 = j1 = j / 2;
+	}
+	else if (!(i & 1) && j & 1){
+		i0 = i1 = i / 2; j0 = (j - 1) / 2; j1 = (j + 1) / 2;
+	}
+	else{
+		i0 = (i - 1) / 2; j0 = (j + 1) / 2; i1 = (i + 1) / 2; j1 = (j - 1) / 2;
+	}
+
+	const size_t k0 = off + grid_index(p.res, i0, j0);
+	const size_t k1 = off + grid_index(p.res, i1, j1);
+	return 0.5f * Vector3f(p.px[k0] + p.px[k1], p.py[k0] + p.py[k1], p.pz[k0] + p.pz[k1]);
+}
+
+void VSculptMultires::positions_refresh(size_t f, int from, int to)
+{
+	for (int l = from; l <= to; ++l){
+		Level &lv = _levels[l];
+		const size_t off = f * lv.totgridvert;
+		for (int i = 0; i <= lv.res; ++i){
+			for (int j = 0; j <= lv.res - i; ++j){
+				const size_t k = off + grid_index(lv.res, i, j);
+				const Vector3f co = interp(l, f, i, j);
+				lv.px[k] = co[0] + lv.dx[k];
+				lv.py[k] = co[1] + lv.dy[k];
+				lv.pz[k] = co[2] + lv.dz[k];
+			}
+		}
+	}
+}
+
+/*coarse vertices take the position of the fine vertex they coincide with.
+the fine displacements are then taken against the new interpolation, so level from keeps its shape*/
+void VSculptMultires::restrict_up(size_t f, int from)
+{
+	for (int l = from - 1; l >= 0; --l){
+		Level &lv = _levels[l];
+		const Level &fine = _levels[l + 1];
+		const size_t off = f * lv.totgridvert;
+		const size_t foff = f * fine.totgridvert;
+		for (int i = 0; i <= lv.res; ++i){
+			for (int j = 0; j <= lv.res - i; ++j){
+				const size_t k = off + grid_index(lv.res, i, j);
+				const size_t fk = foff + grid_index(fine.res, 2 * i, 2 * j);
+				const Vector3f co = interp(l, f, i, j);
+				lv.px[k] = fine.px[fk]; lv.py[k] = fine.py[fk]; lv.pz[k] = fine.pz[fk];
+				lv.dx[k] = lv.px[k] - co[0]; lv.dy[k] = lv.py[k] - co[1]; lv.dz[k] = lv.pz[k] - co[2];
+			}
+		}
+
+		Level &flv = _levels[l + 1];
+		for (int i = 0; i <= flv.res; ++i){
+			for (int j = 0; j <= flv.res - i; ++j){
+				const size_t k = foff + grid_index(flv.res, i, j);
+				const Vector3f co = interp(l + 1, f, i, j);
+				flv.dx[k] = flv.px[k] - co[0]; flv.dy[k] = flv.py[k] - co[1]; flv.dz[k] = flv.pz[k] - co[2];
+			}
+		}
+	}
+}
+
+void VSculptMultires::bounds_refresh(size_t f)
+{
+	const Level &lv = _levels[_active];
+	const size_t off = f * lv.totgridvert;
+	Eigen::AlignedBox3f &bb = _bounds[f];
+	bb.setEmpty();
+	for (size_t k = off; k < off + lv.totgridvert; ++k){
+		bb.extend(Vector3f(lv.px[k], lv.py[k], lv.pz[k]));
+	}
+}
+
+size_t VSculptMultires::base_select(const Vector3f &center, float radius, std::vector<size_t> &faces)
+{
+	const Vector3f ext(radius, radius, radius);
+	const Eigen::AlignedBox3f sphere_bb(center - ext, center + ext);
+	for (size_t f = 0; f < _bounds.size(); ++f){
+		if (_bounds[f].intersects(sphere_bb))
+			faces.push_back(f);
+	}
+	return faces.size();
+}
+
+size_t VSculptMultires::memory_size() const
+{
+	size_t total = _base.capacity() * sizeof(Vector3f) + _bounds.capacity() * sizeof(Eigen::AlignedBox3f);
+	for (auto it = _levels.begin(); it != _levels.end(); ++it){
+		total += (it->dx.capacity() + it->dy.capacity() + it->dz.capacity() +
+			it->px.capacity() + it->py.capacity() + it->pz.capacity()) * sizeof(float);
+	}
+	return total;
+}
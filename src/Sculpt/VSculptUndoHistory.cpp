@@ -0,0 +1,161 @@
+#include "sculpt/VSculptUndoHistory.h"
+#include <algorithm>
+
+VSculptUndoHistory* VSculptUndoHistory::instance()
+{
+	static VSculptUndoHistory history;
+	return &history;
+}
+
+VSculptUndoHistory::VSculptUndoHistory()
+	:
+	_budget(size_t(512) << 20),
+	_resident(size_t(128) << 20),
+	_journal_path(VSculptUndoJournal::default_path()),
+	_journal_failed(false)
+{}
+
+VSculptUndoHistory::~VSculptUndoHistory()
+{
+	_packer.wait();
+	_journal.close();
+}
+
+void VSculptUndoHistory::push(const std::shared_ptr<VSculptLogger> &logger)
+{
+	released_free();
+	{
+		tbb::mutex::scoped_lock lock(_mutex);
+		_loggers.push_back(logger);
+	}
+	pack_async(logger);
+}
+
+void VSculptUndoHistory::remove(VSculptLogger *logger)
+{
+	tbb::mutex::scoped_lock lock(_mutex);
+	auto it = std::find_if(_loggers.begin(), _loggers.end(),
+		[logger](const std::shared_ptr<VSculptLogger> &l){ return l.get() == logger; });
+	if (it != _loggers.end())
+		_loggers.erase(it);
+}
+
+void VSculptUndoHistory::touch(const std::shared_ptr<VSculptLogger> &logger)
+{
+	pack_async(logger);
+}
+
+void VSculptUndoHistory::set_memory_budget(size_t bytes)
+{
+	{
+		tbb::mutex::scoped_lock lock(_mutex);
+		_budget = bytes;
+	}
+	budget_enforce();
+	released_free();
+}
+
+void VSculptUndoHistory::set_resident_threshold(size_t bytes)
+{
+	{
+		tbb::mutex::scoped_lock lock(_mutex);
+		_resident = bytes;
+	}
+	budget_enforce();
+}
+
+void VSculptUndoHistory::set_journal_path(const std::string &path)
+{
+	tbb::mutex::scoped_lock lock(_mutex);
+	if (!_journal.is_open()){
+		_journal_path = path;
+		_journal_failed = false;
+	}
+}
+
+size_t VSculptUndoHistory::memory_usage()
+{
+	tbb::mutex::scoped_lock lock(_mutex);
+	size_t total = 0;
+	for (auto it = _loggers.begin(); it != _loggers.end(); ++it){
+		total += (*it)->memory_size();
+	}
+	return total;
+}
+
+void VSculptUndoHistory::wait()
+{
+	_packer.wait();
+}
+
+/*the logger is held by the task, it stays alive even if its command is gone*/
+void VSculptUndoHistory::pack_async(const std::shared_ptr<VSculptLogger> &logger)
+{
+	_packer.run([this, logger]()
+	{
+		logger->pack();
+		budget_enforce();
+	});
+}
+
+/*spill the oldest steps, then drop the oldest steps which are still applied to the mesh until the history fits.
+the newest step is always kept. undone steps hold the only copy of the data to redo, they are kept too*/
+void VSculptUndoHistory::budget_enforce()
+{
+	tbb::mutex::scoped_lock lock(_mutex);
+
+	size_t total = 0;
+	for (auto it = _loggers.begin(); it != _loggers.end(); ++it){
+		total += (*it)->memory_size();
+	}
+
+	cold_spill(total);
+
+	while (total > _budget && _loggers.size() > 1){
+		VSculptLogger *oldest = _loggers.front().get();
+		if (oldest->undone())
+			break;
+
+		total -= oldest->memory_size();
+		oldest->release();
+		_released.push_back(_loggers.front());
+		_loggers.pop_front();
+	}
+
+	/*records of dropped or deleted steps*/
+	_journal.trim();
+}
+
+/*_mutex must be locked. move packed steps to the journal, oldest first, until the resident size is under the threshold*/
+void VSculptUndoHistory::cold_spill(size_t &total)
+{
+	if (total <= _resident || _journal_path.empty() || _journal_failed)
+		return;
+
+	if (!_journal.is_open() && !_journal.open(_journal_path)){
+		_journal_failed = true;
+		return;
+	}
+
+	for (size_t i = 0; i + 1 < _loggers.size() && total > _resident; ++i){
+		VSculptLogger *logger = _loggers[i].get();
+		const size_t size = logger->memory_size();
+		if (logger->packed() && logger->spill(&_journal)){
+			total -= size;
+		}
+	}
+}
+
+/*the packer drops steps while a stroke may be modifying the mesh, the killed elements are freed here instead*/
+void VSculptUndoHistory::released_free()
+{
+	std::vector<std::shared_ptr<VSculptLogger>> released;
+	{
+		tbb::mutex::scoped_lock lock(_mutex);
+		released.swap(_released);
+	}
+
+	for (auto it = released.begin(); it != released.end(); ++it){
+		(*it)->release_apply();
+	}
+}
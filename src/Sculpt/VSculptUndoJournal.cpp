@@ -0,0 +1,273 @@
+#include "sculpt/VSculptUndoJournal.h"
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+namespace bip = boost::interprocess;
+
+namespace
+{
+	const uint32_t JOURNAL_MAGIC  = 0x4a555356; /*"VSUJ"*/
+	const uint32_t JOURNAL_HEADER = 3 * sizeof(uint32_t); /*magic, size, crc*/
+
+	uint32_t crc32(const uint8_t *data, size_t size)
+	{
+		static uint32_t table[256];
+		static bool init = false;
+		if (!init){
+			for (uint32_t i = 0; i < 256; ++i){
+				uint32_t c = i;
+				for (int k = 0; k < 8; ++k)
+					c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+				table[i] = c;
+			}
+			init = true;
+		}
+
+		uint32_t crc = 0xffffffffu;
+		for (size_t i = 0; i < size; ++i)
+			crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+		return crc ^ 0xffffffffu;
+	}
+
+	/*trim copies the live frames to a new file once the dead bytes are over this and over the live bytes*/
+	const uint64_t COMPACT_MIN_DEAD = uint64_t(64) << 20;
+
+	int file_seek(FILE *file, uint64_t offset)
+	{
+#ifdef _WIN32
+		return _fseeki64(file, static_cast<__int64>(offset), SEEK_SET);
+#else
+		return fseeko(file, static_cast<off_t>(offset), SEEK_SET);
+#endif
+	}
+}
+
+VSculptUndoJournal::VSculptUndoJournal()
+	:
+	_generation(0),
+	_file(nullptr),
+	_size(0),
+	_live(0),
+	_fail_next(false),
+	_next(0)
+{
+	crc32(nullptr, 0); /*build the table before any concurrent use*/
+}
+
+VSculptUndoJournal::~VSculptUndoJournal()
+{
+	close();
+}
+
+/*the journal only lives as long as the session: pointers in the records are meaningless to another process*/
+bool VSculptUndoJournal::open(const std::string &path)
+{
+	tbb::mutex::scoped_lock lock(_mutex);
+	if (_file)
+		return true;
+
+	_file = fopen(path.c_str(), "w+b");
+	if (!_file)
+		return false;
+
+	_base_path = _path = path;
+	_generation = 0;
+	_size = _live = 0;
+	return true;
+}
+
+void VSculptUndoJournal::close()
+{
+	tbb::mutex::scoped_lock lock(_mutex);
+	file_remove();
+	_frames.clear();
+	_size = _live = 0;
+}
+
+/*_mutex must be locked*/
+void VSculptUndoJournal::file_remove()
+{
+	_mapping.reset();
+	if (_file){
+		fclose(_file);
+		_file = nullptr;
+		std::remove(_path.c_str());
+	}
+}
+
+bool VSculptUndoJournal::append(const std::vector<uint8_t> &payload, Record &record)
+{
+	tbb::mutex::scoped_lock lock(_mutex);
+	if (!_file)
+		return false;
+
+	const uint32_t header[3] = { JOURNAL_MAGIC, static_cast<uint32_t>(payload.size()), crc32(payload.data(), payload.size()) };
+	bool ok = fwrite(header, sizeof(header), 1, _file) == 1;
+	if (_fail_next){
+		_fail_next = false;
+		ok = false;
+	}
+	ok = ok && (payload.empty() || fwrite(payload.data(), payload.size(), 1, _file) == 1) && fflush(_file) == 0;
+
+	if (!ok){
+		/*go back to the end of the last good frame. the next append overwrites the partial frame,
+		the bytes left past it are never read since frames only point below _size*/
+		clearerr(_file);
+		fflush(_file);
+		file_seek(_file, _size);
+		return false;
+	}
+
+	if (++_next == 0)
+		++_next;
+
+	Frame frame;
+	frame.offset = _size + JOURNAL_HEADER;
+	frame.size = header[1];
+	frame.crc = header[2];
+	_frames[_next] = frame;
+	record = _next;
+
+	_size += JOURNAL_HEADER + payload.size();
+	_live += JOURNAL_HEADER + payload.size();
+	return true;
+}
+
+bool VSculptUndoJournal::read(Record record, std::vector<uint8_t> &payload)
+{
+	tbb::mutex::scoped_lock lock(_mutex);
+	auto it = _frames.find(record);
+	if (!_file || it == _frames.end())
+		return false;
+
+	return frame_read(it->second, payload);
+}
+
+bool VSculptUndoJournal::matches(Record record, const std::vector<uint8_t> &payload)
+{
+	tbb::mutex::scoped_lock lock(_mutex);
+	auto it = _frames.find(record);
+	return it != _frames.end() && it->second.size == payload.size() && it->second.crc == crc32(payload.data(), payload.size());
+}
+
+void VSculptUndoJournal::release(Record record)
+{
+	tbb::mutex::scoped_lock lock(_mutex);
+	auto it = _frames.find(record);
+	if (it == _frames.end())
+		return;
+
+	_live -= JOURNAL_HEADER + it->second.size;
+	_frames.erase(it);
+}
+
+void VSculptUndoJournal::trim()
+{
+	tbb::mutex::scoped_lock lock(_mutex);
+	if (!_file || _size == 0)
+		return;
+
+	if (_frames.empty()){
+		/*nothing live, start the file over*/
+		_mapping.reset();
+		_file = freopen(_path.c_str(), "w+b", _file);
+		_size = _live = 0;
+		return;
+	}
+
+	const uint64_t dead = _size - _live;
+	if (dead >= COMPACT_MIN_DEAD && dead > _live)
+		compact();
+}
+
+std::string VSculptUndoJournal::default_path()
+{
+	const char *dir = getenv("TEMP");
+	if (!dir) dir = getenv("TMPDIR");
+	if (!dir) dir = ".";
+	return std::string(dir) + "/vsculpt_undo_" + std::to_string(static_cast<long long>(time(nullptr))) + ".journal";
+}
+
+/*_mutex must be locked. map the pages of the frame, check it and copy the payload out*/
+bool VSculptUndoJournal::frame_read(const Frame &frame, std::vector<uint8_t> &payload)
+{
+	const uint64_t begin = frame.offset - JOURNAL_HEADER;
+	const uint64_t end = frame.offset + frame.size;
+	if (frame.offset < JOURNAL_HEADER || end > _size)
+		return false;
+
+	try{
+		if (!_mapping)
+			_mapping.reset(new bip::file_mapping(_path.c_str(), bip::read_only));
+
+		const uint64_t page = bip::mapped_region::get_page_size();
+		const uint64_t first = begin - begin % page;
+		bip::mapped_region region(*_mapping, bip::read_only, static_cast<bip::offset_t>(first), static_cast<size_t>(end - first));
+		const uint8_t *data = static_cast<const uint8_t*>(region.get_address()) + (begin - first);
+
+		uint32_t header[3];
+		memcpy(header, data, sizeof(header));
+		data += JOURNAL_HEADER;
+		if (header[0] != JOURNAL_MAGIC || header[1] != frame.size || header[2] != frame.crc || crc32(data, frame.size) != frame.crc)
+			return false;
+
+		payload.assign(data, data + frame.size);
+	}
+	catch (const bip::interprocess_exception&){
+		_mapping.reset();
+		return false;
+	}
+	return true;
+}
+
+/*_mutex must be locked. copy the live frames, in file order, to a new file which replaces this one.
+on failure the current file is kept as it is*/
+bool VSculptUndoJournal::compact()
+{
+	const std::string path = _base_path + "." + std::to_string(static_cast<unsigned long long>(_generation + 1));
+	FILE *file = fopen(path.c_str(), "w+b");
+	if (!file)
+		return false;
+
+	std::vector<std::pair<uint64_t, Record>> order;
+	order.reserve(_frames.size());
+	for (auto it = _frames.begin(); it != _frames.end(); ++it){
+		order.push_back(std::make_pair(it->second.offset, it->first));
+	}
+	std::sort(order.begin(), order.end());
+
+	std::vector<uint64_t> offsets(order.size());
+	std::vector<uint8_t> payload;
+	uint64_t size = 0;
+	bool ok = true;
+	for (size_t i = 0; i < order.size() && ok; ++i){
+		const Frame &frame = _frames[order[i].second];
+		const uint32_t header[3] = { JOURNAL_MAGIC, frame.size, frame.crc };
+		ok = frame_read(frame, payload) &&
+			fwrite(header, sizeof(header), 1, file) == 1 &&
+			(payload.empty() || fwrite(payload.data(), payload.size(), 1, file) == 1);
+		offsets[i] = size + JOURNAL_HEADER;
+		size += JOURNAL_HEADER + frame.size;
+	}
+	ok = ok && fflush(file) == 0;
+
+	if (!ok){
+		fclose(file);
+		std::remove(path.c_str());
+		return false;
+	}
+
+	file_remove();
+	_file = file;
+	_path = path;
+	_generation++;
+	for (size_t i = 0; i < order.size(); ++i){
+		_frames[order[i].second].offset = offsets[i];
+	}
+	_size = _live = size;
+	return true;
+}
@@ -0,0 +1,125 @@
+#include "brush/DabScheduler.h"
+#include <algorithm>
+
+namespace
+{
+	/*weight of the newest measure in the running cost*/
+	const double COST_BLEND = 0.3;
+
+	void cost_blend(double &cost, double sample)
+	{
+		cost = cost > 0.0 ? cost + COST_BLEND * (sample - cost) : sample;
+	}
+
+	/*spacing which brings a range of length pixels to budget seconds*/
+	float spacing_fit(float length, double cost, double budget, float lower, float upper)
+	{
+		if (cost <= 0.0 || budget <= 0.0)
+			return lower;
+		const float spacing = static_cast<float>(length * cost / budget);
+		return std::min<float>(std::max<float>(spacing, lower), upper);
+	}
+}
+
+DabScheduler::DabScheduler()
+	:
+	_budget(1.0 / 60.0),
+	_base_spacing(1.0f),
+	_max_spacing(1.0f),
+	_topology(false),
+	_topology_cost(0.0),
+	_plain_cost(0.0),
+	_spacing(1.0f),
+	_deferred(false)
+{}
+
+DabScheduler::~DabScheduler()
+{}
+
+/*costs are kept from the last stroke: the brush and the mesh rarely change between strokes*/
+void DabScheduler::stroke_begin(float pixel_radius, bool topology)
+{
+	_base_spacing = pixel_radius * 0.2f;
+	_max_spacing = pixel_radius;
+	_topology = topology;
+	_spacing = _base_spacing;
+	_deferred = false;
+	_decisions.clear();
+}
+
+void DabScheduler::plan(float length)
+{
+	const double cost = _topology ? _topology_cost : _plain_cost;
+	_spacing = spacing_fit(length, cost, _budget, _base_spacing, _max_spacing);
+	_deferred = false;
+
+	double estimate = cost * std::max<float>(length / _spacing, 1.0f);
+	if (_topology && estimate > _budget){
+		_deferred = true;
+		_spacing = spacing_fit(length, _plain_cost, _budget, _base_spacing, _max_spacing);
+		estimate = _plain_cost * std::max<float>(length / _spacing, 1.0f);
+	}
+
+	Decision decision;
+	decision.length = length;
+	decision.spacing = _spacing;
+	decision.totdab = 0;
+	decision.estimate = estimate;
+	decision.seconds = 0.0;
+	decision.topology_deferred = _deferred;
+	_decisions.push_back(decision);
+}
+
+void DabScheduler::range_done(size_t totdab, double seconds)
+{
+	if (!_decisions.empty()){
+		_decisions.back().totdab = totdab;
+		_decisions.back().seconds = seconds;
+	}
+
+	if (totdab == 0)
+		return;
+
+	const double sample = seconds / totdab;
+	if (_topology && !_deferred)
+		cost_blend(_topology_cost, sample);
+	else
+		cost_blend(_plain_cost, sample);
+}
+
+void DabScheduler::refine_add(const std::vector<StrokeDab> &dabs)
+{
+	_refine.insert(_refine.end(), dabs.begin(), dabs.end());
+}
+
+bool DabScheduler::refine_pop(StrokeDab &dab)
+{
+	if (_refine.empty())
+		return false;
+	dab = _refine.front();
+	_refine.pop_front();
+	return true;
+}
+
+/*a refinement measures the topology part of a dab*/
+void DabScheduler::refine_done(size_t totdab, double seconds)
+{
+	if (totdab > 0){
+		cost_blend(_topology_cost, _plain_cost + seconds / totdab);
+	}
+}
+
+/*split/collapse is most of a dab with dynamic topology, so a refinement costs about the difference*/
+size_t DabScheduler::refine_count() const
+{
+	const double cost = std::max<double>(_topology_cost - _plain_cost, 0.0);
+	size_t count = cost > 0.0 ? static_cast<size_t>(_budget / cost) : 1;
+	return std::min<size_t>(std::max<size_t>(count, 1), _refine.size());
+}
+
+void DabScheduler::clear()
+{
+	_refine.clear();
+	_decisions.clear();
+	_deferred = false;
+}
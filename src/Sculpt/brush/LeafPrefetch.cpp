@@ -0,0 +1,115 @@
+#include "brush/LeafPrefetch.h"
+#include "VBvh/BMBvhIsect.h"
+#include "tbb/parallel_for.h"
+#include "tbb/blocked_range.h"
+#include "VBvh/common/sys/intrinsics.h"
+#include <algorithm>
+
+namespace
+{
+	/*below this step the stroke is considered still, the leaf nodes of the last dab are already touched*/
+	const float STILL_STEP = 0.05f;
+
+	/*predictions stop this many radii away from the last dab. a merged mouse range can make large steps*/
+	const float PREDICT_MAX_RADII = 3.0f;
+}
+
+LeafPrefetch::LeafPrefetch()
+	:
+	_totpos(0),
+	_radius(0.0f),
+	_pending(false),
+	_horizon(3),
+	_totprefetch(0)
+{}
+
+LeafPrefetch::~LeafPrefetch()
+{}
+
+void LeafPrefetch::dab_add(const Vector3f &pos, float radius)
+{
+	_pos[_totpos % HISTORY] = pos;
+	_totpos++;
+	_radius = radius;
+	_pending = true;
+}
+
+/*constant velocity, averaged over the last dabs to smooth the jitter of the input*/
+void LeafPrefetch::predict(std::vector<Vector3f> &centers) const
+{
+	centers.clear();
+	if (_totpos < 2 || _radius <= 0.0f)
+		return;
+
+	const size_t span = std::min<size_t>(_totpos - 1, HISTORY - 1);
+	const Vector3f &last = _pos[(_totpos - 1) % HISTORY];
+	const Vector3f &first = _pos[(_totpos - 1 - span) % HISTORY];
+	const Vector3f step = (last - first) / static_cast<float>(span);
+
+	const float steplen = step.norm();
+	if (steplen < STILL_STEP * _radius)
+		return;
+
+	for (size_t k = 1; k <= _horizon; ++k){
+		if (k * steplen > PREDICT_MAX_RADII * _radius)
+			break;
+		centers.push_back(last + static_cast<float>(k) * step);
+	}
+}
+
+size_t LeafPrefetch::run(BMBvh *bvh, const std::vector<Vector3f> &centers, float radius, BrushSelection &selection)
+{
+	_pending = false;
+	if (centers.empty())
+		return 0;
+
+	/*the bvh is only read*/
+	_hits.resize(centers.size());
+	tbb::parallel_for(static_cast<size_t>(0), centers.size(), [&](size_t i){
+		_hits[i].clear();
+		isect_sphere_bm_bvh(bvh, centers[i], radius, _hits[i]);
+	});
+
+	_nodes.clear();
+	size_t maxhit = 0, maxvert = 0;
+	for (auto it = _hits.begin(); it != _hits.end(); ++it){
+		_nodes.insert(_nodes.end(), it->begin(), it->end());
+		maxhit = std::max<size_t>(maxhit, it->size());
+
+		size_t totvert = 0;
+		for (auto nit = it->begin(); nit != it->end(); ++nit){
+			totvert += (*nit)->verts().size();
+		}
+		maxvert = std::max<size_t>(maxvert, totvert);
+	}
+	std::sort(_nodes.begin(), _nodes.end());
+	_nodes.erase(std::unique(_nodes.begin(), _nodes.end()), _nodes.end());
+
+	/*leaf nodes already touched in the stroke are warm*/
+	_nodes.erase(std::remove_if(_nodes.begin(), _nodes.end(),
+		[](BMLeafNode *node){ return node->appFlagBit(LEAF_ORIGIN_DATA_SAVED); }), _nodes.end());
+	if (_nodes.empty())
+		return 0;
+
+	/*the element arrays are read here, the elements they point to are prefetched to L2*/
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, _nodes.size()), [&](const tbb::blocked_range<size_t> &range)
+	{
+		for (size_t i = range.begin(); i != range.end(); ++i){
+			BMLeafNode *node = _nodes[i];
+
+			const BMVertVector &verts = node->verts();
+			for (size_t v = 0; v < verts.size(); ++v){
+				prefetchL2(verts[v]);
+			}
+			const BMFaceVector &faces = node->faces();
+			for (size_t f = 0; f < faces.size(); ++f){
+				prefetchL2(faces[f]);
+			}
+		}
+	});
+
+	selection.reserve(maxhit, maxvert);
+
+	_totprefetch += _nodes.size();
+	return _nodes.size();
+}
@@ -18,17 +18,21 @@
 #include "brush/GrabBrushOp.h"
 #include "brush/SnakeHookBrushOp.h"
 #include "brush/ThumbBrushOp.h"
+#include "brush/StrokeProfile.h"
 #include "commonDefine.h"
 #include "BaseLib/MathUtil.h"
 #include "VBvh/BMBvhIsect.h"
 #include "BaseLib/Point3Dd.h"
 #include "VbsQt/VbsDef.h"
+#include <algorithm>
 
 SculptStroke::SculptStroke(StrokeData *data)
 	:
 	_data(data),
 	_step_logger(nullptr)
-{}
+{
+	_data->selection = &_selection;
+}
 
 SculptStroke::~SculptStroke()
 {
@@ -43,28 +47,306 @@ void SculptStroke::add_step(bool log_step)
 		step_logger_begin();
 	}
 
+	if (_data->sym_flag != 0 && !is_dynamic_topology()){
+		symm_passes_run();
+	}
+	else{
+		size_t symm = _data->sym_flag;
+		//_symFlag is a bit combination of XYZ - 1 is mirror X; 2 is Y; 3 is XY; 4 is Z; 5 is XZ; 6 is YZ; 7 is XYZ
+		for (size_t i = 0; i <= symm; ++i){
+			if (i == 0 || (symm & i && (symm != 5 || i != 3) && (symm != 6 || (i != 3 && i != 5)))){
+				calc_symm_data(i);
+				Vector3f center = _data->symn_data.cur_pos;
+				const std::vector<BMLeafNode*> &nodes = _selection.nodes_select(_data->bvh, center, _data->world_radius);
+				if (!nodes.empty()){
+					if (_data->profile) _data->profile->nodes_add(nodes.size());
+					{
+						StrokeProfile::Scope scope(_data->profile, StrokeProfile::PHASE_BRUSH);
+						save_origin_node_data(nodes);
+					}
+					update_topology();
+					{
+						StrokeProfile::Scope scope(_data->profile, StrokeProfile::PHASE_BRUSH);
+						do_brush(_data);
+					}
+					/*vertices moved*/
+					_selection.invalidate();
+				}
+			}
+		}
+	}
+	step_update();
+	_prefetch.dab_add(_data->cur_pos, _data->world_radius);
+	
+	if (log_step){
+		step_logger_end();
+	}
+}
+
+/*apply a run of dabs. without dynamic topology, dabs of a brush which only moves vertices inside its
+sphere are applied in one pass over the union of their leaf nodes: each vertex receives the dabs in
+order, then bounds and draw buffers are updated once*/
+void SculptStroke::add_steps(const std::vector<StrokeDab> &dabs)
+{
+	if (dabs.size() < 2 || !is_batch_brush()){
+		for (auto it = dabs.begin(); it != dabs.end(); ++it){
+			dab_load(*it);
+			add_step(false);
+		}
+		return;
+	}
+
 	size_t symm = _data->sym_flag;
+	std::vector<StrokeData> sdatas(dabs.size());
 	std::vector<BMLeafNode*> nodes;
-	//_symFlag is a bit combination of XYZ - 1 is mirror X; 2 is Y; 3 is XY; 4 is Z; 5 is XZ; 6 is YZ; 7 is XYZ
 	for (size_t i = 0; i <= symm; ++i){
 		if (i == 0 || (symm & i && (symm != 5 || i != 3) && (symm != 6 || (i != 3 && i != 5)))){
-			calc_symm_data(i);
 			nodes.clear();
-			Vector3f center = _data->symn_data.cur_pos;
-			if (isect_sphere_bm_bvh(_data->bvh, center, _data->world_radius, nodes)){
+			for (size_t k = 0; k < dabs.size(); ++k){
+				dab_load(dabs[k]);
+				calc_symm_data(i);
+				sdatas[k] = *_data;
+				isect_sphere_bm_bvh(_data->bvh, _data->symn_data.cur_pos, _data->world_radius, nodes);
+			}
+
+			std::sort(nodes.begin(), nodes.end());
+			nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
+
+			if (!nodes.empty()){
+				if (_data->profile) _data->profile->nodes_add(nodes.size());
+				StrokeProfile::Scope scope(_data->profile, StrokeProfile::PHASE_BRUSH);
 				save_origin_node_data(nodes);
+				do_brush_batch(sdatas, nodes);
+				/*vertices moved*/
+				_selection.invalidate();
+			}
+		}
+	}
+	step_update();
+
+	for (auto it = dabs.begin(); it != dabs.end(); ++it){
+		_prefetch.dab_add(it->cur_pos, it->world_radius);
+	}
+}
+
+/*split/collapse of a dab without the brush. refines dabs which were brushed with dynamic topology deferred*/
+void SculptStroke::add_topology_step(const StrokeDab &dab)
+{
+	if (!is_dynamic_topology())
+		return;
+
+	dab_load(dab);
+
+	size_t symm = _data->sym_flag;
+	for (size_t i = 0; i <= symm; ++i){
+		if (i == 0 || (symm & i && (symm != 5 || i != 3) && (symm != 6 || (i != 3 && i != 5)))){
+			calc_symm_data(i);
+			const std::vector<BMLeafNode*> &nodes = _selection.nodes_select(_data->bvh, _data->symn_data.cur_pos, _data->world_radius);
+			if (!nodes.empty()){
+				{
+					StrokeProfile::Scope scope(_data->profile, StrokeProfile::PHASE_BRUSH);
+					save_origin_node_data(nodes);
+				}
 				update_topology();
-				do_brush();
+				_selection.invalidate();
 			}
 		}
 	}
-	_data->bvh->sculpt_stroke_step_update();
-	
-	if (log_step){
-		step_logger_end();
+	step_update();
+}
+
+/*mirrored passes run in waves. a wave takes every remaining pass which conflicts with no earlier remaining pass,
+so passes which overlap keep their order and the result does not depend on scheduling.
+passes are selected again before each wave as the previous wave moved vertices.
+split/collapse edits the mesh and leaf membership, with dynamic topology passes stay sequential*/
+void SculptStroke::symm_passes_run()
+{
+	std::vector<size_t> remain;
+	size_t symm = _data->sym_flag;
+	for (size_t i = 0; i <= symm; ++i){
+		if (i == 0 || (symm & i && (symm != 5 || i != 3) && (symm != 6 || (i != 3 && i != 5)))){
+			remain.push_back(i);
+		}
+	}
+
+	std::vector<size_t> wave;
+	while (!remain.empty()){
+		_symm_passes.resize(remain.size());
+		size_t totpass = 0;
+		for (size_t k = 0; k < remain.size(); ++k){
+			_symm_passes[totpass].symm = remain[k];
+			if (symm_pass_select(totpass, _symm_passes[totpass]))
+				totpass++;
+		}
+		if (totpass == 0)
+			break;
+
+		wave.clear();
+		remain.clear();
+		for (size_t k = 0; k < totpass; ++k){
+			bool independent = true;
+			for (size_t j = 0; j < k && independent; ++j){
+				independent = !symm_pass_conflict(_symm_passes[j], _symm_passes[k]);
+			}
+			if (independent)
+				wave.push_back(k);
+			else
+				remain.push_back(_symm_passes[k].symm);
+		}
+
+		if (_data->profile){
+			for (size_t k = 0; k < wave.size(); ++k){
+				_data->profile->nodes_add(_symm_passes[wave[k]].data.selection->nodes().size());
+			}
+		}
+
+		StrokeProfile::Scope scope(_data->profile, StrokeProfile::PHASE_BRUSH);
+		_data->bvh->leaf_node_fused_group_begin();
+		tbb::parallel_for(static_cast<size_t>(0), wave.size(), [&](size_t k)
+		{
+			SymmPass &pass = _symm_passes[wave[k]];
+			save_origin_node_data(pass.data.selection->nodes());
+			do_brush(&pass.data);
+		});
+		_data->bvh->leaf_node_fused_group_end();
+
+		/*vertices moved*/
+		for (size_t k = 0; k < wave.size(); ++k){
+			_symm_passes[wave[k]].data.selection->invalidate();
+		}
+	}
+	_selection.invalidate();
+}
+
+/*leaf nodes and bounds of a pass, false if the mirrored dab touches nothing*/
+bool SculptStroke::symm_pass_select(size_t slot, SymmPass &pass)
+{
+	calc_symm_data(pass.symm);
+	pass.data = *_data;
+	pass.data.selection = &_symm_selections[slot];
+
+	const std::vector<BMLeafNode*> &nodes = pass.data.selection->nodes_select(_data->bvh, pass.data.symn_data.cur_pos, _data->world_radius);
+	if (nodes.empty())
+		return false;
+
+	pass.write_bb.setEmpty();
+	for (size_t i = 0; i < nodes.size(); ++i){
+		pass.write_bb.extend(nodes[i]->boundsEigen());
+	}
+
+	std::vector<BMLeafNode*> neighbours;
+	isect_box_bm_bvh(_data->bvh, pass.write_bb, neighbours);
+	pass.reach_bb = pass.write_bb;
+	for (size_t i = 0; i < neighbours.size(); ++i){
+		pass.reach_bb.extend(neighbours[i]->boundsEigen());
+	}
+	return true;
+}
+
+/*a face across two leaf nodes lies in the bounds of both, so a pass never reads or writes vertices or faces
+of another pass if neither reaches the leaf nodes the other deforms*/
+bool SculptStroke::symm_pass_conflict(const SymmPass &a, const SymmPass &b)
+{
+	return a.reach_bb.intersects(b.write_bb) || b.reach_bb.intersects(a.write_bb);
+}
+
+void SculptStroke::dab_load(const StrokeDab &dab)
+{
+	_data->cur_pos		= dab.cur_pos;
+	_data->last_pos		= dab.last_pos;
+	_data->grab_delta	= dab.grab_delta;
+	_data->view_dir		= dab.view_dir;
+	_data->world_radius = dab.world_radius;
+	_data->max_edge_len = dab.max_edge_len;
+	_data->min_edge_len = dab.min_edge_len;
+}
+
+bool SculptStroke::is_batch_brush()
+{
+	if (is_dynamic_topology())
+		return false;
+
+	switch (_data->brush_type)
+	{
+	case VbsDef::BRUSH_DRAW:
+	case VbsDef::BRUSH_INFLATE:
+	case VbsDef::BRUSH_CREASE:
+	case VbsDef::BRUSH_PINCH:
+	case VbsDef::BRUSH_CLAY:
+	case VbsDef::BRUSH_FLATTEN:
+	case VbsDef::BRUSH_FILL:
+	case VbsDef::BRUSH_NUDGET:
+		return true;
+	default:
+		return false;
+	}
+}
+
+void SculptStroke::do_brush_batch(std::vector<StrokeData> &sdatas, const std::vector<BMLeafNode*> &nodes)
+{
+	switch (_data->brush_type)
+	{
+	case VbsDef::BRUSH_DRAW:	brush_batch<DrawBrushOp>(sdatas, nodes); break;
+	case VbsDef::BRUSH_INFLATE: brush_batch<InflateBrushOp>(sdatas, nodes); break;
+	case VbsDef::BRUSH_CREASE:	brush_batch<CreaseBrushOp>(sdatas, nodes); break;
+	case VbsDef::BRUSH_PINCH:	brush_batch<PinchBrushOp>(sdatas, nodes); break;
+	case VbsDef::BRUSH_CLAY:	brush_batch<ClayBrushOp>(sdatas, nodes); break;
+	case VbsDef::BRUSH_FLATTEN: brush_batch<FlattenBrushOp>(sdatas, nodes); break;
+	case VbsDef::BRUSH_FILL:	brush_batch<FillBrushOp>(sdatas, nodes); break;
+	case VbsDef::BRUSH_NUDGET:	brush_batch<NudgetBrushOp>(sdatas, nodes); break;
 	}
 }
 
+/*brush data (plane, normal) of every dab is computed from the mesh before the batch*/
+template<class BrushOp>
+void SculptStroke::brush_batch(std::vector<StrokeData> &sdatas, const std::vector<BMLeafNode*> &nodes)
+{
+	std::vector<BrushOp> ops;
+	ops.reserve(sdatas.size());
+	for (size_t k = 0; k < sdatas.size(); ++k){
+		ops.push_back(BrushOp(&sdatas[k]));
+		ops.back().init();
+	}
+
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, nodes.size()), [&](const tbb::blocked_range<size_t> &range)
+	{
+		BrushVertexBatch batch(_data->bvh);
+		for (size_t i = range.begin(); i != range.end(); ++i){
+			BMLeafNode *node = nodes[i];
+			node->setAppFlagBit(LEAF_UPDATE_STEP_BB | LEAF_UPDATE_STEP_DRAW_BUFFER);
+
+			for (size_t k = 0; k < ops.size(); ++k){
+				const StrokeData &sdata = sdatas[k];
+				if (batch.gather(node->verts(), sdata.symn_data.cur_pos, sdata.world_radius)){
+					batch.falloff(sdata.deform_curve);
+					ops[k].deform(batch);
+				}
+			}
+			_data->bvh->leaf_node_fused_update(node);
+		}
+	});
+	_data->bvh->leaf_node_fused_finish();
+}
+
+/*the predicted centers are mirrored like the dabs*/
+void SculptStroke::prefetch()
+{
+	std::vector<Vector3f> centers;
+	_prefetch.predict(centers);
+
+	_prefetch_centers.clear();
+	size_t symm = _data->sym_flag;
+	for (size_t i = 0; i <= symm; ++i){
+		if (i == 0 || (symm & i && (symm != 5 || i != 3) && (symm != 6 || (i != 3 && i != 5)))){
+			for (auto it = centers.begin(); it != centers.end(); ++it){
+				_prefetch_centers.push_back(MathUtil::flipPoint3D(*it, Vector3f(0.0f, 0.0f, 0.0f), static_cast<char>(i)));
+			}
+		}
+	}
+
+	_prefetch.run(_data->bvh, _prefetch_centers, _prefetch.radius(), _selection);
+}
+
 void SculptStroke::step_logger_begin()
 {
 	if (_step_logger){
@@ -91,92 +373,92 @@ void SculptStroke::finish_stroke()
 	_data->bvh->sculpt_stroke_finish_update();
 }
 
-void SculptStroke::do_brush()
+void SculptStroke::do_brush(StrokeData *data)
 {
-	int btype = _data->brush_type;
+	int btype = data->brush_type;
 	switch (btype)
 	{
 	case VbsDef::BRUSH_INFLATE:
 	{
-		InflateBrushOp op(_data);
+		InflateBrushOp op(data);
 		op.run();
 		break;
 	}
 	case VbsDef::BRUSH_SNAKE_HOOK:
 	{
-		SnakeHookBrushOp op(_data);
+		SnakeHookBrushOp op(data);
 		op.run();
 		break;
 	}
 	case VbsDef::BRUSH_CREASE:
 	{
-		CreaseBrushOp op(_data);
+		CreaseBrushOp op(data);
 		op.run();
 		break;
 	}
 	case VbsDef::BRUSH_FLATTEN:
 	{
-		FlattenBrushOp op(_data);
+		FlattenBrushOp op(data);
 		op.run();
 		break;
 	}
 	case VbsDef::BRUSH_NUDGET:
 	{
-		NudgetBrushOp op(_data);
+		NudgetBrushOp op(data);
 		op.run();
 		break;
 	}
 	case VbsDef::BRUSH_CLAY_STRIP:
 	{
-		ClayStripBrushOp op(_data);
+		ClayStripBrushOp op(data);
 		op.run();
 		break;
 	}
 	case VbsDef::BRUSH_CLAY:
 	{
-		ClayBrushOp op(_data);
+		ClayBrushOp op(data);
 		op.run();
 		break;
 	}
 	case VbsDef::BRUSH_FILL:
 	{
-		FillBrushOp op(_data);
+		FillBrushOp op(data);
 		op.run();
 		break;
 	}
 	case VbsDef::BRUSH_ROTATE:
 	{
-		RotateBrushOp op(_data);
-		op.run(false);
+		RotateBrushOp op(data);
+		op.run();
 		break;
 	}
 	case VbsDef::BRUSH_DRAW:
 	{
-		DrawBrushOp op(_data);
+		DrawBrushOp op(data);
 		op.run();
 		break;
 	}
 	case VbsDef::BRUSH_SMOOTH:
 	{
-		SmoothBrushOp op(_data);
+		SmoothBrushOp op(data);
 		op.run();
 		break;
 	}
 	case VbsDef::BRUSH_GRAB:
 	{
-		GrabBrushOp op(_data);
-		op.run(false);
+		GrabBrushOp op(data);
+		op.run();
 		break;
 	}
 	case VbsDef::BRUSH_THUMB:
 	{
-		ThumbBrushOp op(_data);
-		op.run(false);
+		ThumbBrushOp op(data);
+		op.run();
 		break;
 	}
 	case VbsDef::BRUSH_PINCH:
 	{
-		PinchBrushOp op(_data);
+		PinchBrushOp op(data);
 		op.run();
 		break;
 	}
@@ -198,15 +480,14 @@ void SculptStroke::calc_symm_data(size_t symm)
 
 void SculptStroke::push_undo_redo()
 {
-	BLI_assert(_data->undo_redo_logger);
-
+	/*no logger when the stroke is replayed without undo*/
 	if (_step_logger){
 		if (_data->undo_redo_logger){
 			/*use std::move as we don't need data anymore. just move to SculptCommand for the sake of performace*/
 			_data->undo_redo_logger->log_data(std::move(*_step_logger)); 
-			delete _step_logger;
-			_step_logger = nullptr;
 		}
+		delete _step_logger;
+		_step_logger = nullptr;
 	}
 	else{
 		/*collect all BVH leaf nodes marked CHANGED*/
@@ -230,10 +511,27 @@ void SculptStroke::save_origin_node_data(const std::vector<BMLeafNode*> &nodes)
 }
 
 
+/*with a profile, normals and leaf bounds are updated first so that the refit is timed alone*/
+void SculptStroke::step_update()
+{
+	if (_data->profile){
+		{
+			StrokeProfile::Scope scope(_data->profile, StrokeProfile::PHASE_NORMALS);
+			_data->bvh->bvh_marked_leaf_nodes_bb_update();
+		}
+		StrokeProfile::Scope scope(_data->profile, StrokeProfile::PHASE_REFIT);
+		_data->bvh->sculpt_stroke_step_update();
+	}
+	else{
+		_data->bvh->sculpt_stroke_step_update();
+	}
+}
+
 void SculptStroke::update_topology()
 {
 	if (is_dynamic_topology())
 	{
+		StrokeProfile::Scope scope(_data->profile, StrokeProfile::PHASE_DYNTOPO);
 		BMSplitCollapseOp op(_data);
 		op.run();
 	}
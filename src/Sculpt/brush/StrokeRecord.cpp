@@ -0,0 +1,184 @@
+#include "brush/StrokeRecord.h"
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+	const char *RECORD_HEADER = "vsculpt_stroke_record";
+	const int	RECORD_VERSION = 2; /*1 has no schedule lines*/
+
+	void vec_write(FILE *file, const Vector3f &v)
+	{
+		fprintf(file, " %.9g %.9g %.9g", v[0], v[1], v[2]);
+	}
+
+	bool vec_read(FILE *file, Vector3f &v)
+	{
+		return fscanf(file, "%f %f %f", &v[0], &v[1], &v[2]) == 3;
+	}
+}
+
+StrokeRecord::StrokeRecord()
+	:
+	_open(false)
+{}
+
+StrokeRecord::~StrokeRecord()
+{}
+
+void StrokeRecord::stroke_begin(const StrokeData &data, int falloff)
+{
+	Stroke stroke;
+	stroke.brush_type		= data.brush_type;
+	stroke.flag				= data.flag;
+	stroke.sym_flag			= data.sym_flag;
+	stroke.falloff			= falloff;
+	stroke.smooth_iterations = data.smooth_iterations;
+	stroke.brush_strength	= data.brush_strength;
+	stroke.pinch_factor		= data.pinch_factor;
+	stroke.scale			= data.scale;
+	stroke.edge_len_unit_threshold = data.edge_len_unit_threshold;
+	stroke.first_hit_pos	= data.first_hit_pos;
+	_strokes.push_back(stroke);
+	_open = true;
+}
+
+void StrokeRecord::segment_add(bool single, const std::vector<Sample> &samples)
+{
+	if (!_open || samples.empty())
+		return;
+
+	Segment segment;
+	segment.single = single;
+	segment.samples = samples;
+	memset(&segment.schedule, 0, sizeof(StrokeProfile::Schedule));
+	_strokes.back().segments.push_back(segment);
+}
+
+void StrokeRecord::segment_schedule_set(const StrokeProfile::Schedule &schedule)
+{
+	if (_open && !_strokes.back().segments.empty()){
+		_strokes.back().segments.back().schedule = schedule;
+		_strokes.back().segments.back().schedule.scheduled = true;
+	}
+}
+
+void StrokeRecord::stroke_end()
+{
+	_open = false;
+}
+
+bool StrokeRecord::save(const std::string &path) const
+{
+	FILE *file = fopen(path.c_str(), "a");
+	if (!file)
+		return false;
+
+	fseek(file, 0, SEEK_END);
+	if (ftell(file) == 0){
+		fprintf(file, "%s %d\n", RECORD_HEADER, RECORD_VERSION);
+	}
+
+	for (auto it = _strokes.begin(); it != _strokes.end(); ++it){
+		const Stroke &stroke = *it;
+		fprintf(file, "stroke %d %d %d %d %d %.9g %.9g %.9g %.9g",
+			stroke.brush_type, stroke.flag, stroke.sym_flag, stroke.falloff, stroke.smooth_iterations,
+			stroke.brush_strength, stroke.pinch_factor, stroke.scale, stroke.edge_len_unit_threshold);
+		vec_write(file, stroke.first_hit_pos);
+		fprintf(file, "\n");
+
+		for (auto sit = stroke.segments.begin(); sit != stroke.segments.end(); ++sit){
+			fprintf(file, "segment %d %d\n", sit->single ? 1 : 0, static_cast<int>(sit->samples.size()));
+			for (auto pit = sit->samples.begin(); pit != sit->samples.end(); ++pit){
+				const StrokeDab &dab = pit->dab;
+				fprintf(file, "s");
+				vec_write(file, dab.cur_pos);
+				vec_write(file, dab.last_pos);
+				vec_write(file, dab.grab_delta);
+				vec_write(file, dab.view_dir);
+				fprintf(file, " %.9g %.9g %.9g", dab.world_radius, dab.max_edge_len, dab.min_edge_len);
+				vec_write(file, pit->ray_org);
+				vec_write(file, pit->ray_dir);
+				fprintf(file, " %.9g\n", pit->rotate_angle);
+			}
+
+			const StrokeProfile::Schedule &schedule = sit->schedule;
+			if (schedule.scheduled){
+				fprintf(file, "schedule %d %.9g %.9g %.9g\n", schedule.topology_deferred ? 1 : 0,
+					schedule.spacing, schedule.estimate, schedule.seconds);
+			}
+		}
+		fprintf(file, "end\n");
+	}
+
+	bool ok = ferror(file) == 0;
+	fclose(file);
+	return ok;
+}
+
+bool StrokeRecord::load(const std::string &path)
+{
+	_strokes.clear();
+	_open = false;
+
+	FILE *file = fopen(path.c_str(), "r");
+	if (!file)
+		return false;
+
+	char tag[64];
+	int version = 0;
+	if (fscanf(file, "%63s %d", tag, &version) != 2 || strcmp(tag, RECORD_HEADER) != 0 || version < 1 || version > RECORD_VERSION){
+		fclose(file);
+		return false;
+	}
+
+	bool ok = true;
+	while (ok && fscanf(file, "%63s", tag) == 1){
+		if (strcmp(tag, "stroke") == 0){
+			Stroke stroke;
+			ok = fscanf(file, "%d %d %d %d %d %f %f %f %f",
+				&stroke.brush_type, &stroke.flag, &stroke.sym_flag, &stroke.falloff, &stroke.smooth_iterations,
+				&stroke.brush_strength, &stroke.pinch_factor, &stroke.scale, &stroke.edge_len_unit_threshold) == 9 &&
+				vec_read(file, stroke.first_hit_pos);
+			if (ok){
+				_strokes.push_back(stroke);
+			}
+		}
+		else if (strcmp(tag, "segment") == 0 && !_strokes.empty()){
+			int single, num;
+			ok = fscanf(file, "%d %d", &single, &num) == 2 && num >= 0;
+			if (ok){
+				Segment segment;
+				segment.single = single != 0;
+				memset(&segment.schedule, 0, sizeof(StrokeProfile::Schedule));
+				segment.samples.resize(num);
+				for (int i = 0; ok && i < num; ++i){
+					Sample &s = segment.samples[i];
+					StrokeDab &dab = s.dab;
+					ok = fscanf(file, "%63s", tag) == 1 && strcmp(tag, "s") == 0 &&
+						vec_read(file, dab.cur_pos) && vec_read(file, dab.last_pos) &&
+						vec_read(file, dab.grab_delta) && vec_read(file, dab.view_dir) &&
+						fscanf(file, "%f %f %f", &dab.world_radius, &dab.max_edge_len, &dab.min_edge_len) == 3 &&
+						vec_read(file, s.ray_org) && vec_read(file, s.ray_dir) &&
+						fscanf(file, "%f", &s.rotate_angle) == 1;
+				}
+				if (ok){
+					_strokes.back().segments.push_back(segment);
+				}
+			}
+		}
+		else if (strcmp(tag, "schedule") == 0 && !_strokes.empty() && !_strokes.back().segments.empty()){
+			StrokeProfile::Schedule &schedule = _strokes.back().segments.back().schedule;
+			int deferred;
+			ok = fscanf(file, "%d %f %lf %lf", &deferred, &schedule.spacing, &schedule.estimate, &schedule.seconds) == 4;
+			schedule.topology_deferred = deferred != 0;
+			schedule.scheduled = ok;
+		}
+		else if (strcmp(tag, "end") != 0){
+			ok = false;
+		}
+	}
+
+	fclose(file);
+	return ok;
+}
@@ -0,0 +1,574 @@
+/*replays recorded sculpt strokes on a mesh without the viewer and writes per-step phase timings as json.
+usage: SculptBench <mesh> <record> [record...] [-o result.json] [-repeat n] [-multires level]
+records are written by the app when VSCULPT_STROKE_RECORD names a file.
+with -multires the mesh is subdivided to the level and the dabs displace that level instead of the mesh.
+SculptBench -check runs the self checks of the sculpt and mesh libraries instead*/
+
+#include <vcg/complex/complex.h>
+#include <vcg/complex/append.h>
+#include <wrap/io_trimesh/import.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "BMesh/BMeshCore.h"
+#include "VBvh/BMeshBvh.h"
+#include "VBvh/BMeshBvhBuilder.h"
+#include "VBvh/BMBvhIsect.h"
+#include "BMesh/Tools/BMeshDecimate.h"
+#include "BMesh/Tools/BMeshEdgeQueueBench.h"
+#include "sculpt/StrokeData.h"
+#include "sculpt/BezierCurve.h"
+#include "sculpt/commonDefine.h"
+#include "sculpt/brush/SculptStroke.h"
+#include "sculpt/brush/StrokeRecord.h"
+#include "sculpt/brush/StrokeProfile.h"
+#include "sculpt/VSculptUndoJournal.h"
+#include "sculpt/VSculptMultires.h"
+#include "tbb/task_scheduler_init.h"
+#include "tbb/parallel_for.h"
+
+using namespace VM;
+using namespace VBvh;
+
+namespace
+{
+	BMesh* mesh_import(const std::string &file)
+	{
+		class MyVertex;
+		class MyEdge;
+		class MyFace;
+		struct MyUsedTypes : public vcg::UsedTypes<vcg::Use<MyVertex>::AsVertexType, vcg::Use<MyEdge>::AsEdgeType, vcg::Use<MyFace>::AsFaceType>{};
+		class  MyVertex : public vcg::Vertex< MyUsedTypes, vcg::vertex::VFAdj, vcg::vertex::Coord3f, vcg::vertex::Normal3f, vcg::vertex::Mark, vcg::vertex::BitFlags>{};
+		class  MyEdge : public vcg::Edge< MyUsedTypes> {};
+		class  MyFace : public vcg::Face< MyUsedTypes, vcg::face::VFAdj, vcg::face::VertexRef, vcg::face::BitFlags > {};
+		class  MyMesh : public vcg::tri::TriMesh<std::vector<MyVertex>, std::vector<MyFace> > {};
+
+		MyMesh mesh;
+		if (vcg::tri::io::Importer<MyMesh>::Open(mesh, file.c_str()))
+			return nullptr;
+
+		if (file.find(".stl") != std::string::npos){
+			vcg::tri::Clean<MyMesh>::RemoveDuplicateVertex(mesh);
+		}
+
+		BMesh *bm = new BMesh();
+		std::unordered_map<MyMesh::VertexPointer, BMVert*> bmverts;
+		for (size_t i = 0; i < mesh.vert.size(); ++i){
+			MyMesh::VertexPointer v = &mesh.vert[i];
+			if (!v->IsD()){
+				MyMesh::CoordType &coord = v->P();
+				bmverts[v] = bm->BM_vert_create(Vector3f(coord[0], coord[1], coord[2]), nullptr, BM_CREATE_NOP);
+			}
+		}
+
+		for (auto fi = mesh.face.begin(); fi != mesh.face.end(); ++fi){
+			if (!fi->IsD()){
+				BMVert *verts[3] = { bmverts[fi->V(0)], bmverts[fi->V(1)], bmverts[fi->V(2)] };
+				if (verts[0] && verts[1] && verts[2]){
+					bm->BM_face_create_quad_tri(verts[0], verts[1], verts[2], nullptr, nullptr, BM_CREATE_NOP);
+				}
+			}
+		}
+
+		bm->BM_mesh_normals_update();
+		return bm;
+	}
+
+	/*same work as VMeshObjectRender::updateNodeVertexBufferData, into a cpu buffer. there is no gl context to upload to*/
+	void buffer_prepare(BMBvh *bvh, std::vector<std::vector<float>> &buffers)
+	{
+		std::vector<BMLeafNode*> nodes;
+		if (!bvh->leaf_node_dirty_draw(nodes))
+			return;
+
+		int max_id = 0;
+		for (BMLeafNode *node : nodes) max_id = std::max<int>(max_id, node->idx());
+		if (max_id >= static_cast<int>(buffers.size())) buffers.resize(max_id + 1);
+
+		tbb::parallel_for(static_cast<size_t>(0), nodes.size(), [&](size_t i)
+		{
+			BMLeafNode *node = nodes[i];
+			const BMFaceVector &faces = node->faces();
+			std::vector<float> &buffer = buffers[node->idx()];
+			buffer.resize(faces.size() * 3 * 6);
+
+			float *data = buffer.data();
+			for (size_t f = 0; f < faces.size(); ++f){
+				BMFace *face = faces[f];
+				if (face->len != 3)
+					continue;
+				BMLoop *l_iter, *l_first;
+				l_iter = l_first = BM_FACE_FIRST_LOOP(face);
+				do{
+					memcpy(data, l_iter->v->co.data(), 3 * sizeof(float));
+					memcpy(data + 3, face->no.data(), 3 * sizeof(float));
+					data += 6;
+				} while ((l_iter = l_iter->next) != l_first);
+			}
+		});
+	}
+
+	void data_load(StrokeData &data, const StrokeRecord::Stroke &stroke, const StrokeRecord::Sample &sample)
+	{
+		const StrokeDab &dab = sample.dab;
+		data.cur_pos		= dab.cur_pos;
+		data.last_pos		= dab.last_pos;
+		data.grab_delta		= dab.grab_delta;
+		data.view_dir		= dab.view_dir;
+		data.world_radius	= dab.world_radius;
+		data.max_edge_len	= dab.max_edge_len;
+		data.min_edge_len	= dab.min_edge_len;
+		data.rotate_angle	= sample.rotate_angle;
+		data.first_hit_pos	= stroke.first_hit_pos;
+	}
+
+	/*replay one stroke. dabs are applied at their recorded positions so that every run does the same work,
+	the recorded rays are still picked to measure picking*/
+	void stroke_replay(StrokeData &data, BezierCurve &curve, const StrokeRecord::Stroke &stroke,
+		StrokeProfile &profile, std::vector<std::vector<float>> &buffers)
+	{
+		curve.reset(static_cast<VbsDef::CURVE>(stroke.falloff));
+		data.brush_type		= stroke.brush_type;
+		data.flag			= stroke.flag;
+		data.sym_flag		= stroke.sym_flag;
+		data.smooth_iterations = stroke.smooth_iterations;
+		data.brush_strength = stroke.brush_strength;
+		data.pinch_factor	= stroke.pinch_factor;
+		data.scale			= stroke.scale;
+		data.edge_len_unit_threshold = stroke.edge_len_unit_threshold;
+		data.first_hit_pos	= stroke.first_hit_pos;
+		data.last_pos		= stroke.first_hit_pos;
+
+		data.bvh->sculpt_stroke_begin_update();
+		SculptStroke sstroke(&data);
+
+		for (auto it = stroke.segments.begin(); it != stroke.segments.end(); ++it){
+			const StrokeRecord::Segment &segment = *it;
+			profile.step_begin(segment.samples.size());
+			if (segment.schedule.scheduled){
+				profile.schedule_set(segment.schedule);
+			}
+
+			{
+				StrokeProfile::Scope scope(&profile, StrokeProfile::PHASE_PICK);
+				if (!segment.single){
+					Vector3f hit;
+					const bool origin = (data.flag & PICK_ORIGINAL_LOCATION) != 0;
+					for (auto sit = segment.samples.begin(); sit != segment.samples.end(); ++sit){
+						isect_ray_bm_bvh_nearest_hit_cached(data.bvh, sit->ray_org, sit->ray_dir, origin, hit, 1.0e-6);
+					}
+				}
+			}
+
+			if (segment.single){
+				data_load(data, stroke, segment.samples.front());
+				sstroke.add_step(false);
+			}
+			else{
+				std::vector<StrokeDab> dabs;
+				dabs.reserve(segment.samples.size());
+				for (auto sit = segment.samples.begin(); sit != segment.samples.end(); ++sit){
+					dabs.push_back(sit->dab);
+				}
+				data_load(data, stroke, segment.samples.back());
+				sstroke.add_steps(dabs);
+			}
+
+			StrokeProfile::Scope scope(&profile, StrokeProfile::PHASE_BUFFER);
+			buffer_prepare(data.bvh, buffers);
+		}
+
+		sstroke.finish_stroke();
+	}
+
+	/*draw brush of a multires level: a dab pushes the surface toward the viewer*/
+	struct MultiresDrawKernel
+	{
+		Vector3f offset; /*at the dab center*/
+		Vector3f operator()(const Vector3f &co, float dist, float falloff) const { return offset * falloff; }
+	};
+
+	/*replay one stroke on the active level of a multires mesh. the coarsest level is read after each segment,
+	as the renderer would for far away leaves, which restricts the edits to it*/
+	void stroke_replay_multires(VSculptMultires &multires, BezierCurve &curve, const StrokeRecord::Stroke &stroke,
+		StrokeProfile &profile)
+	{
+		curve.reset(static_cast<VbsDef::CURVE>(stroke.falloff));
+
+		MultiresDrawKernel kernel;
+		for (auto it = stroke.segments.begin(); it != stroke.segments.end(); ++it){
+			const StrokeRecord::Segment &segment = *it;
+			profile.step_begin(segment.samples.size());
+			if (segment.schedule.scheduled){
+				profile.schedule_set(segment.schedule);
+			}
+
+			{
+				StrokeProfile::Scope scope(&profile, StrokeProfile::PHASE_BRUSH);
+				for (auto sit = segment.samples.begin(); sit != segment.samples.end(); ++sit){
+					const StrokeDab &dab = sit->dab;
+					kernel.offset = dab.view_dir * (0.1f * stroke.brush_strength * dab.world_radius);
+					multires.deform(dab.cur_pos, dab.world_radius, &curve, kernel);
+				}
+			}
+
+			StrokeProfile::Scope scope(&profile, StrokeProfile::PHASE_BUFFER);
+			multires.level(0);
+		}
+	}
+
+	std::string json_escape(const std::string &str)
+	{
+		std::string out;
+		for (char c : str){
+			if (c == '"' || c == '\\') out.push_back('\\');
+			out.push_back(c);
+		}
+		return out;
+	}
+
+	bool result_write(const std::string &path, const std::string &mesh_path, BMesh *bm, BMBvh *bvh, int threads,
+		const std::vector<std::string> &records, int repeat, int multires, const StrokeProfile &profile)
+	{
+		FILE *file = path.empty() ? stdout : fopen(path.c_str(), "w");
+		if (!file)
+			return false;
+
+		const std::vector<StrokeProfile::Step> &steps = profile.steps();
+		double totals[StrokeProfile::PHASE_TOTAL] = { 0.0 };
+		size_t totdab = 0, totnode = 0, totscheduled = 0, totdeferred = 0;
+		for (auto it = steps.begin(); it != steps.end(); ++it){
+			for (int p = 0; p < StrokeProfile::PHASE_TOTAL; ++p) totals[p] += it->seconds[p];
+			totdab += it->totdab;
+			totnode += it->totnode;
+			if (it->schedule.scheduled){
+				totscheduled++;
+				if (it->schedule.topology_deferred) totdeferred++;
+			}
+		}
+
+		fprintf(file, "{\n");
+		fprintf(file, "  \"threads\": %d,\n", threads);
+		fprintf(file, "  \"mesh\": { \"file\": \"%s\", \"verts\": %llu, \"faces\": %llu, \"leaf_nodes\": %llu },\n",
+			json_escape(mesh_path).c_str(), (unsigned long long)bm->BM_mesh_verts_total(),
+			(unsigned long long)bm->BM_mesh_faces_total(), (unsigned long long)bvh->leafNodes().size());
+		fprintf(file, "  \"records\": [");
+		for (size_t i = 0; i < records.size(); ++i){
+			fprintf(file, "%s\"%s\"", i ? ", " : "", json_escape(records[i]).c_str());
+		}
+		fprintf(file, "],\n");
+		fprintf(file, "  \"repeat\": %d,\n", repeat);
+		fprintf(file, "  \"multires_level\": %d,\n", multires);
+		fprintf(file, "  \"dabs\": %llu,\n", (unsigned long long)totdab);
+		fprintf(file, "  \"leaf_nodes_touched\": %llu,\n", (unsigned long long)totnode);
+		fprintf(file, "  \"scheduled_ranges\": %llu,\n", (unsigned long long)totscheduled);
+		fprintf(file, "  \"topology_deferred_ranges\": %llu,\n", (unsigned long long)totdeferred);
+
+		fprintf(file, "  \"total_seconds\": {");
+		for (int p = 0; p < StrokeProfile::PHASE_TOTAL; ++p){
+			fprintf(file, "%s\"%s\": %.9f", p ? ", " : " ", StrokeProfile::phase_name(p), totals[p]);
+		}
+		fprintf(file, " },\n");
+
+		fprintf(file, "  \"seconds_per_dab\": {");
+		for (int p = 0; p < StrokeProfile::PHASE_TOTAL; ++p){
+			fprintf(file, "%s\"%s\": %.9f", p ? ", " : " ", StrokeProfile::phase_name(p), totdab ? totals[p] / totdab : 0.0);
+		}
+		fprintf(file, " },\n");
+
+		fprintf(file, "  \"steps\": [\n");
+		for (size_t i = 0; i < steps.size(); ++i){
+			const StrokeProfile::Step &step = steps[i];
+			fprintf(file, "    { \"dabs\": %llu, \"nodes\": %llu", (unsigned long long)step.totdab, (unsigned long long)step.totnode);
+			for (int p = 0; p < StrokeProfile::PHASE_TOTAL; ++p){
+				fprintf(file, ", \"%s\": %.9f", StrokeProfile::phase_name(p), step.seconds[p]);
+			}
+			/*the decision the app took for this range while it was recorded*/
+			const StrokeProfile::Schedule &schedule = step.schedule;
+			if (schedule.scheduled){
+				fprintf(file, ", \"schedule\": { \"spacing\": %.9g, \"topology_deferred\": %s, \"estimate\": %.9f, \"seconds\": %.9f }",
+					schedule.spacing, schedule.topology_deferred ? "true" : "false", schedule.estimate, schedule.seconds);
+			}
+			fprintf(file, " }%s\n", i + 1 < steps.size() ? "," : "");
+		}
+		fprintf(file, "  ]\n}\n");
+
+		if (file != stdout) fclose(file);
+		return true;
+	}
+
+	/*a failed append must leave no frame behind: the next record starts where the failed one did.
+	released records are dropped by trim, by truncation when none is live, by compaction when most bytes are dead*/
+	bool journal_check()
+	{
+		const uint64_t header = 3 * sizeof(uint32_t);
+		VSculptUndoJournal journal;
+		if (!journal.open(VSculptUndoJournal::default_path())){
+			fprintf(stderr, "journal check: can not open the journal\n");
+			return false;
+		}
+
+		const std::vector<uint8_t> first(4096, 1), second(256, 2);
+		std::vector<uint8_t> back;
+		VSculptUndoJournal::Record record = 0, other = 0;
+
+		journal.append_fail_next();
+		if (journal.append(first, record) || journal.file_size() != 0){
+			fprintf(stderr, "journal check: failed append changed the journal\n");
+			return false;
+		}
+
+		if (!journal.append(second, record) || journal.file_size() != header + second.size() ||
+			!journal.read(record, back) || back != second)
+		{
+			fprintf(stderr, "journal check: append after a failed append is not readable\n");
+			return false;
+		}
+
+		if (!journal.append(first, other) || !journal.read(other, back) || back != first){
+			fprintf(stderr, "journal check: append over a partial frame is not readable\n");
+			return false;
+		}
+
+		if (!journal.matches(other, first) || journal.matches(other, second)){
+			fprintf(stderr, "journal check: record match is wrong\n");
+			return false;
+		}
+
+		journal.release(record);
+		journal.release(other);
+		journal.trim();
+		if (journal.file_size() != 0 || journal.read(other, back)){
+			fprintf(stderr, "journal check: trim did not truncate a journal without live records\n");
+			return false;
+		}
+
+		/*over 64 MB dead in front of one live record*/
+		const std::vector<uint8_t> big(size_t(1) << 20, 3);
+		for (int i = 0; i < 70; ++i){
+			if (!journal.append(big, record)){
+				fprintf(stderr, "journal check: can not fill the journal\n");
+				return false;
+			}
+			if (i < 69) journal.release(record);
+		}
+		journal.trim();
+		if (journal.file_size() != header + big.size() || !journal.read(record, back) || back != big){
+			fprintf(stderr, "journal check: compaction lost the live record\n");
+			return false;
+		}
+		return true;
+	}
+
+	struct MultiresOffsetKernel
+	{
+		Vector3f offset;
+		Vector3f operator()(const Vector3f &co, float dist, float falloff) const { return offset; }
+	};
+
+	bool multires_level_z(VSculptMultires &multires, int l, float z)
+	{
+		const VSculptMultires::Level &lv = multires.level(l);
+		for (size_t k = 0; k < lv.pz.size(); ++k){
+			if (std::abs(lv.pz[k] - z) > 1.0e-5f)
+				return false;
+		}
+		return true;
+	}
+
+	/*an edit of a level moves the coinciding vertices of the coarser levels and carries the finer levels with it*/
+	bool multires_check()
+	{
+		BMesh bm;
+		BMVert *v0 = bm.BM_vert_create(Vector3f(0.0f, 0.0f, 0.0f), nullptr, BM_CREATE_NOP);
+		BMVert *v1 = bm.BM_vert_create(Vector3f(1.0f, 0.0f, 0.0f), nullptr, BM_CREATE_NOP);
+		BMVert *v2 = bm.BM_vert_create(Vector3f(0.0f, 1.0f, 0.0f), nullptr, BM_CREATE_NOP);
+		bm.BM_face_create_quad_tri(v0, v1, v2, nullptr, nullptr, BM_CREATE_NOP);
+
+		BezierCurve curve;
+		MultiresOffsetKernel kernel;
+		VSculptMultires multires(&bm, 3);
+
+		multires.set_active_level(2);
+		kernel.offset = Vector3f(0.0f, 0.0f, 0.5f);
+		multires.deform(Vector3f(0.3f, 0.3f, 0.0f), 10.0f, &curve, kernel);
+		if (!multires_level_z(multires, 0, 0.5f) || !multires_level_z(multires, 1, 0.5f) || !multires_level_z(multires, 2, 0.5f)){
+			fprintf(stderr, "multires check: an edit of the finest level is not restricted to the coarser levels\n");
+			return false;
+		}
+
+		multires.set_active_level(0);
+		kernel.offset = Vector3f(0.0f, 0.0f, 0.25f);
+		multires.deform(Vector3f(0.3f, 0.3f, 0.0f), 10.0f, &curve, kernel);
+		if (!multires_level_z(multires, 1, 0.75f) || !multires_level_z(multires, 2, 0.75f)){
+			fprintf(stderr, "multires check: an edit of the base level does not carry the finer levels\n");
+			return false;
+		}
+		return true;
+	}
+
+	/*closed sphere with a radius that varies per vertex, so no two edges collapse at the same cost*/
+	BMesh* decimate_reference_mesh()
+	{
+		const int rings = 24, segments = 48;
+		const float pi = 3.14159265f;
+		BMesh *bm = new BMesh();
+		std::vector<BMVert*> verts;
+		unsigned seed = 12345;
+		for (int r = 1; r < rings; ++r){
+			for (int s = 0; s < segments; ++s){
+				seed = seed * 1664525u + 1013904223u;
+				const float radius = 1.0f + 0.05f * static_cast<float>(seed >> 8) / static_cast<float>(1 << 24);
+				const float theta = pi * r / rings, phi = 2.0f * pi * s / segments;
+				verts.push_back(bm->BM_vert_create(radius * Vector3f(std::sin(theta) * std::cos(phi), std::sin(theta) * std::sin(phi), std::cos(theta)), nullptr, BM_CREATE_NOP));
+			}
+		}
+		BMVert *north = bm->BM_vert_create(Vector3f(0.0f, 0.0f, 1.0f), nullptr, BM_CREATE_NOP);
+		BMVert *south = bm->BM_vert_create(Vector3f(0.0f, 0.0f, -1.0f), nullptr, BM_CREATE_NOP);
+
+		for (int s = 0; s < segments; ++s){
+			const int t = (s + 1) % segments;
+			bm->BM_face_create_quad_tri(north, verts[s], verts[t], nullptr, nullptr, BM_CREATE_NOP);
+			for (int r = 0; r + 2 < rings; ++r){
+				BMVert *a = verts[r * segments + s], *b = verts[(r + 1) * segments + s];
+				BMVert *c = verts[(r + 1) * segments + t], *d = verts[r * segments + t];
+				bm->BM_face_create_quad_tri(a, b, c, nullptr, nullptr, BM_CREATE_NOP);
+				bm->BM_face_create_quad_tri(a, c, d, nullptr, nullptr, BM_CREATE_NOP);
+			}
+			bm->BM_face_create_quad_tri(south, verts[(rings - 2) * segments + t], verts[(rings - 2) * segments + s], nullptr, nullptr, BM_CREATE_NOP);
+		}
+		bm->BM_mesh_normals_update();
+		return bm;
+	}
+
+	/*the decimator pops the same edges from VIndexedHeap as from the fibonacci heap it used before, with correctly ordered cost updates,
+	so it collapses the same mesh*/
+	bool decimate_check()
+	{
+		std::unique_ptr<BMesh> bm(decimate_reference_mesh());
+		const size_t totface = bm->BM_mesh_faces_total();
+
+		EdgeQueueStream stream;
+		stream.totid = bm->BM_mesh_edges_total();
+		BMeshDecimate op(bm.get());
+		op.setRatio(0.25f);
+		op.setRecorder(&stream);
+		op.run();
+
+		if (bm->BM_mesh_faces_total() > static_cast<size_t>(std::ceil(totface * 0.25f))){
+			fprintf(stderr, "decimate check: the reference mesh is not decimated to the ratio\n");
+			return false;
+		}
+		if (!BMeshEdgeQueueBench::replay_matches(stream)){
+			fprintf(stderr, "decimate check: the edge queue pops differ from the fibonacci heap\n");
+			return false;
+		}
+		return true;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	std::string mesh_path, out_path;
+	std::vector<std::string> record_paths;
+	int repeat = 1, multires_level = 0;
+	if (argc == 2 && strcmp(argv[1], "-check") == 0){
+		bool ok = journal_check();
+		ok = multires_check() && ok;
+		ok = decimate_check() && ok;
+		printf("self checks %s\n", ok ? "passed" : "failed");
+		return ok ? 0 : 1;
+	}
+
+	for (int i = 1; i < argc; ++i){
+		if (strcmp(argv[i], "-o") == 0 && i + 1 < argc){
+			out_path = argv[++i];
+		}
+		else if (strcmp(argv[i], "-repeat") == 0 && i + 1 < argc){
+			repeat = std::max<int>(1, atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "-multires") == 0 && i + 1 < argc){
+			multires_level = std::max<int>(0, atoi(argv[++i]));
+		}
+		else if (mesh_path.empty()){
+			mesh_path = argv[i];
+		}
+		else{
+			record_paths.push_back(argv[i]);
+		}
+	}
+
+	if (mesh_path.empty() || record_paths.empty()){
+		fprintf(stderr, "usage: SculptBench <mesh> <record> [record...] [-o result.json] [-repeat n] [-multires level]\n");
+		return 1;
+	}
+
+	std::vector<StrokeRecord> records(record_paths.size());
+	for (size_t i = 0; i < record_paths.size(); ++i){
+		if (!records[i].load(record_paths[i])){
+			fprintf(stderr, "can not read stroke record %s\n", record_paths[i].c_str());
+			return 1;
+		}
+	}
+
+	tbb::task_scheduler_init scheduler;
+	const int threads = tbb::task_scheduler_init::default_num_threads();
+
+	StrokeProfile profile;
+	BMesh *bm = nullptr;
+	BMBvh *bvh = nullptr;
+	for (int r = 0; r < repeat; ++r){
+		/*every run starts from the mesh on disk*/
+		delete bvh; bvh = nullptr;
+		delete bm;
+		bm = mesh_import(mesh_path);
+		if (!bm){
+			fprintf(stderr, "can not read mesh %s\n", mesh_path.c_str());
+			return 1;
+		}
+
+		bm->BM_mesh_elem_table_ensure(BM_FACE | BM_VERT, true);
+		BMeshBvhBuilder builder(bm);
+		bvh = builder.build();
+
+		BezierCurve curve;
+		StrokeData data = StrokeData();
+		data.scene = nullptr;
+		data.object = nullptr;
+		data.undo_redo_logger = nullptr;
+		data.bvh = bvh;
+		data.bm = bm;
+		data.deform_curve = &curve;
+		data.profile = &profile;
+
+		std::vector<std::vector<float>> buffers;
+		std::unique_ptr<VSculptMultires> multires;
+		if (multires_level > 0){
+			multires.reset(new VSculptMultires(bm, multires_level + 1));
+			multires->set_active_level(multires_level);
+		}
+
+		for (auto rit = records.begin(); rit != records.end(); ++rit){
+			const std::vector<StrokeRecord::Stroke> &strokes = rit->strokes();
+			for (auto sit = strokes.begin(); sit != strokes.end(); ++sit){
+				if (multires)
+					stroke_replay_multires(*multires, curve, *sit, profile);
+				else
+					stroke_replay(data, curve, *sit, profile, buffers);
+			}
+		}
+	}
+
+	bool ok = result_write(out_path, mesh_path, bm, bvh, threads, record_paths, repeat, multires_level, profile);
+
+	delete bvh;
+	delete bm;
+	return ok ? 0 : 1;
+}
@@ -29,12 +29,12 @@ bool isect_ray_bm_face(BMFace *face, const Vector3f &org, const Vector3f &dir, f
 	}
 }
 
-int isect_ray_backup_tris_nearest_hit(BMFaceBackup *faces, size_t num, const Vector3f &org, const Vector3f &dir, float &hitLambda, const float &epsilon)
+int isect_ray_backup_tris_nearest_hit(const BMFaceBackup *faces, size_t num, const Vector3f &org, const Vector3f &dir, float &hitLambda, const float &epsilon)
 {
 	float minLambda = FLT_MAX, lambda;
 	int hitidx = -1;
 	for (size_t i = 0; i < num; i++){
-		BMFaceBackup &f = faces[i];
+		const BMFaceBackup &f = faces[i];
 		if (MathGeom::isect_ray_tri_epsilon_v3(org, dir, f.vcoods[0], f.vcoods[1], f.vcoods[2], &lambda, nullptr, epsilon, true) &&
 			lambda < minLambda)
 		{
@@ -67,38 +67,124 @@ int isect_ray_bm_faces_nearest_hit(BMFace * const *faces, size_t num, const Vect
 	return hitidx;
 }
 
+/*ray against a face at its coordinates from stroke start*/
+static bool isect_ray_bm_face_org(const BMBvh *bvh, BMFace *face, const Vector3f &org, const Vector3f &dir, float &lambda, float uv[2], const float &epsilon, bool test_cull)
+{
+	BLI_assert(face->len == 3);
+	BMVert *verts[3];
+	BM_face_as_array_vert_tri(face, verts);
+	return MathGeom::isect_ray_tri_epsilon_v3(
+		org, dir, bvh->vert_org_co(verts[0]), bvh->vert_org_co(verts[1]), bvh->vert_org_co(verts[2]), &lambda, uv, epsilon, test_cull);
+}
+
+/*shrink ray.tfar if the leaf node has a closer hit*/
+static bool isect_ray_leaf_node_nearest_hit(const BMBvh *bvh, BMLeafNode *lnode, Ray &ray, bool origin_data, const float epsilon)
+{
+	float hitLambda;
+	if (origin_data && lnode->originData()){
+		/*faces of the node at stroke start: the remaining original faces and the logged removed ones*/
+		OriginLeafNodeData *orgnode = lnode->originData();
+		bool hit = false;
+		int hitidx = isect_ray_backup_tris_nearest_hit(orgnode->_faces.data(), orgnode->_faces.size(), ray.org, ray.dir, hitLambda, epsilon);
+		if (hitidx != -1 && hitLambda < ray.tfar){
+			ray.tfar = hitLambda;
+			ray.prim = reinterpret_cast<size_t>(orgnode->_faces[hitidx].face);
+			ray.hit = hit = true;
+		}
+
+		const BMFaceVector &faces = lnode->faces();
+		const size_t totface = faces.size();
+		for (size_t i = 0; i < totface; ++i){
+			BMFace *f = faces[i];
+			if (bvh->face_org_exists(f) &&
+				isect_ray_bm_face_org(bvh, f, ray.org, ray.dir, hitLambda, nullptr, epsilon, true) && 
+				hitLambda < ray.tfar)
+			{
+				ray.tfar = hitLambda;
+				ray.prim = reinterpret_cast<size_t>(f);
+				ray.hit = hit = true;
+			}
+		}
+		return hit;
+	}
+	else{
+		int hitidx = isect_ray_bm_faces_nearest_hit(lnode->faces().data(), lnode->faces().size(), ray.org, ray.dir, hitLambda, epsilon);
+		if (hitidx != -1 && hitLambda < ray.tfar){
+			ray.tfar = hitLambda;
+			ray.prim = reinterpret_cast<size_t>(lnode->faces()[hitidx]);
+			ray.hit = true;
+			return true;
+		}
+	}
+	return false;
+}
+
 bool isect_ray_bm_bvh_nearest_hit(const BMBvh *bvh, const Vector3f &org, const Vector3f dir, bool origin_data, Vector3f &hit, const float epsilon)
 {
 	Ray ray(org, dir, origin_data);
 	VBvhRayIterator<BMLeafNode> iter(bvh->rootNode(), &ray);
-	BMFace *hitFace;
-	float   hitLambda;
 
 	for (; iter; ++iter){
-		BMLeafNode *lnode = *iter;
-		hitFace = nullptr;
+		isect_ray_leaf_node_nearest_hit(bvh, *iter, ray, origin_data, epsilon);
+	}
 
-		if (origin_data && lnode->originData()){
-			OriginLeafNodeData *orgnode = lnode->originData();
-			int hitidx = isect_ray_backup_tris_nearest_hit(orgnode->_faces, orgnode->_totfaces, org, dir, hitLambda, epsilon);
-			if (hitidx != -1 && hitLambda < ray.tfar){
-				ray.tfar = hitLambda;
-				ray.prim = reinterpret_cast<size_t>(orgnode->_faces[hitidx].face);
-				ray.hit = true;
-			}
+	if (ray.hit){
+		hit = ray.org + ray.tfar * ray.dir;
+		return true;
+	}
+	else{
+		return false;
+	}
+}
+
+/*same result as isect_ray_bm_bvh_nearest_hit. 
+test the leaf node hit by the last pick and its siblings first, then traverse the rest of the tree 
+with the hit distance found so far, which prunes nearly all of it for coherent rays*/
+bool isect_ray_bm_bvh_nearest_hit_cached(const BMBvh *bvh, const Vector3f &org, const Vector3f dir, bool origin_data, Vector3f &hit, const float epsilon)
+{
+	BMBvhPickCache &cache = bvh->pick_cache();
+	BaseNode *root = bvh->rootNode();
+	BMLeafNode *leaf = cache.leaf;
+	BaseNode *ancestor = leaf ? leaf->parent() : nullptr;
+	BMLeafNode *hitleaf = nullptr;
+	bool ancestor_hit = false;
+
+	Ray ray(org, dir, origin_data);
+	
+	cache.tot_pick++;
+
+	if (leaf){
+		if (isect_ray_leaf_node_nearest_hit(bvh, leaf, ray, origin_data, epsilon)){
+			hitleaf = leaf;
 		}
-		else{
-			int hitidx = isect_ray_bm_faces_nearest_hit(lnode->faces().data(), lnode->faces().size(), org, dir, hitLambda, epsilon);
-			if (hitidx != -1  && hitLambda < ray.tfar){
-				ray.tfar = hitLambda;
-				ray.prim = reinterpret_cast<size_t>(lnode->faces()[hitidx]);
-				ray.hit = true;
+
+		for (VBvhRayIterator<BMLeafNode> iter(ancestor, &ray, leaf); iter; ++iter){
+			if (isect_ray_leaf_node_nearest_hit(bvh, *iter, ray, origin_data, epsilon)){
+				hitleaf = *iter;
+				ancestor_hit = true;
 			}
 		}
+	}
 
+	if (ancestor != root){
+		for (VBvhRayIterator<BMLeafNode> iter(root, &ray, ancestor); iter; ++iter){
+			if (isect_ray_leaf_node_nearest_hit(bvh, *iter, ray, origin_data, epsilon)){
+				hitleaf = *iter;
+				ancestor_hit = false;
+			}
+		}
 	}
 
+	if (leaf && hitleaf == leaf)
+		cache.tot_leaf_hit++;
+	else if (ancestor_hit)
+		cache.tot_ancestor_hit++;
+	else
+		cache.tot_fallback++;
+
 	if (ray.hit){
+		/*keep the old leaf on a miss. the next sample is likely back on the mesh*/
+		cache.leaf = hitleaf;
 		hit = ray.org + ray.tfar * ray.dir;
 		return true;
 	}
@@ -120,10 +206,9 @@ bool isect_ray_bm_bvh_all_hit(
 		BMLeafNode *lnode = *iter;
 		if (origin_data && lnode->originData()){
 			OriginLeafNodeData *orgnode = lnode->originData();
-			BMFaceBackup *faces = orgnode->_faces;
-			const size_t totface = orgnode->_totfaces;
-			for (size_t i = 0; i < totface; ++i){
-				BMFaceBackup &fbacup = faces[i];
+			const std::vector<BMFaceBackup> &orgfaces = orgnode->_faces;
+			for (auto it = orgfaces.begin(); it != orgfaces.end(); ++it){
+				const BMFaceBackup &fbacup = *it;
 				if (MathGeom::isect_ray_tri_epsilon_v3(
 					org, dir, fbacup.vcoods[0], fbacup.vcoods[1], fbacup.vcoods[2], &hit_dst, uv.data(), epsilon, false)){
 					
@@ -135,6 +220,20 @@ bool isect_ray_bm_bvh_all_hit(
 				}
 			}
 
+			const BMFaceVector &faces = lnode->faces();
+			const size_t totface = faces.size();
+			for (size_t i = 0; i < totface; ++i){
+				if (bvh->face_org_exists(faces[i]) &&
+					isect_ray_bm_face_org(bvh, faces[i], org, dir, hit_dst, uv.data(), epsilon, false)){
+
+					if (hitpoints) hitpoints->push_back(ray.org + hit_dst * ray.dir);
+					if (hitfaces) hitfaces->push_back(faces[i]);
+					if (hituvs) hituvs->push_back(uv);
+
+					ray.hit = true;
+				}
+			}
+
 			ray.tfar = FLT_MAX; /*always recur to all possible leaf nodes*/
 		}
 		else{
@@ -179,6 +278,21 @@ bool isect_sphere_bm_bvh(const BMBvh *bvh, const Vector3f &center, const float &
 	return !leafs.empty();
 }
 
+bool isect_box_bm_bvh(const BMBvh *bvh, const Eigen::AlignedBox3f &box, std::vector<BMLeafNode*> &leafs)
+{
+	using std::placeholders::_1;
+
+	const BoxIsectFunctor functor(box);
+	VBvhIterator<BMLeafNode>::IsectFunc isect = std::bind(&BoxIsectFunctor::isect, functor, _1);
+
+	VBvhIterator<BMLeafNode> iter(bvh->rootNode(), isect);
+	for (; iter; ++iter){
+		leafs.push_back(*iter);
+	}
+
+	return !leafs.empty();
+}
+
 bool isect_box_tube_bm_bvh(const BMBvh *bvh, const Eigen::Vector4f (*plane)[4], std::vector<BMLeafNode*> &leafs)
 {
 	using std::placeholders::_1;
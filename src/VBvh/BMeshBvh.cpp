@@ -3,22 +3,79 @@
 #include "VBvhUtil.h"
 #include "BaseLib/UtilMacro.h"
 #include "VBvh/BMeshBvhNodeSplitter.h"
+#include "VBvh/BMeshBvhOptimizer.h"
 #include <tbb/mutex.h>
 //extern std::vector<Point3Dd> g_vscene_testSegments;
 
 VBVH_BEGIN_NAMESPACE
 
+tbb::spin_mutex	   LeafBlockPool::_mutex;
+std::vector<void*> LeafBlockPool::_free[LeafBlockPool::CLASSES];
+
+void* LeafBlockPool::alloc(size_t bytes)
+{
+	if (bytes > CLASSES * GRANULE)
+		return scalable_malloc(bytes);
+
+	const size_t c = class_get(bytes);
+	tbb::spin_mutex::scoped_lock lock(_mutex);
+	std::vector<void*> &blocks = _free[c];
+	if (blocks.empty()){
+		/*hand out the blocks of a new slab in address order*/
+		const size_t block_bytes = (c + 1) * GRANULE;
+		const size_t totblock = SLAB_BYTES / block_bytes;
+		char *slab = reinterpret_cast<char*>(scalable_malloc(block_bytes * totblock));
+		for (size_t i = totblock; i-- > 0;)
+			blocks.push_back(slab + i * block_bytes);
+	}
+
+	void *p = blocks.back();
+	blocks.pop_back();
+	return p;
+}
+
+void LeafBlockPool::free(void *p, size_t bytes)
+{
+	if (bytes > CLASSES * GRANULE){
+		scalable_free(p);
+		return;
+	}
+
+	tbb::spin_mutex::scoped_lock lock(_mutex);
+	_free[class_get(bytes)].push_back(p);
+}
+
+/*a connected patch of n triangles has at most n + 2 vertices, a few more for leaf nodes with several patches*/
+static size_t leaf_vert_reserve(size_t totface)
+{
+	return totface + LEAF_INLINE_VERTS;
+}
+
 BMBvh::BMBvh(BMesh *bm, BaseNode *root, std::vector<BMLeafNode*> &leafs)
 	:
 	_root(root),
 	_leafs(leafs),
-	_dirty(true)
+	_dirty(true),
+	_optimizer(nullptr),
+	_fused_group(false),
+	_org_stamp(0),
+	_org_active(false)
 {
+	_modify_stamp = 0;
 	_bmesh.bm = bm;
-	_bmesh.cd_fnode = 0; 	
-	_bmesh.cd_foff = 1;
-	_bmesh.cd_vnode = 0;
-	_bmesh.cd_voff = 1;
+	_bmesh.cd_fnode = BVH_AUX_NODE;
+	_bmesh.cd_foff = BVH_AUX_OFF;
+	_bmesh.cd_fstamp = BVH_AUX_STAMP_F;
+	_bmesh.cd_vnode = BVH_AUX_NODE;
+	_bmesh.cd_voff = BVH_AUX_OFF;
+	_bmesh.cd_vorg = BVH_AUX_ORG;
+	_bmesh.cd_vstamp = BVH_AUX_STAMP_V;
+
+	_pick_cache.leaf = nullptr;
+	_pick_cache.tot_pick = 0;
+	_pick_cache.tot_leaf_hit = 0;
+	_pick_cache.tot_ancestor_hit = 0;
+	_pick_cache.tot_fallback = 0;
 
 	leaf_node_indexing(_leafs);
 	leaf_node_faces_add_referece(_leafs);
@@ -27,6 +84,8 @@ BMBvh::BMBvh(BMesh *bm, BaseNode *root, std::vector<BMLeafNode*> &leafs)
 
 BMBvh::~BMBvh()
 {
+	/*worker must not outlive the tree*/
+	delete _optimizer;
 	node_free_recur(_root);
 }
 
@@ -61,7 +120,7 @@ void BMBvh::leaf_node_collect_vert_from_face()
 
 			BMLoop *l_iter, *l_first;
 			size_t vindex;
-			lnode->_verts.reserve(lnode->_faces.size() * 3);
+			lnode->_verts.reserve(leaf_vert_reserve(lnode->_faces.size()));
 			for (auto it = lnode->_faces.begin(); it != lnode->_faces.end(); ++it){
 				BMFace *f = *it;
 				l_iter = l_first = BM_FACE_FIRST_LOOP(f);
@@ -118,7 +177,7 @@ void BMBvh::leaf_node_collect_vert_from_face(std::vector<BMLeafNode*> &nodes)
 		
 		const BMFaceVector &faces = node->_faces;
 		const size_t totface = faces.size();
-		node->_verts.reserve(totface * 2);
+		node->_verts.reserve(leaf_vert_reserve(totface));
 		for (size_t i = 0; i < totface; ++i){
 			BMFace *f = faces[i];
 			BMLoop *l_first, *l_iter;
@@ -148,6 +207,7 @@ void BMBvh::bvh_marked_leaf_nodes_bb_update()
 	if (!nodes.empty()){
 
 		bvh_set_dirty(true);
+		_modify_stamp++;
 		
 		tbb::parallel_for(static_cast<size_t>(0), nodes.size(), [&](size_t index){
 			BMLeafNode* node = nodes[index];
@@ -224,6 +284,7 @@ BBox3fa BMBvh::node_refit_recur(BaseNode *bnode, bool barrier)
 
 void BMBvh::bvh_full_update_bb_redraw()
 {
+	bvh_optimize_end();
 	bvh_set_dirty(true);
 
 	for (auto it = _leafs.begin(); it != _leafs.end(); ++it){
@@ -272,47 +333,13 @@ void BMBvh::leaf_node_org_data_save(BMLeafNode *node)
 
 	node->setAppFlagBit(LEAF_ORIGIN_DATA_SAVED);
 
+	/*faces and vertices are logged when they are modified*/
 	OriginLeafNodeData *data = new OriginLeafNodeData();
 
 	const auto &bb = node->bounds();
 	data->lower = Vector3f(bb.lower.x, bb.lower.y, bb.lower.z);
 	data->upper = Vector3f(bb.upper.x, bb.upper.y, bb.upper.z);
 
-	const BMFaceVector &faces = node->faces();
-	const BMVertVector &verts = node->verts();
-	const size_t totvert = verts.size();
-	const size_t totface = faces.size();
-
-	data->_totverts = totvert;
-	data->_totfaces = totface;
-
-	size_t fsize = sizeof(BMFaceBackup) * totface;
-	size_t vsize = sizeof(BMVertBackup) * totvert;
-	data->_faces = reinterpret_cast<BMFaceBackup*>(_originDataAllocator.malloc(fsize));
-	data->_verts = reinterpret_cast<BMVertBackup*>(_originDataAllocator.malloc(vsize));
-
-	BMFace *f; BMLoop *l_iter, *l_first;
-	for (size_t i = 0; i < totface; ++i){
-		f = faces[i];
-		BLI_assert(f->len == 3);
-
-		BMFaceBackup &backup = data->_faces[i];
-		backup.face = f;
-		l_first = l_iter = BM_FACE_FIRST_LOOP(f);
-		size_t cnt = 0;
-		do {
-			backup.verts[cnt]	= l_iter->v;
-			backup.vcoods[cnt]  = l_iter->v->co;
-			cnt++;
-		} while ((l_iter = l_iter->next) != l_first);
-	}
-
-	for (size_t i = 0; i < totvert; ++i){
-		BMVertBackup &backup = data->_verts[i];
-		backup.v	= verts[i];
-		backup.co	= verts[i]->co;
-	}
-
 	node->_orgData = data;
 }
 
@@ -321,11 +348,73 @@ void BMBvh::leaf_node_org_data_drop(BMLeafNode *node)
 	if (node->originData()){
 		BLI_assert(node->appFlagBit(LEAF_ORIGIN_DATA_SAVED));
 		node->unsetAppFlagBit(LEAF_ORIGIN_DATA_SAVED);
-		delete node->_orgData; /*vertex coord array and face coord array attribute will be recycled by memory pool*/
+		delete node->_orgData;
 		node->_orgData = nullptr;
 	}
 }
 
+void BMBvh::vert_org_save(BMVert *v)
+{
+	if (!_org_active)
+		return;
+
+	int &stamp = BM_elem_aux_data_int_get(v, _bmesh.cd_vstamp);
+	if (stamp == _org_stamp || stamp == -_org_stamp)
+		return;
+
+	BMVertBackup backup;
+	backup.v = v;
+	backup.co = v->co;
+	auto it = _org_verts.push_back(backup);
+	BM_elem_aux_data_int_set(v, _bmesh.cd_vorg, static_cast<int>(it - _org_verts.begin()));
+	stamp = _org_stamp;
+}
+
+const Vector3f& BMBvh::vert_org_co(BMVert *v) const
+{
+	if (_org_active && BM_elem_aux_data_int_get(v, _bmesh.cd_vstamp) == _org_stamp){
+		const int idx = BM_elem_aux_data_int_get(v, _bmesh.cd_vorg);
+		BLI_assert(idx >= 0 && idx < static_cast<int>(_org_verts.size()));
+		return _org_verts[idx].co;
+	}
+	else{
+		return v->co;
+	}
+}
+
+/*clears the stamp slot unless it belongs to the running stroke, so that a stale value can never match _org_stamp*/
+void BMBvh::vert_org_stamp_reset(BMVert *v)
+{
+	int &stamp = BM_elem_aux_data_int_get(v, _bmesh.cd_vstamp);
+	if (!_org_active || (stamp != _org_stamp && stamp != -_org_stamp))
+		stamp = 0;
+}
+
+bool BMBvh::vert_org_exists(BMVert *v) const
+{
+	return !_org_active || BM_elem_aux_data_int_get(v, _bmesh.cd_vstamp) != -_org_stamp;
+}
+
+bool BMBvh::face_org_exists(BMFace *f) const
+{
+	return !_org_active || BM_elem_aux_data_int_get(f, _bmesh.cd_fstamp) != -_org_stamp;
+}
+
+/*forget the logged vertices. every element counts as original again*/
+void BMBvh::org_data_reset()
+{
+	_org_verts.clear();
+	_org_stamp++;
+}
+
+void BMBvh::sculpt_stroke_begin_update()
+{
+	bvh_optimize_end();
+
+	org_data_reset();
+	_org_active = true;
+}
+
 void BMBvh::sculpt_stroke_step_update()
 {
 	bvh_marked_leaf_nodes_bb_update();
@@ -339,7 +428,8 @@ void BMBvh::sculpt_stroke_step_update()
 
 void BMBvh::sculpt_stroke_finish_update()
 {
-	_originDataAllocator.recycle();
+	_org_active = false;
+	_org_verts.clear();
 
 	std::vector<BMLeafNode*> bignodes; bignodes.reserve(20);
 	for (int i = 0; i < _leafs.size(); i++){
@@ -358,6 +448,107 @@ void BMBvh::sculpt_stroke_finish_update()
 
 	bvh_set_dirty(true);
 
+#ifdef _DEBUG
+	check_valid();
+#endif
+
+	bvh_optimize_begin();
+}
+
+/*start re-optimizing degraded sub-trees on a background worker. the result is swapped in by bvh_optimize_end*/
+void BMBvh::bvh_optimize_begin()
+{
+	if (!_optimizer){
+		_optimizer = new BMeshBvhOptimizer(_bmesh);
+	}
+
+	bvh_optimize_end();
+
+	_optimizer->start(_root, _modify_stamp);
+}
+
+/*must be called before the mesh or the tree is modified again. 
+sub-trees which have been rebuilt are swapped in if nothing has changed since bvh_optimize_begin, the rest are dropped*/
+void BMBvh::bvh_optimize_end()
+{
+	if (!_optimizer || !_optimizer->pending())
+		return;
+
+	_optimizer->stop();
+
+	if (_optimizer->stamp() != _modify_stamp){
+		_optimizer->clear();
+		return;
+	}
+
+	std::vector<BMLeafNode*> old_leafs, new_leafs;
+	std::vector<BaseNode*> old_roots;
+	const std::vector<BMeshBvhOptimizer::SubtreeTask*> &tasks = _optimizer->tasks();
+	for (auto it = tasks.begin(); it != tasks.end(); ++it){
+		BMeshBvhOptimizer::SubtreeTask *task = *it;
+		if (!task->done)
+			continue;
+
+		node_leafs_collect(task->node, old_leafs);
+
+		bool insertdone = task->parent->replaceChild(task->node, task->new_root);
+		BLI_assert(insertdone);
+
+		for (auto lit = task->new_leafs.begin(); lit != task->new_leafs.end(); ++lit){
+			(*lit)->setAppFlagBit(LEAF_UPDATE_STEP_DRAW_BUFFER);
+		}
+		new_leafs.insert(new_leafs.end(), task->new_leafs.begin(), task->new_leafs.end());
+		old_roots.push_back(task->node);
+
+		/*owned by the tree from now*/
+		task->new_root = nullptr;
+		task->new_leafs.clear();
+	}
+
+	_optimizer->clear();
+
+	if (new_leafs.empty())
+		return;
+
+	/*detach old leaf nodes from our leaf node array*/
+	std::vector<BMVert*> old_verts;
+	for (auto it = old_leafs.begin(); it != old_leafs.end(); ++it){
+		BMLeafNode *node = *it;
+		BLI_assert(_leafs[node->_idx] == node);
+		_leafs[node->_idx] = nullptr;
+		old_verts.insert(old_verts.end(), node->_verts.begin(), node->_verts.end());
+	}
+
+	for (auto it = old_roots.begin(); it != old_roots.end(); ++it){
+		node_free_recur(*it);
+	}
+
+	leaf_node_slots_fill(new_leafs);
+	leaf_node_slots_compact();
+
+	leaf_node_faces_add_referece(new_leafs);
+	leaf_node_collect_vert_from_face(new_leafs);
+
+	/*a vertex whose faces all belong to other leaf nodes is not collected above. attach it to the node of one of its faces*/
+	for (auto it = old_verts.begin(); it != old_verts.end(); ++it){
+		BMVert *v = *it;
+		if (!BM_elem_flag_test_bool(v, BM_ELEM_TAG)){
+			BMIter iter;
+			BMFace *f;
+			BMLeafNode *node = new_leafs.front();
+			BM_ITER_ELEM(f, &iter, v, BM_FACES_OF_VERT){
+				node = elem_leaf_node_get(f);
+				break;
+			}
+			BM_elem_flag_enable(v, BM_ELEM_TAG);
+			leaf_node_vert_add(node, v);
+		}
+	}
+
+	bvh_marked_leaf_nodes_bb_update();
+	bvh_full_refit();
+	bvh_set_dirty(true);
+
 #ifdef _DEBUG
 	check_valid();
 #endif
@@ -400,27 +591,7 @@ void BMBvh::leaf_node_split_big(std::vector<BMLeafNode*> &largenodes)
 			leaf_node_free(*it);
 		}
 
-		/*fill new leaf nodes into our leaf node array, and indexing them*/
-		size_t tot_old_nodes = _leafs.size();
-		size_t tot_new_nodes = all_new_leafs.size();
-		size_t new_node_cnt = 0;
-		for (size_t i = 0; i < tot_old_nodes; ++i){
-			if (_leafs[i] == nullptr){
-				_leafs[i] = all_new_leafs[new_node_cnt++];
-				_leafs[i]->_idx = i; /*indexing new leaf node*/
-				if (new_node_cnt >= tot_new_nodes){
-					break;
-				}
-			}
-		}
-
-		/*if we have fill all new leaf nodes, new_node_cnt must equal or greater than tot_new_nodes*/
-		if (new_node_cnt < tot_new_nodes){
-			for (size_t i = new_node_cnt; i < tot_new_nodes; ++i){
-				_leafs.push_back(all_new_leafs[i]);
-				_leafs.back()->_idx = _leafs.size() - 1;
-			}
-		}
+		leaf_node_slots_fill(all_new_leafs);
 
 #if _DEBUG
 		for (size_t i = 0; i < _leafs.size(); ++i){
@@ -435,6 +606,72 @@ void BMBvh::leaf_node_split_big(std::vector<BMLeafNode*> &largenodes)
 
 
 
+/*fill new leaf nodes into the empty slots of our leaf node array, and indexing them*/
+void BMBvh::leaf_node_slots_fill(const std::vector<BMLeafNode*> &nodes)
+{
+	/*old leaf nodes have been freed*/
+	pick_cache_reset();
+
+	size_t tot_old_nodes = _leafs.size();
+	size_t tot_new_nodes = nodes.size();
+	size_t new_node_cnt = 0;
+	for (size_t i = 0; i < tot_old_nodes && new_node_cnt < tot_new_nodes; ++i){
+		if (_leafs[i] == nullptr){
+			_leafs[i] = nodes[new_node_cnt++];
+			_leafs[i]->_idx = i; /*indexing new leaf node*/
+		}
+	}
+
+	/*no empty slot left*/
+	for (size_t i = new_node_cnt; i < tot_new_nodes; ++i){
+		_leafs.push_back(nodes[i]);
+		_leafs.back()->_idx = _leafs.size() - 1;
+	}
+}
+
+/*move the last leaf nodes into the remaining empty slots so that leaf indices stay dense. 
+moved nodes are marked for redraw since the renderer keeps one buffer per leaf index*/
+void BMBvh::leaf_node_slots_compact()
+{
+	size_t end = _leafs.size();
+	while (end > 0 && _leafs[end - 1] == nullptr) --end;
+
+	for (size_t i = 0; i < end; ++i){
+		if (_leafs[i] == nullptr){
+			BMLeafNode *node = _leafs[end - 1];
+			_leafs[end - 1] = nullptr;
+			_leafs[i] = node;
+			node->_idx = i;
+
+			const BMVertVector &verts = node->_verts;
+			const size_t totvert = verts.size();
+			for (size_t j = 0; j < totvert; ++j){
+				elem_leaf_node_set(verts[j], node);
+				vert_org_stamp_reset(verts[j]);
+			}
+			leaf_node_faces_add_referece(std::vector<BMLeafNode*>(1, node));
+
+			while (end > i && _leafs[end - 1] == nullptr) --end;
+		}
+	}
+
+	_leafs.resize(end);
+}
+
+void BMBvh::node_leafs_collect(BaseNode *node, std::vector<BMLeafNode*> &leafs)
+{
+	if (node->isLeafNode()){
+		leafs.push_back(static_cast<BMLeafNode*>(node));
+	}
+	else{
+		for (size_t i = 0; i < 4; ++i){
+			if (node->child(i)){
+				node_leafs_collect(node->child(i), leafs);
+			}
+		}
+	}
+}
+
 void BMBvh::leaf_node_vert_add(BMLeafNode *node, BMVert *v)
 {
 #ifdef BVH_NODE_ELEM_ADD_REMOVE_ASSERT
@@ -451,6 +688,7 @@ void BMBvh::leaf_node_vert_add(BMLeafNode *node, BMVert *v)
 	node->setAppFlagBit(LEAF_UPDATE_STEP_BB | LEAF_UPDATE_STEP_DRAW_BUFFER);
 	elem_leaf_node_set(v, node);
 	elem_leaf_node_offset_set(v, node->_verts.size() -1);
+	BM_elem_aux_data_int_set(v, _bmesh.cd_vstamp, _org_active ? -_org_stamp : 0);
 
 #ifdef _DEBUG
 	BLI_assert(this->elem_leaf_node_get(v) == node);
@@ -470,6 +708,8 @@ void BMBvh::leaf_node_vert_remove(BMLeafNode *node, BMVert *v, bool reset)
 	BLI_assert(found);
 #endif
 
+	vert_org_save(v);
+
 	int off = elem_leaf_node_offset_get(v);
 	node->setAppFlagBit(LEAF_UPDATE_STEP_BB | LEAF_UPDATE_STEP_DRAW_BUFFER);
 
@@ -503,9 +743,11 @@ void BMBvh::leaf_node_face_add(BMLeafNode *node, BMFace *f)
 
 	node->_faces.push_back(f);
 	node->setAppFlagBit(LEAF_UPDATE_STEP_BB | LEAF_UPDATE_STEP_DRAW_BUFFER);
+	_modify_stamp++;
 
 	elem_leaf_node_offset_set(f, node->_faces.size() -1);
 	elem_leaf_node_set(f, node);
+	BM_elem_aux_data_int_set(f, _bmesh.cd_fstamp, _org_active ? -_org_stamp : 0);
 }
 
 void BMBvh::leaf_node_face_remove(BMLeafNode *node, BMFace *f, bool reset)
@@ -520,6 +762,21 @@ void BMBvh::leaf_node_face_remove(BMLeafNode *node, BMFace *f, bool reset)
 	BLI_assert(found);
 #endif
 
+	if (_org_active && face_org_exists(f)){
+		/*log the face as it was at stroke start before it disappears from the node*/
+		BLI_assert(f->len == 3);
+		leaf_node_org_data_save(node);
+
+		BMFaceBackup backup;
+		backup.face = f;
+		BMLoop *l_iter = BM_FACE_FIRST_LOOP(f);
+		for (int i = 0; i < 3; ++i, l_iter = l_iter->next){
+			backup.verts[i]  = l_iter->v;
+			backup.vcoods[i] = vert_org_co(l_iter->v);
+		}
+		node->_orgData->_faces.push_back(backup);
+	}
+
 	int off = elem_leaf_node_offset_get(f);//BM_ELEM_CD_GET_INT(f, _bmesh.cd_foff);
 
 #ifdef _DEBUG
@@ -532,6 +789,7 @@ void BMBvh::leaf_node_face_remove(BMLeafNode *node, BMFace *f, bool reset)
 	std::swap(node->_faces[off], node->_faces.back());
 	node->_faces.pop_back();
 	node->setAppFlagBit(LEAF_UPDATE_STEP_BB | LEAF_UPDATE_STEP_DRAW_BUFFER);
+	_modify_stamp++;
 
 	/*don't reset for re-adding this face to its node later*/
 	if (reset){
@@ -564,6 +822,7 @@ void BMBvh::leaf_node_free_data(BMLeafNode *lnode)
 void BMBvh::leaf_node_free(BMLeafNode *lnode)
 {
 	leaf_node_free_data(lnode);
+	lnode->~BMLeafNode(); /*release overflow storage*/
 	scalable_aligned_free(lnode);
 }
 
@@ -589,6 +848,7 @@ void BMBvh::leaf_node_faces_add_referece(const std::vector<BMLeafNode*> &nodes)
 			BMFace *f = faces[j];
 			elem_leaf_node_set(f, node);
 			elem_leaf_node_offset_set(f, j);
+			BM_elem_aux_data_int_set(f, _bmesh.cd_fstamp, 0);
 #ifdef _DEBUG
 			BLI_assert(elem_leaf_node_get(f) == node);
 			BLI_assert(elem_leaf_node_offset_get(f) == j);
@@ -703,9 +963,10 @@ void BMBvh::check_valid()
 
 }
 
-void BMBvh::leaf_node_bound_face_norm_update(BMLeafNode *node)
+namespace
 {
-	auto face_update = [](BMFace *f, Vector3f &lower, Vector3f &upper)
+	/*normal of a triangle, extend bounds by its vertices*/
+	BLI_INLINE void face_norm_bounds_update(BMFace *f, Vector3f &lower, Vector3f &upper)
 	{
 		switch (f->len)
 		{
@@ -723,21 +984,95 @@ void BMBvh::leaf_node_bound_face_norm_update(BMLeafNode *node)
 		default:
 			break;
 		}
-	};
+	}
+}
 
+void BMBvh::leaf_node_bound_face_norm_update(BMLeafNode *node)
+{
 	const BMFaceVector &faces = node->faces();
 	const size_t totface = faces.size();
 
 	Vector3f lower(FLT_MAX, FLT_MAX, FLT_MAX);
 	Vector3f upper(-FLT_MAX, -FLT_MAX, -FLT_MAX);
 	for (size_t i = 0; i != totface; ++i){
-		face_update(faces[i], lower, upper);
+		face_norm_bounds_update(faces[i], lower, upper);
 	}
 
 	BBox3fa bb(Vec3fa(lower[0], lower[1], lower[2]), Vec3fa(upper[0], upper[1], upper[2]));
 	node->setBB(bb);
 }
 
+/*every vertex of the face belongs to the node*/
+bool BMBvh::leaf_node_face_owned(BMLeafNode *node, BMFace *f)
+{
+	BMLoop *l_iter, *l_first;
+	l_iter = l_first = BM_FACE_FIRST_LOOP(f);
+	do{
+		if (BM_elem_aux_data_int_get(l_iter->v, _bmesh.cd_vnode) != node->_idx)
+			return false;
+	} while ((l_iter = l_iter->next) != l_first);
+	return true;
+}
+
+void BMBvh::leaf_node_fused_update(BMLeafNode *node)
+{
+	const BMFaceVector &faces = node->faces();
+	const size_t totface = faces.size();
+
+	std::vector<BMFace*> seam;
+	Vector3f lower(FLT_MAX, FLT_MAX, FLT_MAX);
+	Vector3f upper(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (size_t i = 0; i != totface; ++i){
+		BMFace *f = faces[i];
+		if (leaf_node_face_owned(node, f))
+			face_norm_bounds_update(f, lower, upper);
+		else
+			seam.push_back(f);
+	}
+
+	node->setBB(BBox3fa(Vec3fa(lower[0], lower[1], lower[2]), Vec3fa(upper[0], upper[1], upper[2])));
+	node->unsetAppFlagBit(LEAF_UPDATE_STEP_BB);
+
+	if (!seam.empty()){
+		_fused_seams.push_back(std::make_pair(node, std::move(seam)));
+	}
+}
+
+/*each seam face belongs to one leaf node, so nodes are finished concurrently*/
+void BMBvh::leaf_node_fused_finish()
+{
+	if (_fused_group)
+		return;
+
+	tbb::parallel_for(static_cast<size_t>(0), _fused_seams.size(), [&](size_t i)
+	{
+		BMLeafNode *node = _fused_seams[i].first;
+		const std::vector<BMFace*> &seam = _fused_seams[i].second;
+
+		Vector3f lower(FLT_MAX, FLT_MAX, FLT_MAX);
+		Vector3f upper(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		for (size_t k = 0; k < seam.size(); ++k){
+			face_norm_bounds_update(seam[k], lower, upper);
+		}
+		node->extend(Vec3fa(lower[0], lower[1], lower[2]), Vec3fa(upper[0], upper[1], upper[2]));
+	});
+
+	_fused_seams.clear();
+	bvh_set_dirty(true);
+	_modify_stamp++;
+}
+
+void BMBvh::leaf_node_fused_group_begin()
+{
+	_fused_group = true;
+}
+
+void BMBvh::leaf_node_fused_group_end()
+{
+	_fused_group = false;
+	leaf_node_fused_finish();
+}
+
 bool BMBvh::leaf_node_dirty_draw(std::vector<BMLeafNode*> &nodes)
 {
 	for (BMLeafNode *node : _leafs){
@@ -0,0 +1,220 @@
+#include "VBvh/BMeshBvhOptimizer.h"
+#include "VBvh/VBvhBinBuilder.h"
+#include "VBvh/VBvhUtil.h"
+
+VBVH_BEGIN_NAMESPACE
+
+/*leaf size used by BMeshBvhBuilder. sibling leaves which fit in one leaf are merged*/
+static const size_t OPTIMIZE_LEAF_SIZE		= 400;
+/*same as BMeshBvhNodeSplitter*/
+static const size_t OPTIMIZE_MIN_LEAF_SIZE	= 200;
+/*a sub-tree whose children's summed area exceeds this ratio of its own area is rebuilt.
+a well-built 4-wide node sits below 2.0*/
+static const float	OPTIMIZE_OVERLAP_RATIO	= 3.0f;
+/*maximum faces rebuilt per pass, to bound the time the next stroke may wait for the worker*/
+static const size_t OPTIMIZE_MAX_FACES		= 1 << 19;
+
+BMeshBvhOptimizer::BMeshBvhOptimizer(const BMeshBvhContext &bmbvhinfo)
+	:
+	_bmbvh_info(bmbvhinfo),
+	_stamp(0),
+	_running(false)
+{
+	_cancel = false;
+}
+
+BMeshBvhOptimizer::~BMeshBvhOptimizer()
+{
+	stop();
+	clear();
+}
+
+void BMeshBvhOptimizer::start(BaseNode *root, size_t stamp)
+{
+	BLI_assert(!_running && _tasks.empty());
+
+	_stamp = stamp;
+	_cancel = false;
+
+	size_t totface, totleaf;
+	node_analyse(root, nullptr, totface, totleaf);
+
+	/*keep the pass within budget*/
+	size_t budget = 0;
+	for (size_t i = 0; i < _tasks.size(); ++i){
+		budget += _tasks[i]->faces.size();
+		if (budget > OPTIMIZE_MAX_FACES){
+			for (size_t j = i; j < _tasks.size(); ++j){
+				delete _tasks[j];
+			}
+			_tasks.resize(i);
+			break;
+		}
+	}
+
+	if (_tasks.empty())
+		return;
+
+	_running = true;
+	_worker.run([this]()
+	{
+		for (auto it = _tasks.begin(); it != _tasks.end(); ++it){
+			if (_cancel)
+				break;
+			subtree_build(**it);
+			(*it)->done = true;
+		}
+	});
+}
+
+/*cancel sub-trees which have not been started and wait for the worker*/
+void BMeshBvhOptimizer::stop()
+{
+	if (_running){
+		_cancel = true;
+		_worker.wait();
+		_running = false;
+	}
+}
+
+/*free results which have not been swapped into the live tree*/
+void BMeshBvhOptimizer::clear()
+{
+	BLI_assert(!_running);
+
+	for (auto it = _tasks.begin(); it != _tasks.end(); ++it){
+		SubtreeTask *task = *it;
+		if (task->new_root){
+			subtree_free(task->new_root);
+		}
+		delete task;
+	}
+	_tasks.clear();
+}
+
+void BMeshBvhOptimizer::node_analyse(BaseNode *node, BaseNode *parent, size_t &r_faces, size_t &r_leafs)
+{
+	if (node->isLeafNode()){
+		r_faces = static_cast<BMLeafNode*>(node)->faces().size();
+		r_leafs = 1;
+		return;
+	}
+
+	const size_t first_task = _tasks.size();
+	size_t totchild = 0;
+	float child_area = 0.0f;
+
+	r_faces = 0;
+	r_leafs = 0;
+	for (size_t i = 0; i < 4; ++i){
+		BaseNode *child = node->child(i);
+		if (child){
+			size_t faces, leafs;
+			node_analyse(child, node, faces, leafs);
+			r_faces += faces;
+			r_leafs += leafs;
+			totchild++;
+			/*empty leaf has an inverted bounding box*/
+			if (faces > 0){
+				child_area += halfArea(child->bounds());
+			}
+		}
+	}
+
+	/*root is never replaced*/
+	if (parent == nullptr || r_faces == 0 || r_faces > OPTIMIZE_MAX_FACES)
+		return;
+
+	bool degraded = false;
+	if (r_leafs > 1 && r_faces <= OPTIMIZE_LEAF_SIZE){
+		/*sparse siblings left by dynamic topology. merge them into one leaf*/
+		degraded = true;
+	}
+	else if (r_leafs >= 4 && r_faces * 4 < r_leafs * OPTIMIZE_LEAF_SIZE){
+		/*leafs are less than a quarter full on average*/
+		degraded = true;
+	}
+	else if (totchild > 1){
+		/*children's bounding boxes overlap due to deformation*/
+		const float area = halfArea(node->bounds());
+		degraded = area > 0.0f && child_area > OPTIMIZE_OVERLAP_RATIO * area;
+	}
+
+	if (degraded){
+		/*this sub-tree contains every degraded sub-tree found below it*/
+		for (size_t i = first_task; i < _tasks.size(); ++i){
+			delete _tasks[i];
+		}
+		_tasks.resize(first_task);
+
+		SubtreeTask *task = new SubtreeTask();
+		task->node = node;
+		task->parent = parent;
+		task->new_root = nullptr;
+		task->done = false;
+		task->faces.reserve(r_faces);
+		node_faces_collect(node, task->faces);
+		_tasks.push_back(task);
+	}
+}
+
+void BMeshBvhOptimizer::node_faces_collect(BaseNode *node, std::vector<BMFace*> &faces)
+{
+	if (node->isLeafNode()){
+		const BMFaceVector &lfaces = static_cast<BMLeafNode*>(node)->faces();
+		faces.insert(faces.end(), lfaces.begin(), lfaces.end());
+	}
+	else{
+		for (size_t i = 0; i < 4; ++i){
+			if (node->child(i)){
+				node_faces_collect(node->child(i), faces);
+			}
+		}
+	}
+}
+
+/*run on worker thread. only touch the task and the face snapshot*/
+void BMeshBvhOptimizer::subtree_build(SubtreeTask &task)
+{
+	const size_t total = task.faces.size();
+	VPrimRef *prims = reinterpret_cast<VPrimRef*>(scalable_aligned_malloc(sizeof(VPrimRef) * total, 32));
+	VPrimInfo priminfo;
+	BMFacesPrimInfoCompute(task.faces.data(), total, prims, priminfo, false);
+
+	if (total <= OPTIMIZE_LEAF_SIZE){
+		BMLeafNode *leaf = reinterpret_cast<BMLeafNode*>(scalable_aligned_malloc(sizeof(BMLeafNode), 16));
+		new (leaf)BMLeafNode(task.parent);
+		leaf->build(prims, static_cast<size_t>(0), total, &_bmbvh_info);
+
+		task.new_root = leaf;
+		task.new_leafs.push_back(leaf);
+	}
+	else{
+		VBvhBinBuilder<BMLeafNode, 16> b(priminfo, prims, total, OPTIMIZE_MIN_LEAF_SIZE, &_bmbvh_info);
+		b.build();
+
+		task.new_leafs = std::move(b.leafNodes());
+		task.new_root = b.rootNode();
+	}
+
+	scalable_aligned_free(prims);
+}
+
+void BMeshBvhOptimizer::subtree_free(BaseNode *node)
+{
+	if (node->isLeafNode()){
+		BMLeafNode *lnode = static_cast<BMLeafNode*>(node);
+		lnode->~BMLeafNode();
+		scalable_aligned_free(lnode);
+	}
+	else{
+		for (size_t i = 0; i < 4; ++i){
+			if (node->child(i)){
+				subtree_free(node->child(i));
+			}
+		}
+		scalable_aligned_free(node);
+	}
+}
+
+VBVH_END_NAMESPACE
@@ -0,0 +1,386 @@
+#include "VKernel/BMeshVoxelRemeshOp.h"
+#include "VBvh/BMBvhIsect.h"
+#include "BMesh/BMeshPolygon.h"
+#include "tbb/parallel_for.h"
+#include "tbb/enumerable_thread_specific.h"
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+
+namespace
+{
+	/*cell corner offsets and the 12 cell edges as corner pairs*/
+	const int CORNER[8][3] = {
+		{ 0, 0, 0 }, { 1, 0, 0 }, { 0, 1, 0 }, { 1, 1, 0 },
+		{ 0, 0, 1 }, { 1, 0, 1 }, { 0, 1, 1 }, { 1, 1, 1 } };
+	const int EDGE[12][2] = {
+		{ 0, 1 }, { 2, 3 }, { 4, 5 }, { 6, 7 },
+		{ 0, 2 }, { 1, 3 }, { 4, 6 }, { 5, 7 },
+		{ 0, 4 }, { 1, 5 }, { 2, 6 }, { 3, 7 } };
+
+	void quad_add(std::vector<int> &tris, const Vector3f *co, int a, int b, int c, int d)
+	{
+		/*split along the shorter diagonal*/
+		if ((co[0] - co[2]).squaredNorm() <= (co[1] - co[3]).squaredNorm()){
+			tris.push_back(a); tris.push_back(b); tris.push_back(c);
+			tris.push_back(a); tris.push_back(c); tris.push_back(d);
+		}
+		else{
+			tris.push_back(a); tris.push_back(b); tris.push_back(d);
+			tris.push_back(b); tris.push_back(c); tris.push_back(d);
+		}
+	}
+}
+
+BMeshVoxelRemeshOp::BMeshVoxelRemeshOp(BMBvh *refer_bvh, float voxel_size)
+	:
+	_refer_bvh(refer_bvh),
+	_voxel(voxel_size),
+	_band(2.0f * voxel_size)
+{
+	_nblock[0] = _nblock[1] = _nblock[2] = 0;
+}
+
+BMeshVoxelRemeshOp::~BMeshVoxelRemeshOp()
+{
+}
+
+float BMeshVoxelRemeshOp::defaultVoxelSize(BMesh *bm)
+{
+	BMIter iter;
+	BMEdge *e;
+	double total = 0.0;
+	size_t cnt = 0;
+	BM_ITER_MESH(e, &iter, bm, BM_EDGES_OF_MESH){
+		total += (e->v1->co - e->v2->co).norm();
+		cnt++;
+	}
+	return cnt ? static_cast<float>(total / cnt) : 0.0f;
+}
+
+BMesh* BMeshVoxelRemeshOp::run()
+{
+	if (_voxel <= 0.0f)
+		return nullptr;
+
+	gridSetup();
+	blocksMark();
+
+	tbb::parallel_for(static_cast<size_t>(0), _blocks.size(), [&](size_t i)
+	{
+		blockSample(_blocks[i]);
+		blockVertices(_blocks[i]);
+	});
+
+	size_t totvert = 0;
+	for (auto it = _blocks.begin(); it != _blocks.end(); ++it){
+		it->vert_offset = totvert;
+		totvert += it->verts.size();
+	}
+
+	/*quads read the cell vertices of neighbour blocks*/
+	tbb::parallel_for(static_cast<size_t>(0), _blocks.size(), [&](size_t i)
+	{
+		blockFaces(_blocks[i]);
+	});
+
+	return meshBuild();
+}
+
+/*samples cover the reference bounds with a margin of the band plus one cell*/
+void BMeshVoxelRemeshOp::gridSetup()
+{
+	const AlignedBox3f bb = _refer_bvh->bounds();
+	const float margin = _band + _voxel;
+	_origin = bb.min() - Vector3f(margin, margin, margin);
+
+	for (int a = 0; a < 3; ++a){
+		const int ncell = static_cast<int>(std::ceil((bb.max()[a] - bb.min()[a] + 2.0f * margin) / _voxel));
+		_nblock[a] = std::max<int>(1, (ncell + BLOCK_SIZE - 1) / BLOCK_SIZE);
+	}
+}
+
+/*blocks touched by a leaf node box grown by the band.
+each thread collects the keys of its leaf nodes, the merged list is sorted so blocks are in z, y, x order*/
+void BMeshVoxelRemeshOp::blocksMark()
+{
+	tbb::enumerable_thread_specific<std::vector<uint64_t>> thread_keys;
+	const std::vector<BMLeafNode*> &leafs = _refer_bvh->leafNodes();
+	const float block_len = _voxel * BLOCK_SIZE;
+
+	tbb::parallel_for(static_cast<size_t>(0), leafs.size(), [&](size_t n)
+	{
+		if (leafs[n]->faces().empty())
+			return;
+
+		const Eigen::AlignedBox3f bb = leafs[n]->boundsEigen();
+		int lo[3], hi[3];
+		for (int a = 0; a < 3; ++a){
+			lo[a] = std::max<int>(0, static_cast<int>(std::floor((bb.min()[a] - _band - _origin[a]) / block_len)));
+			hi[a] = std::min<int>(_nblock[a] - 1, static_cast<int>(std::floor((bb.max()[a] + _band - _origin[a]) / block_len)));
+		}
+
+		std::vector<uint64_t> &keys = thread_keys.local();
+		for (int z = lo[2]; z <= hi[2]; ++z)
+			for (int y = lo[1]; y <= hi[1]; ++y)
+				for (int x = lo[0]; x <= hi[0]; ++x)
+					keys.push_back(blockKey(x, y, z));
+	});
+
+	_block_keys.clear();
+	for (auto it = thread_keys.begin(); it != thread_keys.end(); ++it){
+		_block_keys.insert(_block_keys.end(), it->begin(), it->end());
+	}
+	std::sort(_block_keys.begin(), _block_keys.end());
+	_block_keys.erase(std::unique(_block_keys.begin(), _block_keys.end()), _block_keys.end());
+	_block_keys.shrink_to_fit();
+
+	_blocks.clear();
+	_blocks.resize(_block_keys.size());
+	for (size_t slot = 0; slot < _block_keys.size(); ++slot){
+		const uint64_t key = _block_keys[slot];
+		Block &block = _blocks[slot];
+		block.org[0] = static_cast<int>(key % _nblock[0]) * BLOCK_SIZE;
+		block.org[1] = static_cast<int>((key / _nblock[0]) % _nblock[1]) * BLOCK_SIZE;
+		block.org[2] = static_cast<int>(key / (static_cast<uint64_t>(_nblock[0]) * _nblock[1])) * BLOCK_SIZE;
+	}
+}
+
+/*_blocks index of the block, -1 if it is not allocated*/
+int BMeshVoxelRemeshOp::blockSlot(int bx, int by, int bz) const
+{
+	if (bx < 0 || by < 0 || bz < 0 || bx >= _nblock[0] || by >= _nblock[1] || bz >= _nblock[2])
+		return -1;
+
+	const uint64_t key = blockKey(bx, by, bz);
+	auto it = std::lower_bound(_block_keys.begin(), _block_keys.end(), key);
+	return (it != _block_keys.end() && *it == key) ? static_cast<int>(it - _block_keys.begin()) : -1;
+}
+
+/*each face updates the samples of its box grown by the band.
+when two faces are about as close, as on an edge or a vertex, the one facing the sample wins the sign.
+samples on a block side are shared with the neighbour block, which computes them on its own with
+other leaf nodes in another order. positions come from the global sample index and the winner from
+a key that does not depend on the face order, so both blocks end up with the same value*/
+void BMeshVoxelRemeshOp::blockSample(Block &block)
+{
+	const size_t totsample = BLOCK_SAMPLES * BLOCK_SAMPLES * BLOCK_SAMPLES;
+	int   best[totsample];		/*squared distance in steps of tie*/
+	float facing[totsample];	/*|cos| between the face normal and the closest direction*/
+	std::fill(best, best + totsample, INT_MAX);
+	std::fill(facing, facing + totsample, 0.0f);
+	std::fill(block.dist, block.dist + totsample, FLT_MAX);
+
+	const Vector3f lower = _origin + _voxel * Vector3f(block.org[0], block.org[1], block.org[2]);
+	const Vector3f upper = lower + Vector3f::Constant(_voxel * BLOCK_SIZE);
+	/*one more cell so that rounding of the block corners can't drop a leaf node the neighbour block sees*/
+	const Vector3f margin = Vector3f::Constant(_band + _voxel);
+
+	std::vector<BMLeafNode*> leafs;
+	isect_box_bm_bvh(_refer_bvh, Eigen::AlignedBox3f(lower - margin, upper + margin), leafs);
+
+	const float sqrband = _band * _band;
+	const float tie = 1.0e-6f * _voxel * _voxel;
+	for (size_t n = 0; n < leafs.size(); ++n){
+		const BMFaceVector &faces = leafs[n]->faces();
+		for (size_t i = 0; i < faces.size(); ++i){
+			BMFace *f = faces[i];
+
+			Eigen::AlignedBox3f fbb;
+			BMLoop *l_iter, *l_first;
+			l_iter = l_first = BM_FACE_FIRST_LOOP(f);
+			do{
+				fbb.extend(l_iter->v->co);
+			} while ((l_iter = l_iter->next) != l_first);
+
+			int lo[3], hi[3];
+			for (int a = 0; a < 3; ++a){
+				lo[a] = std::max<int>(0, static_cast<int>(std::ceil((fbb.min()[a] - _band - _origin[a]) / _voxel)) - block.org[a]);
+				hi[a] = std::min<int>(BLOCK_SIZE, static_cast<int>(std::floor((fbb.max()[a] + _band - _origin[a]) / _voxel)) - block.org[a]);
+			}
+
+			for (int z = lo[2]; z <= hi[2]; ++z){
+				for (int y = lo[1]; y <= hi[1]; ++y){
+					for (int x = lo[0]; x <= hi[0]; ++x){
+						const Vector3f p = _origin + _voxel * Vector3f(block.org[0] + x, block.org[1] + y, block.org[2] + z);
+						Vector3f closest;
+						if (!BM_face_closest_point(f, p, closest))
+							continue;
+
+						const Vector3f dir = p - closest;
+						const float sqrdist = dir.squaredNorm();
+						if (sqrdist > sqrband)
+							continue;
+
+						const size_t s = sampleIndex(x, y, z);
+						const int   step = static_cast<int>(sqrdist / tie);
+						const float cosf = sqrdist > 0.0f ? std::abs(dir.dot(f->no)) / std::sqrt(sqrdist) : 1.0f;
+						const float d = dir.dot(f->no) < 0.0f ? -std::sqrt(sqrdist) : std::sqrt(sqrdist);
+
+						/*closer step, then more facing, then the smaller signed distance*/
+						if (step < best[s] || (step == best[s] && (cosf > facing[s] || (cosf == facing[s] && d < block.dist[s])))){
+							best[s] = step;
+							facing[s] = cosf;
+							block.dist[s] = d;
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+/*one vertex per cell with a sign change, at the mean of the crossings on its edges*/
+void BMeshVoxelRemeshOp::blockVertices(Block &block)
+{
+	const Vector3f lower = _origin + _voxel * Vector3f(block.org[0], block.org[1], block.org[2]);
+	block.verts.clear();
+
+	for (int z = 0; z < BLOCK_SIZE; ++z){
+		for (int y = 0; y < BLOCK_SIZE; ++y){
+			for (int x = 0; x < BLOCK_SIZE; ++x){
+				int &vert = block.cell_vert[cellIndex(x, y, z)];
+				vert = -1;
+
+				float d[8];
+				bool valid = true;
+				int inside = 0;
+				for (int c = 0; c < 8 && valid; ++c){
+					d[c] = block.dist[sampleIndex(x + CORNER[c][0], y + CORNER[c][1], z + CORNER[c][2])];
+					valid = d[c] != FLT_MAX;
+					inside += d[c] < 0.0f ? 1 : 0;
+				}
+				if (!valid || inside == 0 || inside == 8)
+					continue;
+
+				Vector3f sum(0.0f, 0.0f, 0.0f);
+				int cnt = 0;
+				for (int e = 0; e < 12; ++e){
+					const int c0 = EDGE[e][0], c1 = EDGE[e][1];
+					if ((d[c0] < 0.0f) != (d[c1] < 0.0f)){
+						const float t = d[c0] / (d[c0] - d[c1]);
+						for (int a = 0; a < 3; ++a){
+							sum[a] += CORNER[c0][a] + t * (CORNER[c1][a] - CORNER[c0][a]);
+						}
+						cnt++;
+					}
+				}
+
+				vert = static_cast<int>(block.verts.size());
+				block.verts.push_back(lower + _voxel * (Vector3f(x, y, z) + sum / static_cast<float>(cnt)));
+			}
+		}
+	}
+}
+
+int BMeshVoxelRemeshOp::cellVertex(int x, int y, int z) const
+{
+	if (x < 0 || y < 0 || z < 0)
+		return -1;
+
+	const int slot = blockSlot(x / BLOCK_SIZE, y / BLOCK_SIZE, z / BLOCK_SIZE);
+	if (slot < 0)
+		return -1;
+
+	const Block &block = _blocks[slot];
+	const int v = block.cell_vert[cellIndex(x - block.org[0], y - block.org[1], z - block.org[2])];
+	return v < 0 ? -1 : static_cast<int>(block.vert_offset) + v;
+}
+
+/*a block owns the edges leaving its first BLOCK_SIZE samples along +x, +y and +z.
+the four cells around a crossed edge make a quad facing from the inside to the outside*/
+void BMeshVoxelRemeshOp::blockFaces(Block &block)
+{
+	block.tris.clear();
+
+	/*cells around an edge of axis a, in counter-clockwise order around +a*/
+	static const int RING[3][4][3] = {
+		{ { 0, -1, -1 }, { 0, 0, -1 }, { 0, 0, 0 }, { 0, -1, 0 } },
+		{ { -1, 0, -1 }, { -1, 0, 0 }, { 0, 0, 0 }, { 0, 0, -1 } },
+		{ { -1, -1, 0 }, { 0, -1, 0 }, { 0, 0, 0 }, { -1, 0, 0 } } };
+
+	for (int z = 0; z < BLOCK_SIZE; ++z){
+		for (int y = 0; y < BLOCK_SIZE; ++y){
+			for (int x = 0; x < BLOCK_SIZE; ++x){
+				const float d0 = block.dist[sampleIndex(x, y, z)];
+				if (d0 == FLT_MAX)
+					continue;
+
+				for (int a = 0; a < 3; ++a){
+					const float d1 = block.dist[sampleIndex(x + (a == 0), y + (a == 1), z + (a == 2))];
+					if (d1 == FLT_MAX || (d0 < 0.0f) == (d1 < 0.0f))
+						continue;
+
+					int v[4];
+					bool valid = true;
+					for (int k = 0; k < 4 && valid; ++k){
+						v[k] = cellVertex(block.org[0] + x + RING[a][k][0], block.org[1] + y + RING[a][k][1], block.org[2] + z + RING[a][k][2]);
+						valid = v[k] >= 0;
+					}
+					if (!valid)
+						continue;
+
+					Vector3f co[4];
+					for (int k = 0; k < 4; ++k){
+						const int cx = block.org[0] + x + RING[a][k][0];
+						const int cy = block.org[1] + y + RING[a][k][1];
+						const int cz = block.org[2] + z + RING[a][k][2];
+						const Block &owner = _blocks[blockSlot(cx / BLOCK_SIZE, cy / BLOCK_SIZE, cz / BLOCK_SIZE)];
+						co[k] = owner.verts[v[k] - owner.vert_offset];
+					}
+
+					if (d0 < 0.0f){
+						quad_add(block.tris, co, v[0], v[1], v[2], v[3]);
+					}
+					else{
+						const Vector3f rco[4] = { co[3], co[2], co[1], co[0] };
+						quad_add(block.tris, rco, v[3], v[2], v[1], v[0]);
+					}
+				}
+			}
+		}
+	}
+}
+
+/*vertices in block order, then triangles. BMesh allocation is not thread safe*/
+BMesh* BMeshVoxelRemeshOp::meshBuild()
+{
+	BMesh *bm = new BMesh();
+
+	size_t totvert = 0;
+	for (auto it = _blocks.begin(); it != _blocks.end(); ++it){
+		totvert += it->verts.size();
+	}
+
+	std::vector<BMVert*> verts;
+	verts.reserve(totvert);
+	for (auto it = _blocks.begin(); it != _blocks.end(); ++it){
+		for (auto vit = it->verts.begin(); vit != it->verts.end(); ++vit){
+			verts.push_back(bm->BM_vert_create(*vit, nullptr, BM_CREATE_NOP));
+		}
+	}
+
+	for (auto it = _blocks.begin(); it != _blocks.end(); ++it){
+		const std::vector<int> &tris = it->tris;
+		for (size_t i = 0; i + 2 < tris.size(); i += 3){
+			BMVert *v0 = verts[tris[i]], *v1 = verts[tris[i + 1]], *v2 = verts[tris[i + 2]];
+			if (v0 != v1 && v1 != v2 && v2 != v0){
+				bm->BM_face_create_quad_tri(v0, v1, v2, nullptr, nullptr, BM_CREATE_NOP);
+			}
+		}
+	}
+
+	/*cells without a face*/
+	for (size_t i = 0; i < verts.size(); ++i){
+		if (!verts[i]->e){
+			bm->BM_vert_kill(verts[i]);
+		}
+	}
+
+	bm->BM_mesh_normals_update_parallel();
+
+	_blocks.clear();
+	_block_keys.clear();
+	return bm;
+}
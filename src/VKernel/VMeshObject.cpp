@@ -107,7 +107,10 @@ void VMeshObject::applyLocalTransform()
 {
 	vk::Transform identity = vk::Transform::Identity();
 	if (!localTransform().isApprox(identity) && _bmesh){
-		
+		if (_bvh){
+			_bvh->bvh_optimize_end();
+		}
+
 		_bmesh->BM_mesh_elem_table_ensure(BM_VERT, true);
 		auto verts = _bmesh->BM_mesh_vert_table();
 		size_t total = verts.size();
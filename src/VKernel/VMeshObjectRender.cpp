@@ -40,6 +40,10 @@ void VMeshObjectRender::syncUpdate(VContext *context, VNode *node)
 		_lightpos = scene->lighting()->lightPosition();
 
 		BMBvh *bvh = mobj->getBmeshBvh();
+
+		/*leaf nodes could be merged by the bvh optimizer*/
+		if (_vNodeBuffers.size() > bvh->leafNodes().size()) _vNodeBuffers.resize(bvh->leafNodes().size());
+
 		if (bvh->leaf_node_dirty_draw(update_nodes)){
 			
 			int max_id = 0;
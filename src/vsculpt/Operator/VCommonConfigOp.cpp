@@ -3,6 +3,8 @@
 #include "VKernel/VMeshObject.h"
 #include "VKernel/VManipulatorNode.h"
 #include "VbsQt/VbsDef.h"
+#include "sculpt/VSculptUndoHistory.h"
+#include <algorithm>
 using namespace  vk;
 
 VCommonConfigOp::VCommonConfigOp()
@@ -38,4 +40,9 @@ void VCommonConfigOp::setParam(const QString &name, const QVariant &value)
 			mobj->setRenderMode(mode);
 		}
 	}
+	else if (name == "undo_memory_budget"){
+		/*megabytes*/
+		size_t mbytes = static_cast<size_t>(std::max(value.toInt(), 1));
+		VSculptUndoHistory::instance()->set_memory_budget(mbytes << 20);
+	}
 }
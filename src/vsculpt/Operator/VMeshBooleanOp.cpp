@@ -63,6 +63,9 @@ void VMeshBooleanOp::execute()
 	if (!_hostObj || !_targetObj || _hostObj == _targetObj || _type == VbsDef::BOOLEAN_NONE)
 		return;
 
+	_hostObj->getBmeshBvh()->bvh_optimize_end();
+	_targetObj->getBmeshBvh()->bvh_optimize_end();
+
 	BMesh *bool_mesh;
 	
 	switch (_type)
@@ -1,6 +1,9 @@
 #include "VMeshDecimateOp.h"
 #include "VKernel/VContext.h"
 #include "BMesh/Tools/BMeshDecimate.h"
+#ifdef EDGE_QUEUE_BENCHMARK
+#include "BMesh/Tools/BMeshEdgeQueueBench.h"
+#endif
 
 VMeshDecimateOp::VMeshDecimateOp()
 	:
@@ -45,13 +48,23 @@ void VMeshDecimateOp::execute()
 	}
 
 	if (_org_obj){
+		_org_obj->getBmeshBvh()->bvh_optimize_end();
+
 		BMesh *dcbm = new BMesh(*_org_obj->getBmesh());
 
 		BMeshDecimate op(dcbm);
 		auto it = _params.find("ratio");
 		if (it != _params.end())
 			op.setRatio(it->toFloat());
+#ifdef EDGE_QUEUE_BENCHMARK
+		EdgeQueueStream stream;
+		op.setRecorder(&stream);
+		stream.totid = dcbm->BM_mesh_edges_total();
+#endif
 		op.run();
+#ifdef EDGE_QUEUE_BENCHMARK
+		BMeshEdgeQueueBench::report(BMeshEdgeQueueBench::run(stream));
+#endif
 		
 		_dcmobj = new VMeshObject(scene, dcbm);
 
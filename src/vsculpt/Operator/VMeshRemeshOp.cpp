@@ -1,6 +1,7 @@
 #include "VMeshRemeshOp.h"
 #include "VKernel/VContext.h"
 #include "VKernel/BMeshRemeshOp.h"
+#include "VKernel/BMeshVoxelRemeshOp.h"
 
 VMeshRemeshOp::VMeshRemeshOp()
 	:
@@ -45,19 +46,38 @@ void VMeshRemeshOp::execute()
 	}
 
 	if (_org_obj){
-		BMesh *dcbm = new BMesh(*_org_obj->getBmesh());
+		/*the remesh reads the tree and the mesh*/
+		_org_obj->getBmeshBvh()->bvh_optimize_end();
+
+		BMesh *dcbm = nullptr;
+
+		/*voxel remesh when a voxel size is given, 0 picks it from the edge length*/
+		auto it = _params.find("voxel_size");
+		if (it != _params.end()){
+			float voxel_size = it->toFloat();
+			if (voxel_size <= 0.0f)
+				voxel_size = BMeshVoxelRemeshOp::defaultVoxelSize(_org_obj->getBmesh());
+
+			BMeshVoxelRemeshOp op(_org_obj->getBmeshBvh(), voxel_size);
+			dcbm = op.run();
+			if (!dcbm)
+				return;
+		}
+		else{
+			dcbm = new BMesh(*_org_obj->getBmesh());
 
-		BMeshRemeshOp op(dcbm, _org_obj->getBmeshBvh());
+			BMeshRemeshOp op(dcbm, _org_obj->getBmeshBvh());
 
-		auto it = _params.find("feature_reserve");
-		if (it != _params.end())
-			op.setFeatureReserve(it->toBool());
+			it = _params.find("feature_reserve");
+			if (it != _params.end())
+				op.setFeatureReserve(it->toBool());
 
-		it = _params.find("iteration");
-		if (it != _params.end())
-			op.setIteration(it->toUInt());
+			it = _params.find("iteration");
+			if (it != _params.end())
+				op.setIteration(it->toUInt());
 
-		op.run();
+			op.run();
+		}
 
 		_remesh_obj = new VMeshObject(scene, dcbm);
 
@@ -44,6 +44,8 @@ void VMeshSelfIsectOp::execute()
 	}
 
 	if (_org_obj){
+		_org_obj->getBmeshBvh()->bvh_optimize_end();
+
 		BMesh *dcbm = bm_isct::resolve_self_isct(_org_obj->getBmesh());
 
 		_isct_obj = new VMeshObject(scene, dcbm);
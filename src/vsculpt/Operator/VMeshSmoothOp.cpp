@@ -58,6 +58,8 @@ void VMeshSmoothOp::execute()
 	}
 
 	if (bm && bvh){
+		bvh->bvh_optimize_end();
+
 		VSmoothOp op(bm);
 
 		auto it = _params.find("lambda");
@@ -86,6 +88,8 @@ void VMeshSmoothOp::cancel()
 		BMesh *bm = _smoothobj->getBmesh();
 		BMBvh *bvh = _smoothobj->getBmeshBvh();
 		if (bm->BM_mesh_verts_total() == _orgvertco.size()){
+			bvh->bvh_optimize_end();
+
 			BMVert *v;
 			BMIter iter;
 			size_t idx = 0;
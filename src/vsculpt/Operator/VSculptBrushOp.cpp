@@ -8,35 +8,59 @@
 #include "VKernel/VContext.h"
 #include "VKernel/VView3DRegion.h"
 #include "VbsQt/VbsDef.h"
+#include "BaseLib/MathUtil.h"
+#include "sculpt/SUtil.h"
+#include "sculpt/SculptRenderSync.h"
+#include "tbb/mutex.h"
+#include "tbb/tick_count.h"
+#include <cstdlib>
 
 #ifdef DEBUG_DRAW
 extern std::vector<std::pair<Vector3f, Vector3f>> g_debug_points;
 #endif
+
 using namespace vk;
+
+namespace
+{
+	/*frame budgets of deferred refinement run after the mouse is released*/
+	const size_t RELEASE_REFINE_FRAMES = 4;
+}
+
 VSculptBrushOp::VSculptBrushOp(VScene *scene)
 	:
 	_scene(scene),
 	_object(nullptr),
 	_stroke(nullptr),
 	_curve(nullptr),
-	_timerid(-1)
+	_timerid(-1),
+	_worker_stop(false),
+	_sample_mouse(true),
+	_record(nullptr)
 {
 	_stroke_started = false;
 
 	VSculptConfig *config = _scene->sculptConfig();
 
 	_data.brush_type = config->brush();
+	_falloff = config->brushFalloffCurve();
 	_curve = new BezierCurve(config->brushFalloffCurve());
 	_data.deform_curve = _curve;
+	_data.profile = nullptr;
+	_data.rotate_angle = 0.0f;
 	_data.sym_flag = 0;
 	
 	_data.brush_strength = config->brushStrength();
 	_data.pinch_factor = 0.5f;
+	_data.smooth_iterations = config->brushSmoothIterations();
 	_data.scale = 0.2f;
 	_data.edge_len_unit_threshold = 0.01f;
 
 	_pixel_radius = config->brushPixelSize();
 	_detail_size = config->brushDetailsize();
+	_data.view_detail = ViewDetail();
+	_data.view_detail.enabled = config->brushViewDetail();
+	_data.view_detail.pixels_per_edge = config->brushPixelsPerEdge();
 	
 	_data.flag = 0;
 	_data.flag |= PICK_ORIGINAL_LOCATION;
@@ -45,12 +69,20 @@ VSculptBrushOp::VSculptBrushOp(VScene *scene)
 	}
 
 	_stroke = new SculptStroke(&_data);
+
+	const char *record_path = getenv("VSCULPT_STROKE_RECORD");
+	if (record_path && record_path[0]){
+		_record_path = record_path;
+		_record = new StrokeRecord();
+	}
 }
 
 VSculptBrushOp::~VSculptBrushOp()
 {
+	worker_stop();
 	delete _stroke;
 	delete _curve;
+	delete _record;
 }
 
 bool VSculptBrushOp::poll()
@@ -87,7 +119,7 @@ int  VSculptBrushOp::invoke(QEvent *ev)
 			_cur_mouse	= _last_mouse;
 			queue_mouse_range(_last_mouse, _cur_mouse);
 
-			apply();
+			worker_start();
 
 			//_timerid = VContext::instance()->window()->startTimer(2);
 
@@ -110,13 +142,14 @@ int VSculptBrushOp::modal(QEvent *ev)
 			_last_mouse = _cur_mouse;
 			_cur_mouse  = mpoint;
 			queue_mouse_range(_last_mouse, _cur_mouse);
-            apply();
 
 			VContext::instance()->window()->update();
 			return VOperator::OP_RET_RUNNING;
 		}
 		else if(ev->type() == QEvent::MouseButtonRelease){
 
+			/*finish queued samples*/
+			worker_stop();
 			cancel();
 
 			VContext::instance()->window()->update();
@@ -147,27 +180,27 @@ void VSculptBrushOp::init()
 	_data.bvh = _object->getBmeshBvh();
 	_data.bm = _object->getBmesh();
 
+	/*swap in the tree optimized in background since the last stroke*/
+	_data.bvh->sculpt_stroke_begin_update();
+
+	view_update();
+	_sample_mouse = is_sample_mouse();
 }
 
-void VSculptBrushOp::apply()
+void VSculptBrushOp::apply(const MouseRange &mrange)
 {
 	if (!_stroke_started){
-		init_stroke(_cur_mouse);
+		init_stroke(mrange.second);
 	}
 
 	if (_stroke_started){
 
-		if (is_sample_mouse()){
-			if (!_queuemouse.empty()){
-				
-				std::pair<Vector2f, Vector2f> mrange = _queuemouse.front(); _queuemouse.pop();
-				
-				if ((mrange.first - mrange.second).norm() < FLT_EPSILON){
-					add_step(mrange.first, mrange.second, _first_hit_mouse);
-				}
-				else{
-					sample_mouse(mrange.first, mrange.second); /*automatic assign last mouse during sampling*/
-				}
+		if (_sample_mouse){
+			if ((mrange.first - mrange.second).norm() < FLT_EPSILON){
+				add_step(mrange.first, mrange.second, _first_hit_mouse);
+			}
+			else{
+				sample_mouse(mrange.first, mrange.second); /*automatic assign last mouse during sampling*/
 			}
 		}
 		else{
@@ -176,10 +209,102 @@ void VSculptBrushOp::apply()
 	}
 }
 
+void VSculptBrushOp::worker_start()
+{
+	if (!_worker.joinable()){
+		_worker_stop = false;
+		SculptRenderSync::instance()->bypass(false);
+		QQuickWindow *window = VContext::instance()->window();
+		_worker = std::thread([this, window](){ worker_run(window); });
+	}
+}
+
+/*wait for the worker to process every queued sample*/
+void VSculptBrushOp::worker_stop()
+{
+	if (_worker.joinable()){
+		{
+			std::lock_guard<std::mutex> lock(_queue_mutex);
+			_worker_stop = true;
+		}
+		_queue_cond.notify_one();
+		/*the renderer waits for the gui thread, which waits here*/
+		SculptRenderSync::instance()->bypass(true);
+		_worker.join();
+	}
+}
+
+/*work of the worker thread without queued samples. only touches state owned by the worker*/
+bool VSculptBrushOp::worker_idle_pending()
+{
+	return _scheduler.refine_pending() || (_sample_mouse && _stroke->prefetch_pending());
+}
+
+void VSculptBrushOp::worker_run(QQuickWindow *window)
+{
+	MouseRange mrange;
+	size_t release_frames = 0;
+	for (;;){
+		bool queued, stop;
+		{
+			std::unique_lock<std::mutex> lock(_queue_mutex);
+			_queue_cond.wait(lock, [this](){ return !_queuemouse.empty() || _worker_stop || worker_idle_pending(); });
+
+			queued = !_queuemouse.empty();
+			if (queued){
+				/*behind the pen. merge queued samples into one range*/
+				mrange.first = _queuemouse.front().first;
+				mrange.second = _queuemouse.back().second;
+				_queuemouse.clear();
+			}
+			stop = _worker_stop;
+		}
+
+		if (queued){
+			SculptRenderSync::instance()->wait();
+			{
+				tbb::mutex::scoped_lock lock(g_sculpt_mutex);
+				apply(mrange);
+			}
+			QMetaObject::invokeMethod(window, "update", Qt::QueuedConnection);
+			continue;
+		}
+
+		/*idle. refine dabs whose dynamic topology was deferred, a frame budget at a time.
+		after the release only a few frames more, the gui thread waits*/
+		if (_scheduler.refine_pending() && (!stop || release_frames++ < RELEASE_REFINE_FRAMES)){
+			SculptRenderSync::instance()->wait();
+			{
+				tbb::mutex::scoped_lock lock(g_sculpt_mutex);
+				refine();
+			}
+			QMetaObject::invokeMethod(window, "update", Qt::QueuedConnection);
+			continue;
+		}
+		if (stop){
+			/*the dabs left keep the topology they were brushed with*/
+			_scheduler.clear();
+			break;
+		}
+
+		/*touch the leaf nodes of the next dabs once after each range. it only reads the tree,
+		the renderer may sync meanwhile*/
+		if (_sample_mouse && _stroke->prefetch_pending()){
+			_stroke->prefetch();
+		}
+	}
+}
+
 void VSculptBrushOp::cancel()
 {
 	_stroke->finish_stroke();
 
+	if (_record && _stroke_started){
+		_record->stroke_end();
+		_record->save(_record_path);
+		_record->clear();
+	}
+
 	_object->gpuChangedBoundsReset();
 	_object->setState(VMeshObject::STATE_NONE);
 	_object->endModify();
@@ -188,10 +313,50 @@ void VSculptBrushOp::cancel()
 void VSculptBrushOp::add_step(Vector2f cur_mouse, Vector2f last_mouse, Vector2f first_hit_mouse)
 {
 	if (update(cur_mouse, last_mouse, first_hit_mouse)){
+		if (_record){
+			_record->segment_add(true, std::vector<StrokeRecord::Sample>(1, record_sample()));
+		}
 		_stroke->add_step(false);
 	}
 }
 
+/*pick a dab without applying it*/
+void VSculptBrushOp::add_dab(Vector2f cur_mouse, Vector2f last_mouse, std::vector<StrokeDab> &dabs)
+{
+	if (update(cur_mouse, last_mouse, _first_hit_mouse)){
+		StrokeDab dab;
+		dab.cur_pos		 = _data.cur_pos;
+		dab.last_pos	 = _data.last_pos;
+		dab.grab_delta	 = _data.grab_delta;
+		dab.view_dir	 = _data.view_dir;
+		dab.world_radius = _data.world_radius;
+		dab.max_edge_len = _data.max_edge_len;
+		dab.min_edge_len = _data.min_edge_len;
+		dabs.push_back(dab);
+
+		if (_record){
+			_record_samples.push_back(record_sample());
+		}
+	}
+}
+
+/*the current dab with the view ray that produced it*/
+StrokeRecord::Sample VSculptBrushOp::record_sample()
+{
+	StrokeRecord::Sample sample;
+	sample.dab.cur_pos		= _data.cur_pos;
+	sample.dab.last_pos		= _data.last_pos;
+	sample.dab.grab_delta	= _data.grab_delta;
+	sample.dab.view_dir		= _data.view_dir;
+	sample.dab.world_radius = _data.world_radius;
+	sample.dab.max_edge_len = _data.max_edge_len;
+	sample.dab.min_edge_len = _data.min_edge_len;
+	sample.ray_org		= _ray_org;
+	sample.ray_dir		= _ray_dir;
+	sample.rotate_angle = _data.rotate_angle;
+	return sample;
+}
+
 bool VSculptBrushOp::update(Vector2f cur_mouse, Vector2f last_mouse, Vector2f first_hit_mouse)
 {
 	int btype = _data.brush_type;
@@ -200,7 +365,9 @@ bool VSculptBrushOp::update(Vector2f cur_mouse, Vector2f last_mouse, Vector2f fi
 	{
 		Vector3f npoint, fpoint, intPoint;
 		
-		VContext::instance()->viewLine(_region, cur_mouse, npoint, fpoint);
+		view_line(cur_mouse, npoint, fpoint);
+		_ray_org = npoint;
+		_ray_dir = (fpoint - npoint).normalized();
 
 		MathGeom::closest_to_line_v3(intPoint, _data.cur_pos, npoint, fpoint);
 
@@ -237,7 +404,7 @@ bool VSculptBrushOp::update(Vector2f cur_mouse, Vector2f last_mouse, Vector2f fi
 	else{
 		Vector3f npoint, fpoint;
 
-		_data.view_dir = -VContext::instance()->viewModelDirection(_region, _scene);
+		_data.view_dir = _view.view_dir;
 
 		ret = pick(cur_mouse, _data.cur_pos);
 
@@ -252,18 +419,19 @@ bool VSculptBrushOp::update(Vector2f cur_mouse, Vector2f last_mouse, Vector2f fi
 
 bool VSculptBrushOp::pick(Vector2f mouse, Vector3f &hit)
 {
-	VContext *context = VContext::instance();
 	Vector3f org, dir, far_p;
 
-	context->viewLine(_region, mouse, org, far_p);
+	view_line(mouse, org, far_p);
 
 	dir = far_p - org; dir.normalize();
+	_ray_org = org;
+	_ray_dir = dir;
 	bool ret;
 	if (_data.flag & PICK_ORIGINAL_LOCATION){
-		ret = isect_ray_bm_bvh_nearest_hit(_data.bvh, org, dir, true, hit, 1.0e-6);
+		ret = isect_ray_bm_bvh_nearest_hit_cached(_data.bvh, org, dir, true, hit, 1.0e-6);
 	}
 	else{
-		ret = isect_ray_bm_bvh_nearest_hit(_data.bvh, org, dir, false, hit, 1.0e-6);
+		ret = isect_ray_bm_bvh_nearest_hit_cached(_data.bvh, org, dir, false, hit, 1.0e-6);
 	}
 	return ret;
 }
@@ -273,7 +441,7 @@ void VSculptBrushOp::interpolate_param()
 #if 0
 	_data.world_radius = _scene->glInfor()->worldRadius(_pixel_radius, _curMouse.x(), _curMouse.y(), _data.cur_pos);
 #else
-	_data.world_radius = VContext::instance()->screenDistanceToModelDistance(_region, _pixel_radius, _data.cur_pos);
+	_data.world_radius = view_world_distance(_pixel_radius, _data.cur_pos);
 #endif
 
 	float worldPerPixelUnitLen = (_data.world_radius / _pixel_radius) * 3.0;
@@ -284,16 +452,61 @@ void VSculptBrushOp::interpolate_param()
 	_data.min_edge_len = 0.4f * _data.max_edge_len;
 }
 
-/*(start, end]*/
+/*gui thread. the same view as VContext::viewLine and VContext::screenDistanceToModelDistance*/
+void VSculptBrushOp::view_update()
+{
+	_view.proj		= _region->projMatrix();
+	_view.modelview = _region->viewMatrix() * _scene->worldMatrix();
+	_view.viewport	= _region->viewport();
+	_view.camera	= _scene->sceneSpacePointConvert(_region->cameraPosition());
+	_view.view_dir	= -VContext::viewModelDirection(_region, _scene);
+}
+
+void VSculptBrushOp::view_line(Vector2f mouse, Vector3f &l1, Vector3f &l2)
+{
+	l1 = _view.camera;
+	l2 = MathUtil::unproject(_view.proj, _view.modelview, _view.viewport, Vector3f(mouse[0], mouse[1], 0.5f));
+}
+
+/*ref_pos: position in scene space*/
+float VSculptBrushOp::view_world_distance(float pixel_dst, const Vector3f &ref_pos)
+{
+	const Vector3f proj_pos = MathUtil::project(_view.proj, _view.modelview, _view.viewport, ref_pos);
+	const Vector3f pos0 = MathUtil::unproject(_view.proj, _view.modelview, _view.viewport, Vector3f(0.0f, 0.0f, proj_pos[2]));
+	const Vector3f pos1 = MathUtil::unproject(_view.proj, _view.modelview, _view.viewport, Vector3f(pixel_dst, 0.0f, proj_pos[2]));
+	return (pos0 - pos1).norm();
+}
+
+/*the view does not change during a stroke*/
+void VSculptBrushOp::view_detail_update()
+{
+	ViewDetail &view = _data.view_detail;
+	if (!view.enabled)
+		return;
+
+	const Matrix4x4 pvm = _view.proj * _view.modelview;
+	const float width = static_cast<float>(_view.viewport.width());
+	const float xscale = pvm.block<1, 3>(0, 0).norm();
+
+	view.depth_row = pvm.row(3).transpose();
+	view.pixel_scale = (width > 0.0f && xscale > 0.0f) ? 2.0f / (width * xscale) : 0.0f;
+}
+
+/*(start, end]. spacing and dynamic topology of the range are decided by the dab scheduler*/
 void VSculptBrushOp::sample_mouse(Vector2f start, Vector2f end)
 {
+	tbb::tick_count t0 = tbb::tick_count::now();
+
 	Vector2f cur = start;
 	Vector2f last = start;
 	Vector2f mouseDiff = end - start;
 	float length	= mouseDiff.norm(); mouseDiff.normalize();
 
-	float spacing = _pixel_radius * 0.2f;
+	_scheduler.plan(length);
+	float spacing = _scheduler.spacing();
 	size_t cnt = 0;
+	std::vector<StrokeDab> dabs;
+	_record_samples.clear();
 	while (length >= spacing){
 
 		last = cur;
@@ -301,7 +514,7 @@ void VSculptBrushOp::sample_mouse(Vector2f start, Vector2f end)
 
 		//if (cnt > 0){
 			/*ignore the first step*/
-		add_step(cur, last, _first_hit_mouse);
+		add_dab(cur, last, dabs);
 		//}
 
 		length -= spacing;
@@ -309,10 +522,56 @@ void VSculptBrushOp::sample_mouse(Vector2f start, Vector2f end)
 	}
 
 	if (length > 0.4f * spacing ){
-		add_step(end, cur, _first_hit_mouse);
+		add_dab(end, cur, dabs);
+	}
+
+	if (_record){
+		_record->segment_add(false, _record_samples);
+	}
+
+	if (_scheduler.topology_deferred()){
+		const int flag = _data.flag;
+		_data.flag &= ~DYNAMIC_TOPOLOGY;
+		_stroke->add_steps(dabs);
+		_data.flag = flag;
+		_scheduler.refine_add(dabs);
+	}
+	else{
+		_stroke->add_steps(dabs);
+	}
+
+	_scheduler.range_done(dabs.size(), (tbb::tick_count::now() - t0).seconds());
+
+	if (_record && !_record_samples.empty()){
+		const DabScheduler::Decision &decision = _scheduler.decisions().back();
+		StrokeProfile::Schedule schedule;
+		schedule.scheduled = true;
+		schedule.topology_deferred = decision.topology_deferred;
+		schedule.spacing = decision.spacing;
+		schedule.estimate = decision.estimate;
+		schedule.seconds = decision.seconds;
+		_record->segment_schedule_set(schedule);
 	}
 }
 
+/*dynamic topology of deferred dabs. the stroke state of the next dab is kept*/
+void VSculptBrushOp::refine()
+{
+	const StrokeData saved = _data;
+	const size_t count = _scheduler.refine_count();
+
+	tbb::tick_count t0 = tbb::tick_count::now();
+	StrokeDab dab;
+	size_t cnt = 0;
+	while (cnt < count && _scheduler.refine_pop(dab)){
+		_stroke->add_topology_step(dab);
+		cnt++;
+	}
+	_scheduler.refine_done(cnt, (tbb::tick_count::now() - t0).seconds());
+
+	_data = saved;
+}
+
 bool VSculptBrushOp::is_one_step_stroke()
 {
 	int btype = _data.brush_type;
@@ -343,7 +602,7 @@ bool VSculptBrushOp::init_stroke(Vector2f curmouse)
 {
 	/*rest undo/redo logger for safety*/
 	_data.undo_redo_logger = nullptr;
-	_data.view_dir = -VContext::viewModelDirection(_region, _scene);
+	_data.view_dir = _view.view_dir;
 	
 	/*stroke hit object for the first time. Mark the stroke as started and initialize undo/redo*/
 	if (pick(curmouse, _data.cur_pos)){
@@ -353,9 +612,16 @@ bool VSculptBrushOp::init_stroke(Vector2f curmouse)
 		_data.last_pos = _data.cur_pos;
 		_stroke_started = true;
 
+		view_detail_update();
 		interpolate_param();
 		init_undo_redo();
 
+		_scheduler.stroke_begin(_pixel_radius, (_data.flag & DYNAMIC_TOPOLOGY) && _data.brush_type != VbsDef::BRUSH_SMOOTH);
+
+		if (_record){
+			_record->stroke_begin(_data, _falloff);
+		}
+
 		return true;
 	}
 	else{
@@ -373,6 +639,7 @@ void VSculptBrushOp::init_undo_redo()
 
 void VSculptBrushOp::queue_mouse_range(Vector2f start, Vector2f end)
 {
+	std::unique_lock<std::mutex> lock(_queue_mutex);
 #if 0
     const float step = 30; /*pixel*/
     Vector2f mouseDiff = end - start;
@@ -383,15 +650,17 @@ void VSculptBrushOp::queue_mouse_range(Vector2f start, Vector2f end)
     while (length > step){
         last = cur;
         cur = last + mouseDiff * step;
-        _queuemouse.push(std::make_pair(last, cur));
+        _queuemouse.push_back(std::make_pair(last, cur));
         length -= step;
     }
 
     if (length >= 0.0f){
-        _queuemouse.push(std::make_pair(last, end));
+        _queuemouse.push_back(std::make_pair(last, end));
     }
 #else
-    _queuemouse.push(std::make_pair(start, end));
+    _queuemouse.push_back(std::make_pair(start, end));
 #endif
+	lock.unlock();
+	_queue_cond.notify_one();
 }
 
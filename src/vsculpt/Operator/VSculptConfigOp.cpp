@@ -34,6 +34,15 @@ void VSculptConfigOp::setParam(const QString &name, const QVariant &value)
 	else if (name == "detail_size"){
 		_config->setBrushDetailsize(value.toFloat());
 	}
+	else if (name == "pixels_per_edge"){
+		_config->setBrushPixelsPerEdge(value.toFloat());
+	}
+	else if (name == "view_detail"){
+		_config->setBrushViewDetail(value.toBool());
+	}
+	else if (name == "smooth_iterations"){
+		_config->setBrushSmoothIterations(value.toInt());
+	}
 	else if (name == "dynamic_topology"){
 		_config->setBrushDynamicTopology(value.toBool());
 	}
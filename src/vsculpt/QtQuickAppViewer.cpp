@@ -5,6 +5,7 @@
 #include <QtQml/QQmlEngine>
 #include <GTGraphics.h>
 #include "VContext.h"
+#include "sculpt/SculptRenderSync.h"
 #include <QtCore/QCoreApplication>
 #include <tbb/mutex.h>
 #include <QTimer>
@@ -14,6 +15,7 @@ using namespace vk;
 using namespace gte;
 
 extern tbb::mutex g_render_gui_mutex;
+extern tbb::mutex g_sculpt_mutex;
 
 QtQuickAppViewer::QtQuickAppViewer(QWindow *parent)
 	:
@@ -90,17 +92,33 @@ void QtQuickAppViewer::onBeforeRendering()
 	tbb::mutex::scoped_lock lock(g_render_gui_mutex);
 
 	{
+		/*sync between dabs of the sculpt worker. the gui thread waits for g_render_gui_mutex,
+		so the sync is skipped instead of waiting for a dab. the worker lets the next frame in*/
+		tbb::mutex::scoped_lock sculpt_lock;
+		const bool sync = sculpt_lock.try_acquire(g_sculpt_mutex);
+		if (!sync){
+			SculptRenderSync::instance()->missed();
+		}
+
 		VContext *context = VContext::instance();
 
 		gte::GL::initialize(openglContext());
 
-		context->scene()->syncUpdate();
-		VSceneRender::instance()->syncUpdate(context);
+		if (sync){
+			context->scene()->syncUpdate();
+			VSceneRender::instance()->syncUpdate(context);
+		}
 
 		for (auto it = _regions.begin(); it != _regions.end(); ++it){
 			VView3DRegion *region = *it;
 			region->initialize();
-			region->syncUpdate(VContext::instance());
+			if (sync){
+				region->syncUpdate(VContext::instance());
+			}
+		}
+
+		if (sync){
+			SculptRenderSync::instance()->synced();
 		}
 	}
 